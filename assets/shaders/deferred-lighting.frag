@@ -0,0 +1,44 @@
+#version 330
+
+// The data of the frame is streamed by the renderer into a uniform block (see ForwardRenderer::FrameBlock)
+layout(std140) uniform Frame {
+    mat4 VP;
+    vec3 eye;
+};
+
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+
+// The targets of the G-buffer and the depth of the scene (see "gbuffer.glsl")
+uniform sampler2D gbuffer_albedo;
+uniform sampler2D gbuffer_normal;
+uniform sampler2D gbuffer_material;
+uniform sampler2D gbuffer_emissive;
+uniform sampler2D gbuffer_depth;
+// Transforms a point from the NDC space back to the world space
+uniform mat4 inverse_VP;
+
+out vec4 frag_color;
+
+void main(){
+    // The G-buffer has the same size as the scene, so it is read without filtering
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gbuffer_depth, pixel, 0).r;
+    // No lit opaque object covers this pixel (the sky and the other objects are drawn later by the forward pass)
+    if(depth >= 1.0) discard;
+
+    // The world position is found by transforming the pixel (in the NDC space) by the inverse of VP
+    vec3 ndc = vec3(gl_FragCoord.xy / vec2(textureSize(gbuffer_depth, 0)), depth) * 2.0 - 1.0;
+    vec4 world = inverse_VP * vec4(ndc, 1.0);
+    world /= world.w;
+
+    vec4 albedo = texelFetch(gbuffer_albedo, pixel, 0);
+    vec3 normal = decode_normal(texelFetch(gbuffer_normal, pixel, 0).xy);
+    vec4 material_data = texelFetch(gbuffer_material, pixel, 0);
+    vec3 material_emissive = texelFetch(gbuffer_emissive, pixel, 0).rgb;
+
+    vec3 material_ambient = albedo.rgb * albedo.a;
+    float material_shininess = roughness_to_shininess(material_data.a);
+    frag_color = vec4(shade_surface(world.xyz, eye - world.xyz, normal, albedo.rgb, material_data.rgb, material_ambient,
+        material_shininess, material_emissive, gl_FragCoord.xy), 1.0);
+}
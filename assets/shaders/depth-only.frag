@@ -0,0 +1,6 @@
+#version 330 core
+
+// The fragment shader of the depth pre-pass: it is linked with the vertex shader of a material
+// and does nothing since only the depth of the fragments is written (the color writes are masked)
+void main(){
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+// The G-buffer of the deferred renderer holds the surface data of the lit opaque objects in 4 targets (and the depth buffer):
+//  0: the albedo (rgb) and the ambient occlusion (a)       GL_RGBA8
+//  1: the normal in octahedral coordinates                 GL_RG16F
+//  2: the specular color (rgb) and the roughness (a)       GL_RGBA8
+//  3: the emissive color                                   GL_R11F_G11F_B10F
+// The world position isn't stored, it is computed from the depth.
+
+// The octahedral encoding projects the unit normal onto an octahedron then unfolds it into a square,
+// so a normal only takes 2 channels with an error that is about the same in every direction
+vec2 encode_normal(vec3 normal){
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    if(normal.z >= 0.0) return normal.xy;
+    // The lower half of the octahedron is folded over the corners of the square
+    return (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 decode_normal(vec2 encoded){
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = clamp(-normal.z, 0.0, 1.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+    return normalize(normal);
+}
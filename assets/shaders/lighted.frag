@@ -1,38 +1,7 @@
 #version 330
 
-#define MAX_LIGHTS 64
-
-// set DIRECTIONAL to 0
-#define DIRECTIONAL 0
-
-// set POINT to 1
-#define POINT 1
-
-// set SPOT to 2
-#define SPOT 2
-
-struct Light {
-    //type of light spot , directional ,point
-    int type;
-    // the position of the light
-    vec3 position;
-    //the direction of the light
-    vec3 direction;
-    // These defines the colors and intensities of the light.
-    vec3 diffuse;
-    vec3 specular; 
-    vec3 attenuation; // x*d^2 + y*d + z
-    vec2 coneAngles; // x: inner angle, y: outer angle for spot light
-};
-
-uniform Light lights[MAX_LIGHTS];
-uniform int light_count;
-//struct for sky light
-struct Sky {
-    vec3 top, middle, bottom;
-};
-//sky light from forward render
-uniform Sky sky;
+// The lights, the clusters and the functions computing the lighting are shared with the deferred renderer
+#include "lighting.glsl"
 
 // struct for material 
 // albedo: which is used to represent the diffuse of the material.
@@ -40,16 +9,29 @@ uniform Sky sky;
 // ambient_occlusion: which is used to represent how much ambient each part should get, not all locations get the same ambient.
 // roughness: which is used to represent the shininess of the material.
 // emissive: which is used to make the object emit its own light
+// The textures of the materials are packed into texture arrays (the layer of the material is received from the vertex shader)
 struct Material {
-    sampler2D albedo;
-    sampler2D specular;
-    sampler2D ambient_occlusion;
-    sampler2D roughness;
-    sampler2D emissive;
+    sampler2DArray albedo;
+    sampler2DArray specular;
+    sampler2DArray ambient_occlusion;
+    sampler2DArray roughness;
+    sampler2DArray emissive;
 };
 // Receive the material as uniform.
 uniform Material material;
 
+#ifdef MATERIAL_BLOCK
+// The uniforms of the material are read from its block in the material table (see MaterialTable)
+layout(std140) uniform MaterialBlock {
+    vec4 tint;
+    float alphaThreshold;
+    int material_layer;
+};
+#elif defined(ALPHA_TEST)
+// The pixels whose albedo alpha is below this threshold are discarded (only compiled in the permutation of the materials that use it)
+uniform float alphaThreshold;
+#endif
+
 in Varyings {
     vec4 color;
     vec2 tex_coord;
@@ -59,60 +41,67 @@ in Varyings {
     vec3 view;
      // We will need the vertex position in the world space,
     vec3 world;
+    flat int texture_layer;
 } fs_in;
 
+#ifdef GBUFFER
+// The surface data is written to the G-buffer of the deferred renderer which computes the lighting later (see "gbuffer.glsl")
+#include "gbuffer.glsl"
+layout(location = 0) out vec4 gbuffer_albedo;
+layout(location = 1) out vec2 gbuffer_normal;
+layout(location = 2) out vec4 gbuffer_material;
+layout(location = 3) out vec3 gbuffer_emissive;
+#elif defined(WEIGHTED_OIT)
+// The transparent objects are drawn to the accumulation targets of the weighted blended transparency (see ForwardRenderer)
+#include "weighted-oit.glsl"
+#else
 out vec4 frag_color;
+#endif
 
 void main(){
-    // First we normalize the normal and the view.
-    vec3 view = normalize(fs_in.view);
+    // First we normalize the normal.
     vec3 normal = normalize(fs_in.normal);
    // get the material components
-    vec3 material_diffuse = texture(material.albedo, fs_in.tex_coord).rgb;
-    vec3 material_specular = texture(material.specular, fs_in.tex_coord).rgb;
-    vec3 material_ambient = material_diffuse * texture(material.ambient_occlusion, fs_in.tex_coord).r;
-    
-    float material_roughness = texture(material.roughness, fs_in.tex_coord).r;
-    float material_shininess = 2.0 / pow(clamp(material_roughness, 0.001, 0.999), 4.0) - 2.0;
-
-    vec3 material_emissive = texture(material.emissive, fs_in.tex_coord).rgb;
-    //sky light 
-    vec3 sky_light = (normal.y > 0) ?
-        mix(sky.middle, sky.top, normal.y * normal.y) :
-        mix(sky.middle, sky.bottom, normal.y * normal.y);
-
-    frag_color = vec4(material_emissive + material_ambient * sky_light , 1.0);
-     //get light counts
-    int clamped_light_count = min(MAX_LIGHTS, light_count);
-    for(int i = 0; i < clamped_light_count; i++){
-        Light light = lights[i];
-           // Then we get the light direction 
-        vec3 direction_to_light = normalize(-light.direction);
-        if(light.type != DIRECTIONAL){
-            direction_to_light = normalize(light.position - fs_in.world);
-        }
-
-          // Now we compute the  components of the light separately.
-        
-        vec3 diffuse = light.diffuse * material_diffuse * max(0, dot(normal, direction_to_light));
-        
-        vec3 reflected = reflect(-direction_to_light, normal); // this is used for specular
-        
-        vec3 specular = light.specular * material_specular * pow(max(0, dot(view, reflected)), material_shininess);
-
-        float attenuation = 1;
-        if(light.type != DIRECTIONAL){
-            //distance relative to the pixel location in the world space.
-            float d = distance(light.position, fs_in.world);
-            attenuation /= dot(light.attenuation, vec3(d*d, d, 1));
-            if(light.type == SPOT){
-                // Then we calculate the angle between the pixel and the cone axis.
-                float angle = acos(dot(-direction_to_light, light.direction));
-                 // And we calculate the attenuation based on the angle.
-                attenuation *= smoothstep(light.coneAngles.y, light.coneAngles.x, angle);
-            }
-        }
-         // Then we combine the light component .
-        frag_color.rgb += (diffuse + specular) * attenuation;
-    }
-}
\ No newline at end of file
+    vec3 tex_coord = vec3(fs_in.tex_coord, fs_in.texture_layer);
+    vec4 albedo = texture(material.albedo, tex_coord);
+#ifdef ALPHA_TEST
+    if(albedo.a < alphaThreshold) discard;
+#endif
+    vec3 material_diffuse = albedo.rgb;
+    // The material defines NO_<TEXTURE>_MAP for each texture it doesn't have (see LitMaterial::deserialize),
+    // so the sample is replaced by the constant that the texture packer writes to the layer of a missing texture
+#ifdef NO_SPECULAR_MAP
+    vec3 material_specular = vec3(0.0);
+#else
+    vec3 material_specular = texture(material.specular, tex_coord).rgb;
+#endif
+#ifdef NO_AMBIENT_OCCLUSION_MAP
+    float material_occlusion = 1.0;
+#else
+    float material_occlusion = texture(material.ambient_occlusion, tex_coord).r;
+#endif
+#ifdef NO_ROUGHNESS_MAP
+    float material_roughness = 1.0;
+#else
+    float material_roughness = texture(material.roughness, tex_coord).r;
+#endif
+#ifdef NO_EMISSIVE_MAP
+    vec3 material_emissive = vec3(0.0);
+#else
+    vec3 material_emissive = texture(material.emissive, tex_coord).rgb;
+#endif
+#ifdef GBUFFER
+    gbuffer_albedo = vec4(material_diffuse, material_occlusion);
+    gbuffer_normal = encode_normal(normal);
+    gbuffer_material = vec4(material_specular, material_roughness);
+    gbuffer_emissive = material_emissive;
+#else
+    vec3 material_ambient = material_diffuse * material_occlusion;
+    float material_shininess = roughness_to_shininess(material_roughness);
+    frag_color = vec4(shade_surface(fs_in.world, fs_in.view, normal, material_diffuse, material_specular, material_ambient,
+        material_shininess, material_emissive, gl_FragCoord.xy), 1.0);
+#ifdef WEIGHTED_OIT
+    write_weighted_oit();
+#endif
+#endif
+}
@@ -1,9 +1,10 @@
 #version 330
 
-uniform vec3 eye;//eye
-uniform mat4 VP;//view * position matrix
-uniform mat4 M; // model matrix
-uniform mat4 M_IT;//model matrix  inverse transpose
+// The data of the frame is streamed by the renderer into a uniform block (see ForwardRenderer::FrameBlock)
+layout(std140) uniform Frame {
+    mat4 VP;//view * position matrix
+    vec3 eye;//eye
+};
 
 layout(location=0) in vec3 position;
 layout(location=1) in vec4 color;
@@ -11,24 +12,66 @@ layout(location=2) in vec2 tex_coord;
 // Now we need to the surface normal to compute the light so we will send it as an attribute.
 layout(location=3) in vec3 normal;
 
+#ifdef INSTANCED
+// The per-instance data read from the instance buffer (a mat4 attribute takes the locations 4 to 7)
+layout(location=4) in mat4 instance_model;
+layout(location=8) in vec4 instance_tint;
+// The instances of a draw may use different materials of the same texture set, so each instance has its own texture layer
+layout(location=9) in int instance_texture_layer;
+#else
+// The data of the drawn object is streamed into another block that is bound at the offset of the object for each draw
+layout(std140) uniform Object {
+    mat4 transform; // model view projection matrix
+    mat4 M; // model matrix
+    mat4 M_IT;//model matrix  inverse transpose
+};
+#ifdef MATERIAL_BLOCK
+// The layer of the textures of the material in the texture arrays is read from its block in the material table (see MaterialTable)
+layout(std140) uniform MaterialBlock {
+    vec4 tint;
+    float alphaThreshold;
+    int material_layer;
+};
+#else
+// The layer of the textures of the material in the texture arrays
+uniform int material_layer;
+#endif
+#endif
+
 out Varyings {
     vec4 color;
     vec2 tex_coord;
     vec3 normal;
     vec3 view;
     vec3 world;
+    flat int texture_layer;
 } vs_out;
 
+// The depth pre-pass draws with the same vertex shader, so the position must be computed exactly the same way in both programs
+invariant gl_Position;
+
 void main(){
+#ifdef INSTANCED
+    // First we compute the world position using the model matrix of the instance.
+    vec3 world = (instance_model * vec4(position, 1.0)).xyz;
+    gl_Position = VP * vec4(world, 1.0);
+    vs_out.color = color * instance_tint;
+    // The model matrix differs per instance so its inverse transpose (used to transform the normal) is computed here.
+    mat3 normal_matrix = transpose(inverse(mat3(instance_model)));
+    vs_out.normal = normalize(normal_matrix * normal);
+    vs_out.texture_layer = instance_texture_layer;
+#else
     // First we compute the world position.
     vec3 world = (M * vec4(position, 1.0)).xyz;
     gl_Position = VP * vec4(world, 1.0);
     vs_out.color = color;
-    vs_out.tex_coord = tex_coord;
     // Then we compute normal in the world space (Note that w=0 since this is a vector).
     vs_out.normal = normalize((M_IT * vec4(normal, 0.0)).xyz);
+    vs_out.texture_layer = material_layer;
+#endif
+    vs_out.tex_coord = tex_coord;
     // Then we compute the view vector (vertex to eye vector in the world space).
     vs_out.view = eye - world;
      // Finally, we compute the position in the homogenous clip space and send the rest of the data.
     vs_out.world = world;
-}
\ No newline at end of file
+}
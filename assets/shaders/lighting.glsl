@@ -0,0 +1,157 @@
+// The lighting shared by the lit shaders: the forward pass of "lighted.frag" and the lighting pass of the deferred renderer
+// ("deferred-lighting.frag"). The file that includes it must start with the "#version" line.
+
+// set DIRECTIONAL to 0
+#define DIRECTIONAL 0
+
+// set POINT to 1
+#define POINT 1
+
+// set SPOT to 2
+#define SPOT 2
+
+// The renderer defines HAS_DIRECTIONAL_LIGHTS, HAS_POINT_LIGHTS and HAS_SPOT_LIGHTS for the types of the lights in the scene,
+// so the branches of the missing types are removed at compile time (without any of them, the type is checked for every light)
+#if defined(HAS_DIRECTIONAL_LIGHTS) || defined(HAS_POINT_LIGHTS) || defined(HAS_SPOT_LIGHTS)
+    #if !defined(HAS_POINT_LIGHTS) && !defined(HAS_SPOT_LIGHTS)
+        #define IS_DIRECTIONAL(light) true
+    #elif !defined(HAS_DIRECTIONAL_LIGHTS)
+        #define IS_DIRECTIONAL(light) false
+    #endif
+    #if !defined(HAS_SPOT_LIGHTS)
+        #define IS_SPOT(light) false
+    #elif !defined(HAS_DIRECTIONAL_LIGHTS) && !defined(HAS_POINT_LIGHTS)
+        #define IS_SPOT(light) true
+    #endif
+#endif
+#ifndef IS_DIRECTIONAL
+    #define IS_DIRECTIONAL(light) ((light).type == DIRECTIONAL)
+#endif
+#ifndef IS_SPOT
+    #define IS_SPOT(light) ((light).type == SPOT)
+#endif
+
+struct Light {
+    //type of light spot , directional ,point
+    int type;
+    // the position of the light
+    vec3 position;
+    //the direction of the light
+    vec3 direction;
+    // These defines the colors and intensities of the light.
+    vec3 diffuse;
+    vec3 specular; 
+    vec3 attenuation; // x*d^2 + y*d + z
+    vec2 coneAngles; // x: inner angle, y: outer angle for spot light
+};
+
+// The lights are culled on the CPU using clustered forward shading (see "source/common/systems/light-clusters.hpp")
+// light_data: 5 texels per light [position, type], [direction, 0], [diffuse, inner angle], [specular, outer angle], [attenuation, 0]
+uniform samplerBuffer light_data;
+// cluster_grid: for each cluster, the offset of its first light in light_indices and the number of its lights
+uniform usamplerBuffer cluster_grid;
+// light_indices: the indices of the lights of every cluster stored one after the other
+uniform usamplerBuffer light_indices;
+// The first global_light_count lights (e.g. directional lights) affect every fragment so they are not stored in the clusters
+uniform int global_light_count;
+// The renderer can also define GLOBAL_LIGHT_COUNT to the exact number so the loop over the global lights is unrolled
+#ifndef GLOBAL_LIGHT_COUNT
+    #define GLOBAL_LIGHT_COUNT global_light_count
+#endif
+// The number of clusters on each axis, the size of a tile in pixels and the constants to find the depth slice (slice = log(depth) * x - y)
+uniform ivec3 cluster_count;
+uniform vec2 cluster_tile_size;
+uniform vec2 cluster_depth_params;
+// Used to compute the view depth of the fragment
+uniform vec3 camera_forward;
+
+//struct for sky light
+struct Sky {
+    vec3 top, middle, bottom;
+};
+//sky light from forward render
+uniform Sky sky;
+
+// Reads the light with the given index from the light buffer
+Light fetch_light(int index){
+    int base = index * 5;
+    vec4 texel0 = texelFetch(light_data, base);
+    vec4 texel1 = texelFetch(light_data, base + 1);
+    vec4 texel2 = texelFetch(light_data, base + 2);
+    vec4 texel3 = texelFetch(light_data, base + 3);
+    vec4 texel4 = texelFetch(light_data, base + 4);
+    Light light;
+    light.position = texel0.xyz;
+    light.type = int(texel0.w);
+    light.direction = texel1.xyz;
+    light.diffuse = texel2.rgb;
+    light.coneAngles.x = texel2.w;
+    light.specular = texel3.rgb;
+    light.coneAngles.y = texel3.w;
+    light.attenuation = texel4.xyz;
+    return light;
+}
+
+// Computes the diffuse and specular light received from the given light
+vec3 compute_light(Light light, vec3 world, vec3 normal, vec3 view, vec3 material_diffuse, vec3 material_specular, float material_shininess){
+       // Then we get the light direction 
+    vec3 direction_to_light = normalize(-light.direction);
+    if(!IS_DIRECTIONAL(light)){
+        direction_to_light = normalize(light.position - world);
+    }
+
+      // Now we compute the  components of the light separately.
+    
+    vec3 diffuse = light.diffuse * material_diffuse * max(0, dot(normal, direction_to_light));
+    
+    vec3 reflected = reflect(-direction_to_light, normal); // this is used for specular
+    
+    vec3 specular = light.specular * material_specular * pow(max(0, dot(view, reflected)), material_shininess);
+
+    float attenuation = 1;
+    if(!IS_DIRECTIONAL(light)){
+        //distance relative to the pixel location in the world space.
+        float d = distance(light.position, world);
+        attenuation /= dot(light.attenuation, vec3(d*d, d, 1));
+        if(IS_SPOT(light)){
+            // Then we calculate the angle between the pixel and the cone axis.
+            float angle = acos(dot(-direction_to_light, light.direction));
+             // And we calculate the attenuation based on the angle.
+            attenuation *= smoothstep(light.coneAngles.y, light.coneAngles.x, angle);
+        }
+    }
+     // Then we combine the light component .
+    return (diffuse + specular) * attenuation;
+}
+
+// Computes the color of a surface lit by the sky, the global lights and the lights of the cluster containing it.
+// "to_eye" is the vector from the surface to the eye (not normalized) and "frag_coord" is the pixel of the surface (to find its cluster)
+vec3 shade_surface(vec3 world, vec3 to_eye, vec3 normal, vec3 material_diffuse, vec3 material_specular, vec3 material_ambient,
+    float material_shininess, vec3 material_emissive, vec2 frag_coord){
+    vec3 view = normalize(to_eye);
+    //sky light 
+    vec3 sky_light = (normal.y > 0) ?
+        mix(sky.middle, sky.top, normal.y * normal.y) :
+        mix(sky.middle, sky.bottom, normal.y * normal.y);
+
+    vec3 color = material_emissive + material_ambient * sky_light;
+    // Then we add the global lights followed by the lights of the cluster containing this fragment
+    for(int i = 0; i < GLOBAL_LIGHT_COUNT; i++){
+        color += compute_light(fetch_light(i), world, normal, view, material_diffuse, material_specular, material_shininess);
+    }
+    // The view depth is the distance from the eye along the camera forward direction (to_eye = eye - world)
+    float view_depth = max(dot(-to_eye, camera_forward), 1e-4);
+    int slice = clamp(int(floor(log(view_depth) * cluster_depth_params.x - cluster_depth_params.y)), 0, cluster_count.z - 1);
+    ivec2 tile = clamp(ivec2(frag_coord / cluster_tile_size), ivec2(0), cluster_count.xy - 1);
+    uvec2 cluster = texelFetch(cluster_grid, tile.x + cluster_count.x * (tile.y + cluster_count.y * slice)).xy;
+    for(uint i = 0u; i < cluster.y; i++){
+        int light_index = int(texelFetch(light_indices, int(cluster.x + i)).r);
+        color += compute_light(fetch_light(light_index), world, normal, view, material_diffuse, material_specular, material_shininess);
+    }
+    return color;
+}
+
+// Converts the roughness of a material to the shininess of the specular term
+float roughness_to_shininess(float roughness){
+    return 2.0 / pow(clamp(roughness, 0.001, 0.999), 4.0) - 2.0;
+}
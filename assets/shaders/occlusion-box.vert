@@ -0,0 +1,10 @@
+#version 330 core
+
+// Draws the bounding box of an object for an occlusion query (the box is a unit cube moved & scaled by "transform")
+layout(location = 0) in vec3 position;
+
+uniform mat4 transform;
+
+void main(){
+    gl_Position = transform * vec4(position, 1.0);
+}
\ No newline at end of file
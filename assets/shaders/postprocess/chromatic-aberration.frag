@@ -7,22 +7,9 @@ uniform sampler2D tex;
 in vec2 tex_coord;
 out vec4 frag_color;
 
-// How far (in the texture space) is the distance (on the x-axis) between
-// the pixels from which the red/green (or green/blue) channels are sampled
-#define STRENGTH 0.005
-
-// Chromatic aberration mimics some old cameras where the lens disperses light
-// differently based on its wavelength. In this shader, we will implement a
-// cheap version of that effect 
+// The effect is written as a function in its own file so it can also be fused with other effects (see "postprocess-chain.hpp")
+#include "effects/chromatic-aberration.glsl"
 
 void main(){
-    //TODO: Modify this shader to apply chromatic abberation
-    // To apply this effect, we only read the green channel from the correct pixel (as defined by tex_coord)
-    // To get the red channel, we move by amount STRENGTH to the left then sample another pixel from which we take the red channel
-    // To get the blue channel, we move by amount STRENGTH to the right then sample another pixel from which we take the blue channel
-    // frag_color = texture(tex, tex_coord);
-    //already documented :)
-    frag_color = texture(tex, tex_coord) * vec4(0.0f, 1.0f, 0.0f, 1.0f);
-    frag_color += texture(tex, vec2(tex_coord.x - STRENGTH, tex_coord.y)) * vec4(1.0f, 0.0f, 0.0f, 1.0f);
-    frag_color += texture(tex, vec2(tex_coord.x + STRENGTH, tex_coord.y)) * vec4(0.0f, 0.0f, 1.0f, 1.0f);
-}
\ No newline at end of file
+    frag_color = chromatic_aberration(tex, tex_coord);
+}
@@ -0,0 +1,7 @@
+// Replaces the color by the result of the color grades baked into a color lookup table (see "color-lut.hpp")
+// COLOR_LUT_SIZE is defined by the shader including this file (it is the number of entries along each axis of the table)
+vec4 apply_color_lut(sampler3D lut, vec4 color){
+    // The entries are stored at the centers of the texels, so the color is remapped from [0, 1] to [0.5/size, 1 - 0.5/size]
+    vec3 coord = clamp(color.rgb, 0.0, 1.0) * ((COLOR_LUT_SIZE - 1.0) / COLOR_LUT_SIZE) + 0.5 / COLOR_LUT_SIZE;
+    return vec4(texture(lut, coord).rgb, color.a);
+}
@@ -0,0 +1,19 @@
+// How far (in the texture space) is the distance (on the x-axis) between
+// the pixels from which the red/green (or green/blue) channels are sampled
+#define CHROMATIC_ABERRATION_STRENGTH 0.005
+
+// Chromatic aberration mimics some old cameras where the lens disperses light
+// differently based on its wavelength. In this shader, we will implement a
+// cheap version of that effect 
+vec4 chromatic_aberration(sampler2D tex, vec2 tex_coord){
+    //TODO: Modify this shader to apply chromatic abberation
+    // To apply this effect, we only read the green channel from the correct pixel (as defined by tex_coord)
+    // To get the red channel, we move by amount STRENGTH to the left then sample another pixel from which we take the red channel
+    // To get the blue channel, we move by amount STRENGTH to the right then sample another pixel from which we take the blue channel
+    // frag_color = texture(tex, tex_coord);
+    //already documented :)
+    vec4 color = texture(tex, tex_coord) * vec4(0.0f, 1.0f, 0.0f, 1.0f);
+    color += texture(tex, vec2(tex_coord.x - CHROMATIC_ABERRATION_STRENGTH, tex_coord.y)) * vec4(1.0f, 0.0f, 0.0f, 1.0f);
+    color += texture(tex, vec2(tex_coord.x + CHROMATIC_ABERRATION_STRENGTH, tex_coord.y)) * vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    return color;
+}
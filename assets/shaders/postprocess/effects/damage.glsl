@@ -0,0 +1,14 @@
+// How far (in the texture space) is the distance (on the x-axis) between
+// the pixels from which the red/green (or green/blue) channels are sampled
+#define DAMAGE_STRENGTH .005
+
+vec4 damage(sampler2D tex, vec2 tex_coord){
+  // samples the red channel (r) from a pixel located to the left of the current tex_coord by an amount defined by STRENGTH.
+  float r=texture(tex,tex_coord+vec2(-DAMAGE_STRENGTH,0)).r;
+  // samples the green channel (g) from the current tex_coord.
+  float g=texture(tex,tex_coord).g;
+  // samples the blue channel (b) from a pixel located to the right of the current tex_coord by an amount defined by STRENGTH.
+  float b=texture(tex,tex_coord+vec2(DAMAGE_STRENGTH,0)).b;
+  // returns the final color of the fragment. It adds 0.2 to the red channel, subtracts 0.1 from the green and blue channels, and sets the alpha channel to 1.0.
+  return vec4(r+.2,g-.1,b-.1,1.);
+}
@@ -0,0 +1,6 @@
+vec4 grayscale(vec4 color, vec2 tex_coord){
+    // To apply the grayscale effect, we compute the average of the red/blue/green channels
+    // and set that average value to all the channels
+    float gray = dot(color.rgb, vec3(1.0/3.0, 1.0/3.0, 1.0/3.0));
+    return vec4(vec3(gray), color.a);
+}
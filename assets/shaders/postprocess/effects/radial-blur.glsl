@@ -0,0 +1,15 @@
+// The number of samples we read to compute the blurring effect
+#define RADIAL_BLUR_STEPS 16
+// The strength of the blurring effect
+#define RADIAL_BLUR_STRENGTH 0.2
+
+vec4 radial_blur(sampler2D tex, vec2 tex_coord){
+    // To apply radial blur, we compute the direction outward from the center to the current pixel
+    vec2 step_vector = (tex_coord - 0.5) * (RADIAL_BLUR_STRENGTH / RADIAL_BLUR_STEPS);
+    // Then we sample multiple pixels along that direction and compute the average
+    vec4 color = vec4(0.0);
+    for(int i = 0; i < RADIAL_BLUR_STEPS; i++){
+        color += texture(tex, tex_coord + step_vector * i);    
+    }
+    return color / RADIAL_BLUR_STEPS;
+}
@@ -0,0 +1,15 @@
+vec4 sepia_tone(vec4 color, vec2 tex_coord){
+    // vec3 sepiaColor = vec3(0.393, 0.769, 0.189) * color.rgb;
+    // sepiaColor += vec3(0.349, 0.686, 0.168) * color.rgb;
+    // sepiaColor += vec3(0.272, 0.534, 0.131) * color.rgb;
+
+    // Apply the sepia tone effect
+    const mat3 sepiaMatrix = mat3(
+        0.393, 0.769, 0.189,
+        0.349, 0.686, 0.168,
+        0.272, 0.534, 0.131
+    );
+    vec3 sepiaColor = sepiaMatrix * color.rgb;
+
+    return vec4(sepiaColor, color.a);
+}
@@ -0,0 +1,11 @@
+// Vignette is a postprocessing effect that darkens the corners of the screen
+// to grab the attention of the viewer towards the center of the screen
+vec4 vignette(vec4 color, vec2 tex_coord){
+    //TODO: Modify this shader to apply vignette
+    // To apply vignette, divide the scene color
+    // by 1 + the squared length of the 2D pixel location the NDC space
+    // Hint: remember that the NDC space ranges from -1 to 1
+    // while the texture coordinate space ranges from 0 to 1
+    // We have the pixel's texture coordinate, how can we compute its location in the NDC space?
+    return color / (1 + length (2 * tex_coord - 1) * length (2 * tex_coord - 1)); // already documented abobe :)
+}
@@ -7,10 +7,9 @@ uniform sampler2D tex;
 in vec2 tex_coord;
 out vec4 frag_color;
 
+// The effect is written as a function in its own file so it can also be fused with other effects (see "postprocess-chain.hpp")
+#include "effects/grayscale.glsl"
+
 void main(){
-    // To apply the grayscale effect, we compute the average of the red/blue/green channels
-    // and set that average value to all the channels
-    frag_color = texture(tex, tex_coord);
-    float gray = dot(frag_color.rgb, vec3(1.0/3.0, 1.0/3.0, 1.0/3.0));
-    frag_color.rgb = vec3(gray);
-}
\ No newline at end of file
+    frag_color = grayscale(texture(tex, tex_coord), tex_coord);
+}
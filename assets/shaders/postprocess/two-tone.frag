@@ -7,17 +7,9 @@ uniform sampler2D tex;
 in vec2 tex_coord;
 out vec4 frag_color;
 
-// Duotone effect parameters
-const vec3 tone1 = vec3(0.6627, 0.8078, 0.8824);   // First tone color
-const vec3 tone2 = vec3(0.8, 0.2, 0.6);   // Second tone color
+// The effect is written as a function in its own file so it can also be fused with other effects (see "postprocess-chain.hpp")
+#include "effects/two-tone.glsl"
 
-void main() {
-    // Sample the color from the texture
-    vec4 color = texture(tex, tex_coord);
-
-    // Map the input colors to the two-tone color palette
-    // The mix() function is used to interpolate between tone1 and tone2 based on the multiply value.
-    vec3 duotoneColor = mix(tone1, tone2, color.rgb*vec3(0.3333));
-
-    frag_color = vec4(duotoneColor, color.a);
-}
\ No newline at end of file
+void main(){
+    frag_color = two_tone(texture(tex, tex_coord), tex_coord);
+}
@@ -5,18 +5,11 @@ uniform sampler2D tex;
 
 // Read "assets/shaders/fullscreen.vert" to know what "tex_coord" holds;
 in vec2 tex_coord;
-
 out vec4 frag_color;
 
-// Vignette is a postprocessing effect that darkens the corners of the screen
-// to grab the attention of the viewer towards the center of the screen
+// The effect is written as a function in its own file so it can also be fused with other effects (see "postprocess-chain.hpp")
+#include "effects/vignette.glsl"
 
 void main(){
-    //TODO: Modify this shader to apply vignette
-    // To apply vignette, divide the scene color
-    // by 1 + the squared length of the 2D pixel location the NDC space
-    // Hint: remember that the NDC space ranges from -1 to 1
-    // while the texture coordinate space ranges from 0 to 1
-    // We have the pixel's texture coordinate, how can we compute its location in the NDC space?
-    frag_color = texture(tex, tex_coord) / (1 + length (2 * tex_coord - 1) * length (2 * tex_coord - 1)); // already documented abobe :)
-}
\ No newline at end of file
+    frag_color = vignette(texture(tex, tex_coord), tex_coord);
+}
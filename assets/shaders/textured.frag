@@ -5,14 +5,38 @@ in Varyings {
     vec2 tex_coord;
 } fs_in;
 
+#ifdef WEIGHTED_OIT
+// The transparent objects are drawn to the accumulation targets of the weighted blended transparency (see ForwardRenderer)
+#include "weighted-oit.glsl"
+#else
 out vec4 frag_color;
+#endif
 
-uniform vec4 tint;
 uniform sampler2D tex;
 
+#ifdef MATERIAL_BLOCK
+// The uniforms of the material are read from its block in the material table (see MaterialTable)
+layout(std140) uniform MaterialBlock {
+    vec4 tint;
+    float alphaThreshold;
+    int material_layer;
+};
+#else
+uniform vec4 tint;
+#ifdef ALPHA_TEST
+// The pixels whose alpha is below this threshold are discarded (only compiled in the permutation of the materials that use it)
+uniform float alphaThreshold;
+#endif
+#endif
+
 void main(){
     //TODO: (Req 7) Modify the following line to compute the fragment color
     // by multiplying the tint with the vertex color and with the texture color 
     frag_color = tint * fs_in.color * texture(tex, fs_in.tex_coord);
-    
-}
\ No newline at end of file
+#ifdef ALPHA_TEST
+    if(frag_color.a < alphaThreshold) discard;
+#endif
+#ifdef WEIGHTED_OIT
+    write_weighted_oit();
+#endif
+}
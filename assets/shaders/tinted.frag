@@ -4,12 +4,29 @@ in Varyings {
     vec4 color;
 } fs_in;
 
+#ifdef WEIGHTED_OIT
+// The transparent objects are drawn to the accumulation targets of the weighted blended transparency (see ForwardRenderer)
+#include "weighted-oit.glsl"
+#else
 out vec4 frag_color;
+#endif
 
+#ifdef MATERIAL_BLOCK
+// The uniforms of the material are read from its block in the material table (see MaterialTable)
+layout(std140) uniform MaterialBlock {
+    vec4 tint;
+    float alphaThreshold;
+    int material_layer;
+};
+#else
 uniform vec4 tint;
+#endif
 
 void main(){
     //TODO: (Req 7) Modify the following line to compute the fragment color
     // by multiplying the tint with the vertex color
     frag_color =  tint * fs_in.color;
+#ifdef WEIGHTED_OIT
+    write_weighted_oit();
+#endif
 }
\ No newline at end of file
@@ -7,10 +7,28 @@ out Varyings {
     vec4 color;
 } vs_out;
 
+#ifdef INSTANCED
+// The per-instance data read from the instance buffer (a mat4 attribute takes the locations 4 to 7)
+layout(location = 4) in mat4 instance_model;
+layout(location = 8) in vec4 instance_tint;
+
+// In the instanced permutation, the model matrix comes from the instance so we only need the view projection matrix
+// (it is read from the frame data streamed by the renderer, see ForwardRenderer::FrameBlock)
+layout(std140) uniform Frame {
+    mat4 VP;
+    vec3 eye;
+};
+#else
 uniform mat4 transform;
+#endif
 
 void main(){
     //TODO: (Req 7) Change the next line to apply the transformation matrix
+#ifdef INSTANCED
+    gl_Position = VP * instance_model * vec4(position, 1.0);
+    vs_out.color = color * instance_tint;
+#else
     gl_Position = transform * vec4(position, 1.0);
     vs_out.color = color;
-}
\ No newline at end of file
+#endif
+}
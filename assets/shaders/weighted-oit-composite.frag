@@ -0,0 +1,22 @@
+#version 330
+
+// The accumulation targets of the transparent objects (see "weighted-oit.glsl")
+// The first holds the sum of the weighted colors and the product of (1 - alpha), the second holds the sum of the weights
+uniform sampler2D accumulation_tex;
+uniform sampler2D weight_tex;
+
+out vec4 frag_color;
+
+void main(){
+    // The targets have the same size as the scene, so they are read without filtering
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 accumulation = texelFetch(accumulation_tex, pixel, 0);
+    // The product of (1 - alpha) is the part of the scene that is still visible through the transparent objects
+    float revealage = accumulation.a;
+    // No transparent fragment covers this pixel
+    if(revealage >= 1.0) discard;
+    float weight = texelFetch(weight_tex, pixel, 0).r;
+    vec3 average = accumulation.rgb / max(weight, 1e-5);
+    // Blended over the scene using (SRC_ALPHA, ONE_MINUS_SRC_ALPHA), so the scene is multiplied by the revealage
+    frag_color = vec4(average, 1.0 - revealage);
+}
@@ -0,0 +1,21 @@
+// Weighted blended order-independent transparency (included by the material shaders in their WEIGHTED_OIT permutation)
+// The shader computes "frag_color" as usual then calls "write_weighted_oit" at the end of "main".
+// Instead of blending over the scene in order, every transparent fragment adds its color (multiplied by its alpha and a weight)
+// and its weight to two accumulation targets, while the alpha channel of the first target keeps the product of (1 - alpha).
+// All the transparent objects can then be drawn in any order, and "weighted-oit-composite.frag" divides the sum of the colors
+// by the sum of the weights and blends the result over the scene using the product of (1 - alpha).
+// The renderer sets the blending to (ONE, ONE) for the colors and (ZERO, ONE_MINUS_SRC_ALPHA) for the alpha.
+layout(location = 0) out vec4 oit_accumulation;
+layout(location = 1) out vec4 oit_weight;
+
+// In this permutation, the color is a plain variable written to the outputs by "write_weighted_oit"
+vec4 frag_color;
+
+void write_weighted_oit(){
+    float alpha = clamp(frag_color.a, 0.0, 1.0);
+    // The weight favors the opaque fragments and the fragments near the camera (gl_FragCoord.z is the depth in the depth buffer)
+    // so the nearest layers dominate the average as they would if the fragments were sorted
+    float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    oit_accumulation = vec4(frag_color.rgb * alpha * weight, alpha);
+    oit_weight = vec4(alpha * weight);
+}
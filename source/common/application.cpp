@@ -1,4 +1,10 @@
 #include "application.hpp"
+#include "gl-state-cache.hpp"
+#include "mesh/mesh-arena.hpp"
+#include "job-system.hpp"
+#include "render-thread.hpp"
+#include "shader/shader.hpp"
+#include "shader/program-cache.hpp"
 
 #include <iostream>
 #include <fstream>
@@ -42,6 +48,26 @@ std::string default_screenshot_filepath() {
     return stream.str();
 }
 
+// A copy of the ImGui draw data of a frame (the UI part of the frame snapshot). ImGui reuses its draw lists every frame,
+// so the render thread draws a copy while the main thread builds the next frame (two copies are used alternately)
+struct GuiDrawDataCopy {
+    ImDrawData data;
+    std::vector<ImDrawList*> lists;
+
+    ImDrawData* copy(const ImDrawData* source){
+        clear();
+        data = *source;
+        for(int i = 0; i < source->CmdListsCount; i++) lists.push_back(source->CmdLists[i]->CloneOutput());
+        data.CmdLists = lists.data();
+        return &data;
+    }
+    void clear(){
+        for(auto list : lists) IM_DELETE(list);
+        lists.clear();
+    }
+    ~GuiDrawDataCopy(){ clear(); }
+};
+
 // This function will be used to log errors thrown by GLFW
 void glfw_error_callback(int error, const char* description){
     std::cerr << "GLFW Error: " << error << ": " << description << std::endl;
@@ -193,6 +219,12 @@ int our::Application::run(int run_for_frames) {
     std::cout << "VERSION         : " << glGetString(GL_VERSION) << std::endl;
     std::cout << "GLSL VERSION    : " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
 
+    // The linked shader programs are stored in this directory and loaded from it in the next runs (an empty path disables the cache)
+    if(std::string shaderCache = app_config.value("shaderCache", std::string("cache/shaders")); !shaderCache.empty())
+        our::ProgramCache::initialize(shaderCache);
+    // The shaders that aren't in the cache are compiled on the threads of the driver (if it can)
+    our::ShaderProgram::enableParallelCompilation();
+
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
     // if we have OpenGL debug messages enabled, set the message callback
     glDebugMessageCallback(opengl_callback, nullptr);
@@ -250,6 +282,15 @@ int our::Application::run(int run_for_frames) {
     // Call onInitialize if the scene needs to do some custom initialization (such as file loading, object creation, etc).
     if(currentState) currentState->onInitialize();
 
+    // If the render thread is enabled, it takes the OpenGL context from now on (see RenderThread)
+    our::RenderThread& renderThread = our::RenderThread::get();
+    GuiDrawDataCopy guiDrawData[2];
+    if(app_config.value("renderThread", false)){
+        // ImGui needs its font atlas (created by the first "NewFrame" of the OpenGL backend) before the first frame starts
+        ImGui_ImplOpenGL3_NewFrame();
+        renderThread.start(window);
+    }
+
     // The time at which the last frame started. But there was no frames yet, so we'll just pick the current time.
     double last_frame_time = glfwGetTime();
     int current_frame = 0;
@@ -259,11 +300,19 @@ int our::Application::run(int run_for_frames) {
         if(run_for_frames != 0 && current_frame >= run_for_frames) break;
         glfwPollEvents(); // Read all the user events and call relevant callbacks.
 
+        // The states that call OpenGL directly in onDraw need the context on the main thread,
+        // the others record their drawing on the render thread (if it is running)
+        if(currentState && currentState->supportsRenderThread()) renderThread.returnContext();
+        else renderThread.borrowContext();
+
         //change background edited by me
         // glClearColor( 0.4375, 0.6875, 0.9375, 1.0);
         //glfwSwapBuffers(window); 
         // Start a new ImGui frame
-        ImGui_ImplOpenGL3_NewFrame();
+        // The OpenGL backend only creates its objects in its "NewFrame" (they were created before the render thread started),
+        // and the render thread must not touch the ImGui context while the main thread builds the frame,
+        // so it is only called when the main thread holds the context. The render thread only reads the copied draw data
+        if(!renderThread.isDeferring()) ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
@@ -332,8 +381,8 @@ int our::Application::run(int run_for_frames) {
             // if button for Exit pressed:
             if (ImGui::Button("Exit", ImVec2(200, 100)))
             {
-                // end the play
-                return 0; 
+                // end the play (the loop ends after this frame, so the render thread & the workers are stopped by the normal shutdown)
+                glfwSetWindowShouldClose(window, GLFW_TRUE);
             }
             // pop the font after writing
             ImGui::PopFont();
@@ -491,8 +540,8 @@ int our::Application::run(int run_for_frames) {
             // if the button of "Exit" pressed:
             if (ImGui::Button("Exit", ImVec2(200, 100)))
             {
-                // end the play
-                return 0;
+                // end the play (the loop ends after this frame, so the render thread & the workers are stopped by the normal shutdown)
+                glfwSetWindowShouldClose(window, GLFW_TRUE);
             }
             // end the GUI
             ImGui::End();
@@ -507,10 +556,16 @@ int our::Application::run(int run_for_frames) {
         // Render the ImGui commands we called (this doesn't actually draw to the screen yet.
         ImGui::Render();
 
+        // From here, the OpenGL calls are recorded on the render thread (or run immediately if it isn't running)
         // Just in case ImGui changed the OpenGL viewport (the portion of the window to which we render the geometry),
         // we set it back to cover the whole window
         auto frame_buffer_size = getFrameBufferSize();
-        glViewport(0, 0, frame_buffer_size.x, frame_buffer_size.y);
+        renderThread.enqueue([frame_buffer_size](){
+            glViewport(0, 0, frame_buffer_size.x, frame_buffer_size.y);
+            // ImGui (and anything else outside our code) may have changed the OpenGL state since the last frame,
+            // so the state cache must forget what it knows before we start drawing
+            our::GLStateCache::beginFrame();
+        });
 
         // Get the current time (the time at which we are starting the current frame).
         double current_frame_time = glfwGetTime();
@@ -519,48 +574,70 @@ int our::Application::run(int run_for_frames) {
         if(currentState) currentState->onDraw(current_frame_time - last_frame_time);
         last_frame_time = current_frame_time; // Then update the last frame start time (this frame is now the last frame)
 
+        // The render thread draws a copy of the ImGui draw data since ImGui will reuse it in the next frame
+        ImDrawData* drawData = ImGui::GetDrawData();
+        if(renderThread.isDeferring()) drawData = guiDrawData[current_frame % 2].copy(drawData);
+        renderThread.enqueue([drawData](){
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
-        // Since ImGui causes many messages to be thrown, we are temporarily disabling the debug messages till we render the ImGui
-        glDisable(GL_DEBUG_OUTPUT);
-        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            // Since ImGui causes many messages to be thrown, we are temporarily disabling the debug messages till we render the ImGui
+            glDisable(GL_DEBUG_OUTPUT);
+            glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData()); // Render the ImGui to the framebuffer
+            ImGui_ImplOpenGL3_RenderDrawData(drawData); // Render the ImGui to the framebuffer
+            // ImGui changed the OpenGL state without going through the state cache
+            our::GLStateCache::invalidate();
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
-        // Re-enable the debug messages
-        glEnable(GL_DEBUG_OUTPUT);
-        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+            // Re-enable the debug messages
+            glEnable(GL_DEBUG_OUTPUT);
+            glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif
+        });
 
-        // If F12 is pressed, take a screenshot
-        if(keyboard.justPressed(GLFW_KEY_F12)){
-            glViewport(0, 0, frame_buffer_size.x, frame_buffer_size.y);
-            std::string path = default_screenshot_filepath();
-            if(our::screenshot_png(path)){
-                std::cout << "Screenshot saved to: " << path << std::endl;
-            } else {
-                std::cerr << "Failed to save a Screenshot" << std::endl;
-            }
-        }
+        // Collect the screenshots of this frame: if F12 is pressed, take a screenshot
+        std::vector<std::string> screenshot_paths;
+        bool default_screenshot = keyboard.justPressed(GLFW_KEY_F12);
+        if(default_screenshot) screenshot_paths.push_back(default_screenshot_filepath());
         // There are any requested screenshots, take them
         while(requested_screenshots.size()){ 
             if(const auto& request = requested_screenshots.top(); request.first == current_frame){
-                if(our::screenshot_png(request.second)){
-                    std::cout << "Screenshot saved to: " << request.second << std::endl;
-                } else {
-                    std::cerr << "Failed to save a screenshot to: " << request.second << std::endl;
-                }
+                screenshot_paths.push_back(request.second);
                 requested_screenshots.pop();
             } else break;
         }
+        if(!screenshot_paths.empty()){
+            renderThread.enqueue([screenshot_paths, frame_buffer_size](){
+                glViewport(0, 0, frame_buffer_size.x, frame_buffer_size.y);
+                for(auto& path : screenshot_paths){
+                    if(our::screenshot_png(path)){
+                        std::cout << "Screenshot saved to: " << path << std::endl;
+                    } else {
+                        std::cerr << "Failed to save a screenshot to: " << path << std::endl;
+                    }
+                }
+            });
+        }
 
         // Swap the frame buffers
-        glfwSwapBuffers(window);
+        renderThread.enqueue([this](){ glfwSwapBuffers(window); });
+        // Report how long it took to show the first frame (the GPU is waited for so its work is included)
+        if(current_frame == 0){
+            renderThread.enqueue([](){
+                glFinish();
+                std::cout << "Time to first frame: " << std::fixed << std::setprecision(1) << glfwGetTime() * 1000.0 << " ms ("
+                    << our::ProgramCache::getLoadedCount() << " programs loaded from the cache, "
+                    << our::ProgramCache::getCompiledCount() << " compiled)" << std::defaultfloat << std::endl;
+            });
+        }
+        // Then start drawing the frame on the render thread while the main thread goes on with the next frame
+        renderThread.submitFrame();
 
         // Update the keyboard and mouse data
         keyboard.update();
         mouse.update();
 
         // If a scene change was requested, apply it
+        // (the states load and delete their OpenGL objects, so the main thread needs the context)
+        if(nextState) renderThread.borrowContext();
         while(nextState){
             // If a scene was already running, destroy it (not delete since we can go back to it later)
             if(currentState) currentState->onDestroy();
@@ -574,10 +651,19 @@ int our::Application::run(int run_for_frames) {
         ++current_frame;
     }
 
+    // Wait for the last frame and take the context back from the render thread
+    renderThread.stop();
+    for(auto& copy : guiDrawData) copy.clear();
+
     // Call for cleaning up
     if(currentState) currentState->onDestroy();
 
     // Shutdown ImGui & destroy the context
+    // Delete the shared geometry buffers while the OpenGL context still exists
+    our::MeshArena::get().destroy();
+    // Join the worker threads of the job system before the application exits
+    our::JobSystem::get().stop();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
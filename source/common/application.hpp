@@ -35,6 +35,9 @@ namespace our {
         virtual void onImmediateGui(){}                 // Called every frame to draw the Immediate GUI (if any).
         virtual void onDraw(double deltaTime){}         // Called every frame in the game loop passing the time taken to draw the frame "Delta time".
         virtual void onDestroy(){}                      // Called once after the game loop ends for house cleaning.
+        // Returns true if onDraw records all its OpenGL work on the render thread (e.g. through ForwardRenderer::render)
+        // instead of calling OpenGL directly. Otherwise, the main thread keeps the context while this state runs.
+        virtual bool supportsRenderThread(){ return false; }
 
 
         // Override these functions to get mouse and keyboard event.
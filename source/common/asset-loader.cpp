@@ -7,6 +7,7 @@
 #include "mesh/mesh.hpp"
 #include "mesh/mesh-utils.hpp"
 #include "material/material.hpp"
+#include "material/material-table.hpp"
 #include "deserialize-utils.hpp"
 
 namespace our {
@@ -14,6 +15,11 @@ namespace our {
     // This will load all the shaders defined in "data"
     // data must be in the form:
     //    { shader_name : { "vs" : "path/to/vertex-shader", "fs" : "path/to/fragment-shader" }, ... }
+    // A shader can also have "instanced": true to link its vertex shader again with "INSTANCED" defined to draw instanced meshes
+    // (or an "instanced_vs" which is linked with the same fragment shader for a separate instanced vertex shader)
+    // and "depth_prepass": true to link its vertex shaders with an empty fragment shader for the depth pre-pass
+    // The programs are only submitted to the driver here, their links are finished by "deserializeAllAssets"
+    // after the other assets are loaded (so the driver compiles the shaders while we load the textures and the meshes)
     template<>
     void AssetLoader<ShaderProgram>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
@@ -23,7 +29,32 @@ namespace our {
                 auto shader = new ShaderProgram();
                 shader->attach(vsPath, GL_VERTEX_SHADER);
                 shader->attach(fsPath, GL_FRAGMENT_SHADER);
-                shader->link();
+                shader->beginLink();
+                // The instanced vertex shader and its defines
+                std::string instancedVsPath = desc.value("instanced_vs", vsPath);
+                std::vector<std::string> instancedDefines;
+                if(!desc.contains("instanced_vs")) instancedDefines.push_back("INSTANCED");
+                bool instanced = desc.contains("instanced_vs") || desc.value("instanced", false);
+                if(instanced){
+                    auto instancedShader = new ShaderProgram();
+                    instancedShader->attach(instancedVsPath, GL_VERTEX_SHADER, instancedDefines);
+                    instancedShader->attach(fsPath, GL_FRAGMENT_SHADER, instancedDefines);
+                    instancedShader->beginLink();
+                    shader->setInstancedVariant(instancedShader);
+                }
+                if(desc.value("depth_prepass", false)){
+                    // The depth variants reuse the vertex shaders so their positions match the main programs exactly
+                    auto createDepthVariant = [](const std::string& vertexShader, const std::vector<std::string>& defines){
+                        auto depth = new ShaderProgram();
+                        depth->attach(vertexShader, GL_VERTEX_SHADER, defines);
+                        depth->attach("assets/shaders/depth-only.frag", GL_FRAGMENT_SHADER);
+                        depth->beginLink();
+                        return depth;
+                    };
+                    shader->setDepthVariant(createDepthVariant(vsPath, {}));
+                    if(auto instancedShader = shader->getInstancedVariant())
+                        instancedShader->setDepthVariant(createDepthVariant(instancedVsPath, instancedDefines));
+                }
                 assets[name] = shader;
             }
         }
@@ -63,12 +94,19 @@ namespace our {
     // This will load all the meshes defined in "data"
     // data must be in the form:
     //    { mesh_name : "path/to/3d-model-file", ... }
+    // or { mesh_name : { "file": "path/to/3d-model-file", "lods": level_count, "lodRatio": triangle_ratio }, ... }
+    // to generate simplified levels of detail for the mesh
     template<>
     void AssetLoader<Mesh>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
-                std::string path = desc.get<std::string>();
-                assets[name] = mesh_utils::loadOBJ(path);
+                if(desc.is_object()){
+                    std::string path = desc.value("file", "");
+                    assets[name] = mesh_utils::loadOBJ(path, desc.value("lods", 0), desc.value("lodRatio", 0.5f));
+                } else {
+                    std::string path = desc.get<std::string>();
+                    assets[name] = mesh_utils::loadOBJ(path);
+                }
             }
         }
     };
@@ -85,15 +123,24 @@ namespace our {
     //      "pipelineState" (optional) where the value is a json object that can be read by "PipelineState::deserialize"
     //      "transparent" (optional, default=false) where the value is a boolean indicating whether the material is transparent or not
     //      ... more keys/values can be added depending on the material type (e.g. "texture", "sampler", "tint")
+    // The textures of the lit materials are then packed into texture arrays (see "texture-packer.hpp")
+    // and all the materials are compiled into the material table that the renderer draws from (see "material-table.hpp")
     template<>
     void AssetLoader<Material>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
+            std::vector<Material*> materials;
+            std::vector<LitMaterial*> litMaterials;
             for(auto& [name, desc] : data.items()){
                 std::string type = desc.value("type", "");
                 auto material = createMaterialFromType(type);
                 material->deserialize(desc);
                 assets[name] = material;
+                materials.push_back(material);
+                if(auto litMaterial = dynamic_cast<LitMaterial*>(material)) litMaterials.push_back(litMaterial);
             }
+            // The materials are compiled after packing since the compiled lit materials refer to their texture arrays
+            TexturePacker::pack(litMaterials);
+            MaterialTable::add(materials);
         }
     };
 
@@ -109,6 +156,8 @@ namespace our {
             AssetLoader<Mesh>::deserialize(assetData["meshes"]);
         if(assetData.contains("materials"))
             AssetLoader<Material>::deserialize(assetData["materials"]);
+        // The shaders were compiling while the other assets were loaded, so most of them should be ready by now
+        ShaderProgram::finishPendingLinks();
     }
 
     void clearAllAssets(){
@@ -117,6 +166,8 @@ namespace our {
         AssetLoader<Sampler>::clear();
         AssetLoader<Mesh>::clear();
         AssetLoader<Material>::clear();
+        TexturePacker::clear();
+        MaterialTable::clear();
     }
 
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "mesh-renderer.hpp"
 #include "../asset-loader.hpp"
+#include "../deserialize-utils.hpp"
 
 namespace our {
     // Receives the mesh & material from the AssetLoader by the names given in the json object
@@ -16,5 +17,7 @@ namespace our {
         mesh = AssetLoader<Mesh>::get(data["mesh"].get<std::string>());
         // Get the material from the AssetLoader by "material" name
         material = AssetLoader<Material>::get(data["material"].get<std::string>());
+        // Get the optional per object tint
+        tint = data.value("tint", tint);
     }
 }
\ No newline at end of file
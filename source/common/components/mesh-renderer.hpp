@@ -12,6 +12,8 @@ namespace our {
     public:
         Mesh* mesh; // The mesh that should be drawn
         Material* material; // The material used to draw the mesh
+        glm::vec4 tint = {1, 1, 1, 1}; // A color multiplied by the vertex color of this object (only used by instanced shaders)
+        bool staticBatched = false; // Set by the static batcher if this object is drawn as a part of a static batch
 
         // The ID of this component type is "Mesh Renderer"
         static std::string getID() { return "Mesh Renderer"; }
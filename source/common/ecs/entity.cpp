@@ -1,4 +1,5 @@
 #include "entity.hpp"
+#include "world.hpp"
 #include "../deserialize-utils.hpp"
 #include "../components/component-deserializer.hpp"
 
@@ -25,6 +26,11 @@ namespace our {
         return localToWorld;
     }
 
+    // Adds this entity to the changed entities of its world so the systems that cache its data (e.g. the renderer) update it
+    void Entity::markChanged(){
+        if(world) world->markChanged(this);
+    }
+
     // Deserializes the entity data and components from a json object
     void Entity::deserialize(const nlohmann::json& data){
         if(!data.is_object()) return;
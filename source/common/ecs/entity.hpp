@@ -26,6 +26,7 @@ namespace our {
         World* getWorld() const { return world; } // Returns the world to which this entity belongs
 
         glm::mat4 getLocalToWorldMatrix() const; // Computes and returns the transformation from the entities local space to the world space
+        void markChanged(); // Tells the world that the transform or the components of this entity changed (must be called after changing them)
         void deserialize(const nlohmann::json&); // Deserializes the entity data and components from a json object
         
         // This template method create a component of type T,
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <unordered_set>
+#include <vector>
 #include "entity.hpp"
 
 namespace our {
@@ -10,6 +11,10 @@ namespace our {
         std::unordered_set<Entity*> entities; // These are the entities held by this world
         std::unordered_set<Entity*> markedForRemoval; // These are the entities that are awaiting to be deleted
                                                       // when deleteMarkedEntities is called
+        // The entities that were added, changed (see "markChanged") or removed since the last call to "takeChanges"
+        // They allow a system to keep its own data about the entities (e.g. the render list) and only update it when something changes
+        std::unordered_set<Entity*> addedEntities, changedEntities;
+        std::vector<Entity*> removedEntities; // These pointers are deleted so they must only be compared, never used
     public:
 
         World() = default;
@@ -33,6 +38,8 @@ namespace our {
             entity->world = this;
             // insert it in the container of entities
             entities.insert(entity);
+            // and remember it as a new entity (its components are read by the systems once they take the changes)
+            addedEntities.insert(entity);
             // return it
             return entity;
         }
@@ -62,12 +69,32 @@ namespace our {
             for(auto entity: markedForRemoval){
                 // erase it from entities and delete it 
                 entities.erase(entity);
+                addedEntities.erase(entity);
+                changedEntities.erase(entity);
+                removedEntities.push_back(entity);
                 delete entity;
             }
             // clear all markedForRemoval entities.
             markedForRemoval.clear();
         }
 
+        // Records that the transform or the components of the entity changed (an entity added since the last "takeChanges" is already new)
+        void markChanged(Entity* entity){
+            if(entities.find(entity) != entities.end() && addedEntities.find(entity) == addedEntities.end())
+                changedEntities.insert(entity);
+        }
+
+        // Moves the entities added, changed and removed since the last call into the given vectors then forgets them.
+        // The removed entities are already deleted so they must only be compared with other pointers.
+        void takeChanges(std::vector<Entity*>& added, std::vector<Entity*>& changed, std::vector<Entity*>& removed){
+            added.assign(addedEntities.begin(), addedEntities.end());
+            changed.assign(changedEntities.begin(), changedEntities.end());
+            removed.swap(removedEntities);
+            addedEntities.clear();
+            changedEntities.clear();
+            removedEntities.clear();
+        }
+
         //This deletes all entities in the world
         void clear(){
             //TODO: (Req 8) Delete all the entites and make sure that the containers are empty
@@ -77,7 +104,10 @@ namespace our {
             for(auto entity: entities){
                 // delete the entity
                 delete entity;
+                removedEntities.push_back(entity);
             }
+            addedEntities.clear();
+            changedEntities.clear();
             // clear all entites
             entities.clear();
             // clear all markedForRemoval entities.
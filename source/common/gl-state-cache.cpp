@@ -0,0 +1,212 @@
+#include "gl-state-cache.hpp"
+
+namespace our {
+
+    // A cached value and whether we know it (a value is unknown until it is set through the cache)
+    template<typename T>
+    struct Cached {
+        T value{};
+        bool known = false;
+    };
+
+    // The texture targets whose bindings are cached for each texture unit
+    static constexpr GLenum cachedTextureTargets[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER };
+    static constexpr int CACHED_TEXTURE_TARGET_COUNT = sizeof(cachedTextureTargets) / sizeof(GLenum);
+
+    // Returns the index of the target in "cachedTextureTargets" or -1 if its bindings are not cached
+    static int textureTargetIndex(GLenum target){
+        for(int index = 0; index < CACHED_TEXTURE_TARGET_COUNT; index++)
+            if(cachedTextureTargets[index] == target) return index;
+        return -1;
+    }
+
+    // All the values shadowed by the cache
+    struct ShadowState {
+        Cached<bool> cullFaceEnabled, depthTestEnabled, blendEnabled;
+        Cached<GLenum> cullFace, frontFace, depthFunc, blendEquation;
+        Cached<glm::uvec4> blendFunc;
+        Cached<glm::vec4> blendColor;
+        Cached<glm::bvec4> colorMask;
+        Cached<bool> depthMask;
+        Cached<GLuint> program, vertexArray, drawFramebuffer, readFramebuffer, activeTexture;
+        Cached<GLuint> textures[GLStateCache::MAX_TEXTURE_UNITS][CACHED_TEXTURE_TARGET_COUNT];
+        Cached<GLuint> samplers[GLStateCache::MAX_TEXTURE_UNITS];
+    };
+    static ShadowState state;
+    static GLStateCache::Counters counters, lastFrameCounters;
+
+    // Updates the cached value and returns true if the call must be issued (the value was unknown or different)
+    template<typename T>
+    static bool change(Cached<T>& cached, const T& value){
+        if(cached.known && cached.value == value){
+            counters.elided++;
+            return false;
+        }
+        cached.value = value;
+        cached.known = true;
+        counters.issued++;
+        return true;
+    }
+
+    // If the cached value is equal to the deleted object, OpenGL reverted the binding to 0
+    static void unbindDeleted(Cached<GLuint>& cached, GLuint name){
+        if(cached.known && cached.value == name) cached.value = 0;
+    }
+
+    void GLStateCache::invalidate(){
+        state = ShadowState();
+    }
+
+    void GLStateCache::beginFrame(){
+        invalidate();
+        lastFrameCounters = counters;
+        counters = Counters();
+    }
+
+    const GLStateCache::Counters& GLStateCache::getCounters(){ return counters; }
+    const GLStateCache::Counters& GLStateCache::getLastFrameCounters(){ return lastFrameCounters; }
+
+    void GLStateCache::setEnabled(GLenum capability, bool enabled){
+        Cached<bool>* cached = nullptr;
+        switch(capability){
+            case GL_CULL_FACE: cached = &state.cullFaceEnabled; break;
+            case GL_DEPTH_TEST: cached = &state.depthTestEnabled; break;
+            case GL_BLEND: cached = &state.blendEnabled; break;
+        }
+        if(cached && !change(*cached, enabled)) return;
+        if(!cached) counters.issued++;
+        if(enabled) glEnable(capability);
+        else glDisable(capability);
+    }
+
+    void GLStateCache::cullFace(GLenum face){
+        if(change(state.cullFace, face)) glCullFace(face);
+    }
+
+    void GLStateCache::frontFace(GLenum winding){
+        if(change(state.frontFace, winding)) glFrontFace(winding);
+    }
+
+    void GLStateCache::depthFunc(GLenum function){
+        if(change(state.depthFunc, function)) glDepthFunc(function);
+    }
+
+    void GLStateCache::blendEquation(GLenum equation){
+        if(change(state.blendEquation, equation)) glBlendEquation(equation);
+    }
+
+    void GLStateCache::blendFunc(GLenum sourceFactor, GLenum destinationFactor){
+        if(change(state.blendFunc, glm::uvec4(sourceFactor, destinationFactor, sourceFactor, destinationFactor)))
+            glBlendFunc(sourceFactor, destinationFactor);
+    }
+
+    void GLStateCache::blendFuncSeparate(GLenum sourceColor, GLenum destinationColor, GLenum sourceAlpha, GLenum destinationAlpha){
+        if(change(state.blendFunc, glm::uvec4(sourceColor, destinationColor, sourceAlpha, destinationAlpha)))
+            glBlendFuncSeparate(sourceColor, destinationColor, sourceAlpha, destinationAlpha);
+    }
+
+    void GLStateCache::blendColor(const glm::vec4& color){
+        if(change(state.blendColor, color)) glBlendColor(color.r, color.g, color.b, color.a);
+    }
+
+    void GLStateCache::colorMask(const glm::bvec4& mask){
+        if(change(state.colorMask, mask)) glColorMask(mask.r, mask.g, mask.b, mask.a);
+    }
+
+    void GLStateCache::depthMask(bool mask){
+        if(change(state.depthMask, mask)) glDepthMask(mask);
+    }
+
+    void GLStateCache::useProgram(GLuint program){
+        if(change(state.program, program)) glUseProgram(program);
+    }
+
+    void GLStateCache::bindVertexArray(GLuint vertexArray){
+        if(change(state.vertexArray, vertexArray)) glBindVertexArray(vertexArray);
+    }
+
+    void GLStateCache::bindFramebuffer(GLenum target, GLuint framebuffer){
+        if(target == GL_FRAMEBUFFER){
+            // Binding both targets is a single call, so it can only be skipped if both are already bound
+            bool same = state.drawFramebuffer.known && state.drawFramebuffer.value == framebuffer &&
+                        state.readFramebuffer.known && state.readFramebuffer.value == framebuffer;
+            state.drawFramebuffer = state.readFramebuffer = {framebuffer, true};
+            if(same){
+                counters.elided++;
+                return;
+            }
+            counters.issued++;
+            glBindFramebuffer(target, framebuffer);
+        } else if(change(target == GL_READ_FRAMEBUFFER ? state.readFramebuffer : state.drawFramebuffer, framebuffer)){
+            glBindFramebuffer(target, framebuffer);
+        }
+    }
+
+    void GLStateCache::activeTexture(GLuint unit){
+        if(change(state.activeTexture, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    void GLStateCache::bindTexture(GLenum target, GLuint texture){
+        int targetIndex = textureTargetIndex(target);
+        // The bindings of unknown targets or units are not cached
+        if(targetIndex < 0 || !state.activeTexture.known || state.activeTexture.value >= MAX_TEXTURE_UNITS){
+            counters.issued++;
+            glBindTexture(target, texture);
+            return;
+        }
+        if(change(state.textures[state.activeTexture.value][targetIndex], texture)) glBindTexture(target, texture);
+    }
+
+    void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture){
+        // If the texture is already bound to this unit, we don't even need to select the unit
+        int targetIndex = textureTargetIndex(target);
+        if(targetIndex >= 0 && unit < MAX_TEXTURE_UNITS){
+            const Cached<GLuint>& cached = state.textures[unit][targetIndex];
+            if(cached.known && cached.value == texture){
+                counters.elided++;
+                return;
+            }
+        }
+        activeTexture(unit);
+        bindTexture(target, texture);
+    }
+
+    void GLStateCache::bindSampler(GLuint unit, GLuint sampler){
+        if(unit >= MAX_TEXTURE_UNITS){
+            counters.issued++;
+            glBindSampler(unit, sampler);
+            return;
+        }
+        if(change(state.samplers[unit], sampler)) glBindSampler(unit, sampler);
+    }
+
+    void GLStateCache::onTextureDeleted(GLuint texture){
+        if(texture == 0) return;
+        for(auto& unit : state.textures)
+            for(auto& binding : unit)
+                unbindDeleted(binding, texture);
+    }
+
+    void GLStateCache::onSamplerDeleted(GLuint sampler){
+        if(sampler == 0) return;
+        for(auto& binding : state.samplers)
+            unbindDeleted(binding, sampler);
+    }
+
+    void GLStateCache::onProgramDeleted(GLuint program){
+        // A program that is in use stays in use after being deleted (until another program is used)
+        // but its name may be given to a new program, so we just forget it
+        if(program != 0 && state.program.known && state.program.value == program) state.program.known = false;
+    }
+
+    void GLStateCache::onVertexArrayDeleted(GLuint vertexArray){
+        if(vertexArray != 0) unbindDeleted(state.vertexArray, vertexArray);
+    }
+
+    void GLStateCache::onFramebufferDeleted(GLuint framebuffer){
+        if(framebuffer == 0) return;
+        unbindDeleted(state.drawFramebuffer, framebuffer);
+        unbindDeleted(state.readFramebuffer, framebuffer);
+    }
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+
+namespace our {
+
+    // The GL state cache shadows the parts of the OpenGL state that change often while drawing
+    // (enables, depth/blend/cull parameters, masks, the program, the vertex array, the textures & samplers of each unit and the framebuffers).
+    // Every call is compared with the value that we know is currently set and is only sent to the driver if it changes something.
+    // A value is "unknown" until we set it ourselves, so the first call after "invalidate" is always issued.
+    // Any code that changes these states without going through the cache (e.g. ImGui) must be followed by a call to "invalidate".
+    class GLStateCache {
+    public:
+        // The number of calls that were sent to the driver and the number of calls that were skipped since they wouldn't change anything
+        struct Counters {
+            std::size_t issued = 0;
+            std::size_t elided = 0;
+        };
+
+        // The number of texture units whose bindings are cached (bindings to higher units are always issued)
+        static constexpr GLuint MAX_TEXTURE_UNITS = 32;
+
+        // Forgets every cached value (the next call of each kind will be issued)
+        static void invalidate();
+        // Should be called at the start of every frame: invalidates the cache (since other code may have changed the state since the last frame)
+        // and moves the counters of the current frame to the last frame counters
+        static void beginFrame();
+        // Returns the counters of the current frame (since the last call to "beginFrame")
+        static const Counters& getCounters();
+        // Returns the counters of the last complete frame
+        static const Counters& getLastFrameCounters();
+
+        // Capabilities (glEnable/glDisable). Only GL_CULL_FACE, GL_DEPTH_TEST and GL_BLEND are cached, the others are always issued
+        static void setEnabled(GLenum capability, bool enabled);
+        // Face culling parameters
+        static void cullFace(GLenum face);
+        static void frontFace(GLenum winding);
+        // Depth testing parameters
+        static void depthFunc(GLenum function);
+        // Blending parameters
+        static void blendEquation(GLenum equation);
+        static void blendFunc(GLenum sourceFactor, GLenum destinationFactor);
+        static void blendFuncSeparate(GLenum sourceColor, GLenum destinationColor, GLenum sourceAlpha, GLenum destinationAlpha);
+        static void blendColor(const glm::vec4& color);
+        // Write masks
+        static void colorMask(const glm::bvec4& mask);
+        static void depthMask(bool mask);
+
+        // Object bindings
+        static void useProgram(GLuint program);
+        static void bindVertexArray(GLuint vertexArray);
+        // GL_FRAMEBUFFER binds both the draw and the read framebuffers
+        static void bindFramebuffer(GLenum target, GLuint framebuffer);
+        // Selects the texture unit used by "bindTexture" (the unit is a number, not GL_TEXTUREi)
+        static void activeTexture(GLuint unit);
+        // Binds a texture to the given target of the active texture unit
+        static void bindTexture(GLenum target, GLuint texture);
+        // Selects the given texture unit then binds the texture to it
+        static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+        static void bindSampler(GLuint unit, GLuint sampler);
+
+        // Should be called when an object is deleted: OpenGL unbinds deleted objects and their names may be reused,
+        // so the cache must not keep them
+        static void onTextureDeleted(GLuint texture);
+        static void onSamplerDeleted(GLuint sampler);
+        static void onProgramDeleted(GLuint program);
+        static void onVertexArrayDeleted(GLuint vertexArray);
+        static void onFramebufferDeleted(GLuint framebuffer);
+    };
+
+}
@@ -0,0 +1,90 @@
+#include "job-system.hpp"
+
+#include <algorithm>
+
+namespace our {
+
+    JobSystem& JobSystem::get(){
+        static JobSystem jobSystem;
+        return jobSystem;
+    }
+
+    void JobSystem::start(int workerCount){
+        stop();
+        if(workerCount < 0){
+            // hardware_concurrency may return 0 if it can't tell
+            unsigned int cores = std::thread::hardware_concurrency();
+            workerCount = cores > 1 ? (int)cores - 1 : 0;
+        }
+        stopping = false;
+        for(int i = 0; i < workerCount; i++) workers.emplace_back(&JobSystem::workerLoop, this);
+    }
+
+    void JobSystem::stop(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+        for(auto& worker : workers) worker.join();
+        workers.clear();
+    }
+
+    void JobSystem::runChunks(){
+        for(size_t chunk = nextChunk.fetch_add(1); chunk < chunkCount; chunk = nextChunk.fetch_add(1)){
+            size_t begin = chunk * chunkSize;
+            (*job)(begin, std::min(begin + chunkSize, count));
+        }
+    }
+
+    void JobSystem::workerLoop(){
+        std::uint64_t seenGeneration = 0;
+        {
+            // A worker started while a job is running must not join it (it wasn't counted in "busyWorkers")
+            std::lock_guard<std::mutex> lock(mutex);
+            seenGeneration = generation;
+        }
+        while(true){
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeCondition.wait(lock, [&]{ return stopping || generation != seenGeneration; });
+                if(stopping) return;
+                seenGeneration = generation;
+            }
+            runChunks();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(--busyWorkers == 0) doneCondition.notify_one();
+            }
+        }
+    }
+
+    void JobSystem::parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t begin, size_t end)>& function){
+        chunkSize = std::max<size_t>(chunkSize, 1);
+        size_t chunkCount = getChunkCount(count, chunkSize);
+        if(chunkCount == 0) return;
+        if(chunkCount == 1 || workers.empty()){
+            for(size_t begin = 0; begin < count; begin += chunkSize) function(begin, std::min(begin + chunkSize, count));
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->job = &function;
+            this->count = count;
+            this->chunkSize = chunkSize;
+            this->chunkCount = chunkCount;
+            nextChunk.store(0);
+            busyWorkers = workers.size();
+            generation++;
+        }
+        wakeCondition.notify_all();
+        // The main thread works too instead of just waiting
+        runChunks();
+        // Every worker must leave the job before it is replaced (even if it found no chunk to run)
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [&]{ return busyWorkers == 0; });
+        job = nullptr;
+    }
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace our {
+
+    // The job system owns a few worker threads that help the main thread with the CPU work of a frame
+    // (e.g. culling the render commands and sorting them). It only runs CPU code: the OpenGL calls must stay on the main thread.
+    // The work is given as a range of indices split into chunks of a fixed size. The chunks are taken one by one by the workers
+    // and the main thread (which also takes chunks while waiting), so the chunks of a slow part of the range are balanced automatically.
+    // Since the chunk boundaries don't depend on the number of threads, a job can write its results per chunk and merge them
+    // in the chunk order to get the same result as a serial loop.
+    class JobSystem {
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wakeCondition, doneCondition;
+        bool stopping = false;
+
+        // The current job (only valid while "busyWorkers" is not 0)
+        const std::function<void(size_t, size_t)>* job = nullptr;
+        size_t count = 0, chunkSize = 1, chunkCount = 0;
+        std::atomic<size_t> nextChunk{0};
+        // The number of workers that didn't finish the current job and the number of jobs started so far (wakes the workers up)
+        size_t busyWorkers = 0;
+        std::uint64_t generation = 0;
+
+        JobSystem() = default;
+        // Takes and runs the chunks of the current job until none is left
+        void runChunks();
+        void workerLoop();
+
+    public:
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+        // The workers must be joined before the threads are destroyed (otherwise std::terminate is called)
+        ~JobSystem(){ stop(); }
+
+        // Returns the job system shared by the whole application
+        static JobSystem& get();
+
+        // Starts the given number of worker threads (a negative count uses one thread per core except the main thread's).
+        // Calling it again replaces the workers. With 0 workers, everything runs on the main thread.
+        void start(int workerCount = -1);
+        // Stops and joins the workers (should be called before the application exits)
+        void stop();
+
+        // The number of threads that run the chunks of a job (the workers & the main thread)
+        size_t getThreadCount() const { return workers.size() + 1; }
+
+        // Calls "function(begin, end)" for every chunk [begin, end) of [0, count) where every chunk has "chunkSize" indices except the last one.
+        // Returns once all the chunks are done. If there is a single chunk (or no workers), it runs directly on the calling thread.
+        // It must only be called by one thread at a time, the thread that draws (a job can't start another job).
+        void parallelFor(size_t count, size_t chunkSize, const std::function<void(size_t begin, size_t end)>& function);
+
+        // Returns the number of chunks that "parallelFor" splits "count" indices into
+        static size_t getChunkCount(size_t count, size_t chunkSize) { return chunkSize == 0 ? 0 : (count + chunkSize - 1) / chunkSize; }
+    };
+
+}
@@ -0,0 +1,103 @@
+#include "material-table.hpp"
+#include "../gl-state-cache.hpp"
+
+#include <algorithm>
+
+namespace our {
+
+    void MaterialTable::add(const std::vector<Material*>& materials){
+        bool added = false;
+        for(Material* material : materials){
+            if(!material || material->tableIndex != INVALID_INDEX) continue;
+            CompiledMaterial compiled;
+            material->compile(compiled);
+            // The materials with equal pipeline states share the same id, so the renderer only applies a state when it really changes
+            auto state = std::find(pipelineStates.begin(), pipelineStates.end(), material->pipelineState);
+            compiled.pipelineStateId = (std::uint32_t)(state - pipelineStates.begin());
+            if(state == pipelineStates.end()) pipelineStates.push_back(material->pipelineState);
+            material->tableIndex = (std::uint32_t)MaterialTable::materials.size();
+            MaterialTable::materials.push_back(compiled);
+            added = true;
+        }
+        if(added) upload();
+    }
+
+    void MaterialTable::upload(){
+        // Each block must start at a multiple of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT to be bound on its own
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        alignment = std::max(alignment, 16);
+        blockStride = ((GLsizeiptr)sizeof(MaterialParams) + alignment - 1) / alignment * alignment;
+
+        std::vector<std::uint8_t> data(materials.size() * blockStride, 0);
+        for(size_t index = 0; index < materials.size(); index++)
+            *(MaterialParams*)(data.data() + index * blockStride) = materials[index].params;
+
+        // The whole table is uploaded again when materials are added (this only happens while loading the assets)
+        if(!buffer) glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr)data.size(), data.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void MaterialTable::clear(){
+        materials.clear();
+        pipelineStates.clear();
+        if(buffer) glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+
+    ShaderProgram* MaterialTable::getProgram(std::uint32_t index, bool instanced, ProgramVariant variant){
+        CompiledMaterial& material = materials[index];
+        // The permutation is only looked up again when the light defines change (the lookup builds a string key)
+        if(material.programsVersion != lightDefinesVersion){
+            material.pendingProgram = material.lit ? material.shader->getPermutation(lightDefines) : material.shader;
+            material.programsVersion = lightDefinesVersion;
+        }
+        // A new permutation is linked in parallel (see ShaderProgram::beginLink) so using it right away would wait for the driver.
+        // Until it is done, the material keeps drawing with the program it had, or with its shader which handles every type of light
+        if(ShaderProgram* pending = material.pendingProgram){
+            ShaderProgram* pendingInstanced = pending->getInstancedVariant();
+            bool linked = pending->isLinkComplete() && (!pendingInstanced || pendingInstanced->isLinkComplete());
+            if(linked || !material.programs[0][0]){
+                ShaderProgram* program = linked ? pending : material.shader;
+                if(program != material.programs[0][0]){
+                    material.programs[0][0] = program;
+                    material.programs[0][1] = program->getInstancedVariant();
+                    // The weighted blended transparency is a permutation of the forward program so it is looked up again
+                    material.programs[1][0] = material.programs[1][1] = nullptr;
+                }
+                if(linked) material.pendingProgram = nullptr;
+            }
+        }
+        // Only some materials need the other variants (e.g. the transparent ones for the weighted blended transparency),
+        // so they are looked up on demand. The G-buffer doesn't depend on the lights, so it is a permutation of the material shader
+        int slot = (int)variant;
+        if(!material.programs[slot][0]){
+            ShaderProgram* program = variant == ProgramVariant::GBUFFER ?
+                material.shader->getPermutation({"GBUFFER"}) : material.programs[0][0]->getPermutation({"WEIGHTED_OIT"});
+            material.programs[slot][0] = program;
+            material.programs[slot][1] = program->getInstancedVariant();
+        }
+        return material.programs[slot][instanced ? 1 : 0];
+    }
+
+    void MaterialTable::bindBlock(std::uint32_t index){
+        glBindBufferRange(GL_UNIFORM_BUFFER, ShaderProgram::MATERIAL_BLOCK_BINDING, buffer, (GLintptr)(index * blockStride), sizeof(MaterialParams));
+    }
+
+    void MaterialTable::warmLightPermutations(const std::vector<std::string>& defines){
+        // Looking up the permutations starts their links, so all of them are compiled by the driver at the same time
+        for(CompiledMaterial& material : materials){
+            if(material.lit) material.shader->getPermutation(defines);
+        }
+        ShaderProgram::finishPendingLinks();
+    }
+
+    void MaterialTable::setLightDefines(const std::vector<std::string>& defines){
+        if(defines == lightDefines) return;
+        lightDefines = defines;
+        lightDefinesVersion++;
+    }
+
+}
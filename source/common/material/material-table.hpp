@@ -0,0 +1,108 @@
+#pragma once
+
+#include "material.hpp"
+#include "pipeline-state.hpp"
+#include "texture-packer.hpp"
+#include "../shader/shader.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // The uniform values of a material laid out like the "MaterialBlock" uniform block of the shaders (std140)
+    struct MaterialParams {
+        glm::vec4 tint = glm::vec4(1.0f);
+        float alphaThreshold = 0.0f;
+        std::int32_t textureLayer = 0;
+        float padding[2] = {}; // The size of a std140 block is rounded up to a multiple of 16 bytes
+    };
+
+    // The permutations of the material shaders that the renderer can draw with
+    enum class ProgramVariant {
+        FORWARD = 0,        // Shades the object (with the light defines for the lit materials)
+        WEIGHTED_OIT = 1,   // Writes to the accumulation targets of the weighted blended transparency
+        GBUFFER = 2         // Writes the surface data to the G-buffer of the deferred renderer (only for the lit materials)
+    };
+
+    // A material flattened into plain data by "Material::compile"
+    // The renderer reads it by index instead of calling the virtual "setup" of the material
+    struct CompiledMaterial {
+        // The permutation of the material shader that reads the uniforms of the material from the material block
+        ShaderProgram* shader = nullptr;
+        // Whether the shader is lit (the renderer sends the light clusters and picks the permutation of the lights in the scene)
+        bool lit = false;
+        // The index of the pipeline state in the material table (the materials with equal pipeline states share the same index)
+        std::uint32_t pipelineStateId = 0;
+        // The textures bound to the texture units 0 to textureCount - 1, and the uniform that receives the number of each unit
+        struct TextureBinding {
+            GLenum target = GL_TEXTURE_2D;
+            GLuint texture = 0, sampler = 0;
+            const UniformHandle* uniform = nullptr;
+        };
+        TextureBinding textures[LIT_TEXTURE_SLOT_COUNT];
+        int textureCount = 0;
+        // The values copied to the material block of this material
+        MaterialParams params;
+        // The programs picked for the current light defines and the version of the defines they were picked for
+        // indexed by the variant then by whether they are instanced (the variants other than FORWARD are picked the first time they are needed)
+        ShaderProgram* programs[3][2] = {};
+        std::uint32_t programsVersion = 0;
+        // The permutation for the current light defines while it is still being linked (it replaces "programs[0]" once it is done)
+        ShaderProgram* pendingProgram = nullptr;
+    };
+
+    // The material table holds a compiled copy of every loaded material.
+    // The parameters of all the materials are uploaded once to a uniform buffer (one aligned block per material) which stays on the GPU,
+    // so drawing with a material only binds the range of its block, its pipeline state, its program and its textures.
+    // The draw loop reads the materials by index (see Material::getTableIndex) so it doesn't need any virtual call or dynamic cast.
+    class MaterialTable {
+        static inline std::vector<CompiledMaterial> materials;
+        // The distinct pipeline states of the materials
+        static inline std::vector<PipelineState> pipelineStates;
+        // The uniform buffer holding the blocks of all the materials and the distance between two consecutive blocks
+        static inline GLuint buffer = 0;
+        static inline GLsizeiptr blockStride = 0;
+        // The defines describing the lights of the scene added to the shaders of the lit materials (see "setLightDefines")
+        static inline std::vector<std::string> lightDefines;
+        // Incremented whenever the light defines change so each material knows when to look up its permutation again
+        static inline std::uint32_t lightDefinesVersion = 1;
+
+        // Uploads the blocks of all the materials to a new buffer
+        static void upload();
+    public:
+        static constexpr std::uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+        // Compiles the given materials, adds them to the table and uploads their blocks
+        // (the materials that were already added are skipped)
+        static void add(const std::vector<Material*>& materials);
+        // Removes all the materials and deletes the buffer (should be called when the materials are cleared)
+        static void clear();
+
+        // Returns the compiled material with the given index
+        static const CompiledMaterial& get(std::uint32_t index) { return materials[index]; }
+        // Returns the pipeline state with the given id
+        static const PipelineState& getPipelineState(std::uint32_t id) { return pipelineStates[id]; }
+        // Returns the program used to draw the material with the given index (the permutation of the lights for the lit materials)
+        // The variant picks the permutation for the weighted blended transparency or the G-buffer (see ProgramVariant)
+        static ShaderProgram* getProgram(std::uint32_t index, bool instanced, ProgramVariant variant = ProgramVariant::FORWARD);
+        // Binds the block of the material with the given index to the material block binding point
+        static void bindBlock(std::uint32_t index);
+
+        // Sets the defines describing the lights of the scene (e.g. "HAS_POINT_LIGHTS" or "GLOBAL_LIGHT_COUNT 1")
+        // which are added to the shaders of the lit materials. It is called by the renderer every frame before drawing
+        static void setLightDefines(const std::vector<std::string>& defines);
+        // Compiles the permutations of the lit materials for the given light defines and waits for them,
+        // so the first frame with these lights doesn't wait for the driver (it is called while loading the scene)
+        static void warmLightPermutations(const std::vector<std::string>& defines);
+        // Returns the light defines of the current frame (e.g. for the lighting pass of the deferred renderer)
+        static const std::vector<std::string>& getLightDefines() { return lightDefines; }
+
+        static size_t getMaterialCount() { return materials.size(); }
+        static size_t getPipelineStateCount() { return pipelineStates.size(); }
+    };
+
+}
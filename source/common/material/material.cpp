@@ -1,15 +1,28 @@
 #include "material.hpp"
+#include "material-table.hpp"
 
 #include "../asset-loader.hpp"
 #include "deserialize-utils.hpp"
 
 namespace our {
 
+    // The uniforms sent by the materials are resolved once into handles, so "setup" never looks them up by string
+    static const UniformHandle tintUniform("tint");
+    static const UniformHandle alphaThresholdUniform("alphaThreshold");
+    static const UniformHandle texUniform("tex");
+    static const UniformHandle albedoUniform("material.albedo");
+    static const UniformHandle specularUniform("material.specular");
+    static const UniformHandle ambientOcclusionUniform("material.ambient_occlusion");
+    static const UniformHandle roughnessUniform("material.roughness");
+    static const UniformHandle emissiveUniform("material.emissive");
+    static const UniformHandle layerUniform("material_layer");
+
     // This function should setup the pipeline state and set the shader to be used
-    void Material::setup() const {
+    void Material::setup(const Material* previous, bool instanced) const {
         //TODO: (Req 6) Write this function
-        pipelineState.setup();
-        shader->use();
+        // Consecutive materials sharing the same pipeline state or program don't need to apply them again
+        if(!previous || previous->pipelineState != pipelineState) pipelineState.setup();
+        if(!previous || previous->getProgram(instanced) != getProgram(instanced)) getProgram(instanced)->use();
     }
 
     // This function read the material data from a json object
@@ -20,15 +33,24 @@ namespace our {
             pipelineState.deserialize(data["pipelineState"]);
         }
         shader = AssetLoader<ShaderProgram>::get(data["shader"].get<std::string>());
+        // The material can ask for a permutation of the shader compiled with some extra defines
+        if(data.contains("defines")){
+            shader = shader->getPermutation(data["defines"].get<std::vector<std::string>>());
+        }
         transparent = data.value("transparent", false);
     }
 
+    // The renderer draws the compiled materials using a permutation of their shader that reads the uniforms from the material block
+    void Material::compile(CompiledMaterial& compiled) const {
+        compiled.shader = shader->getPermutation({"MATERIAL_BLOCK"});
+    }
+
     // This function should call the setup of its parent and
     // set the "tint" uniform to the value in the member variable tint 
-    void TintedMaterial::setup() const {
+    void TintedMaterial::setup(const Material* previous, bool instanced) const {
         //TODO: (Req 6) Write this function
-        Material::setup();
-        shader->set("tint",tint);
+        Material::setup(previous, instanced);
+        getProgram(instanced)->set(tintUniform,tint);
     }
 
     // This function read the material data from a json object
@@ -38,19 +60,24 @@ namespace our {
         tint = data.value("tint", glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
     }
 
+    void TintedMaterial::compile(CompiledMaterial& compiled) const {
+        Material::compile(compiled);
+        compiled.params.tint = tint;
+    }
+
     // This function should call the setup of its parent and
     // set the "alphaThreshold" uniform to the value in the member variable alphaThreshold
     // Then it should bind the texture and sampler to a texture unit and send the unit number to the uniform variable "tex" 
-    void TexturedMaterial::setup() const {
+    void TexturedMaterial::setup(const Material* previous, bool instanced) const {
         //TODO: (Req 6) Write this function
-        TintedMaterial::setup();
-        shader->set("alphaThreshold",alphaThreshold);
+        TintedMaterial::setup(previous, instanced);
+        getProgram(instanced)->set(alphaThresholdUniform,alphaThreshold);
         if(texture != NULL && sampler !=NULL)
         {
-        glActiveTexture(GL_TEXTURE0); //we send it unit 0 
+        GLStateCache::activeTexture(0); //we send it unit 0 
         texture->bind();
         sampler->bind(0);
-        shader->set("tex",0);
+        getProgram(instanced)->set(texUniform,0);
         }
     }
 
@@ -60,75 +87,65 @@ namespace our {
         TintedMaterial::deserialize(data);
         if(!data.is_object()) return;
         alphaThreshold = data.value("alphaThreshold", 0.0f);
+        // The alpha test is only compiled into the permutation of the materials that need it, so the others keep their early depth test
+        // (this permutation has no depth variant so these materials are not drawn in the depth pre-pass)
+        if(alphaThreshold > 0.0f) shader = shader->getPermutation({"ALPHA_TEST"});
         texture = AssetLoader<Texture2D>::get(data.value("texture", ""));
         sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
     }
 
+    void TexturedMaterial::compile(CompiledMaterial& compiled) const {
+        TintedMaterial::compile(compiled);
+        compiled.params.alphaThreshold = alphaThreshold;
+        if(texture != NULL && sampler != NULL){
+            compiled.textures[0] = {GL_TEXTURE_2D, texture->getOpenGLName(), sampler->getOpenGLName(), &texUniform};
+            compiled.textureCount = 1;
+        }
+    }
+
     // ------------------- light material ------------------- //
-     void LitMaterial::setup() const {
+     void LitMaterial::setup(const Material* previous, bool instanced) const {
         // call setup function for textured material
-        TexturedMaterial::setup(); 
-
-        // if it's albedo
-        if (albedo){
-            // Here we set the active texture unit to 0 
-            glActiveTexture(GL_TEXTURE0);
-            // then bind the texture to it
-            albedo->bind();
-            // binds this sampler to texture unit 0
-            sampler->bind(0);
-            // send the unit number 0 to 'albedo' in the uniform variable material
-            shader->set("material.albedo",0);
+        TexturedMaterial::setup(previous, instanced); 
+
+        // The textures are read from the texture arrays of the set (if the material was packed)
+        if (textureSet){
+            // the uniforms of the five slots in the order of their texture units
+            // (albedo: 0, specular: 1, ambient_occlusion: 2, roughness: 3, emissive: 4)
+            const UniformHandle* slotUniforms[LIT_TEXTURE_SLOT_COUNT] = {
+                &albedoUniform, &specularUniform, &ambientOcclusionUniform, &roughnessUniform, &emissiveUniform
+            };
+            for(int slot = 0; slot < LIT_TEXTURE_SLOT_COUNT; slot++){
+                // Here we set the active texture unit to the slot then bind the array and the sampler to it
+                GLStateCache::activeTexture(slot);
+                textureSet->arrays[slot]->bind();
+                sampler->bind(slot);
+                // send the unit number to the uniform of the slot in the uniform variable material
+                getProgram(instanced)->set(*slotUniforms[slot], slot);
+            }
+            // The instanced variant reads the layer from the instance data instead
+            if(!instanced) getProgram(instanced)->set(layerUniform, getTextureLayer());
         }
+        GLStateCache::activeTexture(0);
+    }
 
-        // if it's specular
-        if (specular){
-            // Here we set the active texture unit to 1
-            glActiveTexture(GL_TEXTURE1);  
-            // then bind the texture to it
-            specular->bind();
-            // binds this sampler to texture unit 1
-            sampler->bind(1);
-            // send the unit number 1 to 'specular' in the uniform variable material
-            shader->set("material.specular",1);
-        }
-        
-        // if it's ambient_occlusion
-        if (ambient_occlusion){
-            // Here we set the active texture unit to 2
-            glActiveTexture(GL_TEXTURE2);  
-            // then bind the texture to it
-            ambient_occlusion->bind();
-            // binds this sampler to texture unit 2
-            sampler->bind(2);
-            // send the unit number 2 to 'ambient_occlusion' in the uniform variable material
-            shader->set("material.ambient_occlusion",2);
+    void LitMaterial::compile(CompiledMaterial& compiled) const {
+        TexturedMaterial::compile(compiled);
+        // Only the compiled program gets the texture defines: the shader of the material keeps its depth variant for the pre-pass
+        compiled.shader = compiled.shader->getPermutation(textureDefines);
+        compiled.lit = true;
+        compiled.params.textureLayer = getTextureLayer();
+        // The lit shader reads the five texture arrays of the set (albedo: 0, specular: 1, ambient_occlusion: 2, roughness: 3, emissive: 4)
+        compiled.textureCount = 0;
+        if(textureSet){
+            const UniformHandle* slotUniforms[LIT_TEXTURE_SLOT_COUNT] = {
+                &albedoUniform, &specularUniform, &ambientOcclusionUniform, &roughnessUniform, &emissiveUniform
+            };
+            for(int slot = 0; slot < LIT_TEXTURE_SLOT_COUNT; slot++){
+                compiled.textures[slot] = {GL_TEXTURE_2D_ARRAY, textureSet->arrays[slot]->getOpenGLName(), sampler->getOpenGLName(), slotUniforms[slot]};
+            }
+            compiled.textureCount = LIT_TEXTURE_SLOT_COUNT;
         }
-        
-        // if it's roughness
-        if (roughness){
-            // Here we set the active texture unit to 3
-            glActiveTexture(GL_TEXTURE3);  
-            // then bind the texture to it
-            roughness->bind();
-            // binds this sampler to texture unit 3
-            sampler->bind(3);
-            // send the unit number 3 to 'roughness' in the uniform variable material
-            shader->set("material.roughness",3);
-        }
-  
-        // if it's emissive
-        if (emissive){
-            // Here we set the active texture unit to 4
-            glActiveTexture(GL_TEXTURE4); 
-            // then bind the texture to it 
-            emissive->bind();
-            // binds this sampler to texture unit 4
-            sampler->bind(4);
-            // send the unit number 4 to 'emissive' in the uniform variable material
-            shader->set("material.emissive",4);
-        }
-        glActiveTexture(GL_TEXTURE0);
     }
 
     // This function read the material data from a json object
@@ -172,6 +189,14 @@ namespace our {
         // get the value of sampler
         sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
 
+        // The shader can skip the samples of the missing textures (the texture packer fills their layers with constant colors),
+        // so a define is added for each missing texture except the albedo which the alpha test also reads
+        textureDefines.clear();
+        if(!specular) textureDefines.push_back("NO_SPECULAR_MAP");
+        if(!ambient_occlusion) textureDefines.push_back("NO_AMBIENT_OCCLUSION_MAP");
+        if(!roughness) textureDefines.push_back("NO_ROUGHNESS_MAP");
+        if(!emissive) textureDefines.push_back("NO_EMISSIVE_MAP");
+
     }
 
 }
\ No newline at end of file
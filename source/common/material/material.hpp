@@ -4,12 +4,18 @@
 #include "../texture/texture2d.hpp"
 #include "../texture/sampler.hpp"
 #include "../shader/shader.hpp"
+#include "texture-packer.hpp"
 
 #include <glm/vec4.hpp>
 #include <json/json.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 namespace our {
 
+    struct CompiledMaterial;
+
     // This is the base class for all the materials
     // It contains the 3 essential components required by any material
     // 1- The pipeline state when drawing objects using this material
@@ -17,15 +23,43 @@ namespace our {
     // 3- Whether this material is transparent or not
     // Materials that send uniforms to the shader should inherit from the is material and add the required uniforms
     class Material {
+        // A small sequential id used by the render queue to group the draws using the same material
+        static inline std::uint32_t nextSortId = 0;
+        std::uint32_t sortId = nextSortId++;
+        // The materials that can be drawn in the same draw call share a batch id (see TexturePacker), otherwise it is the sort id
+        std::uint32_t batchId = sortId;
+        // The layer of the textures of this material in the texture arrays of its set (0 if its textures are not packed)
+        int textureLayer = 0;
+        // The index of the compiled copy of this material in the material table (see MaterialTable)
+        std::uint32_t tableIndex = 0xFFFFFFFF;
+        friend class TexturePacker;
+        friend class MaterialTable;
     public:
         PipelineState pipelineState;
         ShaderProgram* shader;
         bool transparent;
         
         // This function does 2 things: setup the pipeline state and set the shader program to be used
-        virtual void setup() const;
+        // If "previous" is the material set up right before this one (with the same "instanced" value), the pipeline state
+        // and the program are only applied if they differ from the ones it already applied
+        // If "instanced" is true, the instanced variant of the shader is used (the shader must have one)
+        virtual void setup(const Material* previous = nullptr, bool instanced = false) const;
+        // Returns the program that "setup" uses: the shader or its instanced variant
+        ShaderProgram* getProgram(bool instanced) const { return instanced ? shader->getInstancedVariant() : shader; }
         // This function read a material from a json object
         virtual void deserialize(const nlohmann::json& data);
+        // Flattens the material into plain data (the shader permutation, the textures to bind and the uniform values)
+        // so the renderer can draw it without calling "setup". It is called once when the material is added to the material table
+        virtual void compile(CompiledMaterial& compiled) const;
+
+        // Returns the id used to sort the draw commands by material
+        std::uint32_t getSortId() const { return sortId; }
+        // Returns the id used to group the draws of the materials that can share a draw call
+        std::uint32_t getBatchId() const { return batchId; }
+        // Returns the layer sent with the instances of this material to read its textures from the texture arrays
+        int getTextureLayer() const { return textureLayer; }
+        // Returns the index of this material in the material table (0xFFFFFFFF if it was not added to the table)
+        std::uint32_t getTableIndex() const { return tableIndex; }
     };
 
     // This material adds a uniform for a tint (a color that will be sent to the shader)
@@ -34,8 +68,9 @@ namespace our {
     public:
         glm::vec4 tint;
 
-        void setup() const override;
+        void setup(const Material* previous = nullptr, bool instanced = false) const override;
         void deserialize(const nlohmann::json& data) override;
+        void compile(CompiledMaterial& compiled) const override;
     };
 
     // This material adds two uniforms (besides the tint from Tinted Material)
@@ -49,8 +84,9 @@ namespace our {
         Sampler* sampler;
         float alphaThreshold;
 
-        void setup() const override;
+        void setup(const Material* previous = nullptr, bool instanced = false) const override;
         void deserialize(const nlohmann::json& data) override;
+        void compile(CompiledMaterial& compiled) const override;
     };
 
     // lighting material class
@@ -61,17 +97,25 @@ namespace our {
     // ambient_occlusion: which is used to represent how much ambient each part should get, not all locations get the same ambient.
     // roughness: which is used to represent the shininess of the material.
     // emissive: which is used to make the object emit its own light
+    // When the material is loaded, the five textures are copied to the same layer of the texture arrays of a texture set
+    // (see TexturePacker) and the shader reads them from these arrays
     class LitMaterial : public TexturedMaterial {
     public:
-        Texture2D* albedo;
-        Texture2D* specular;
-        Texture2D* ambient_occlusion;
-        Texture2D* roughness;
-        Texture2D* emissive;
-        Sampler* sampler;
+        // A texture that the material doesn't have stays null (see LitMaterial::deserialize)
+        Texture2D* albedo = nullptr;
+        Texture2D* specular = nullptr;
+        Texture2D* ambient_occlusion = nullptr;
+        Texture2D* roughness = nullptr;
+        Texture2D* emissive = nullptr;
+        Sampler* sampler = nullptr;
+        // The texture arrays that hold the textures of this material (set by the texture packer)
+        const TextureSet* textureSet = nullptr;
+        // The defines telling the shader which textures are missing (e.g. "NO_EMISSIVE_MAP"), added to the compiled program
+        std::vector<std::string> textureDefines;
 
-        void setup() const override;            
+        void setup(const Material* previous = nullptr, bool instanced = false) const override;            
         void deserialize(const nlohmann::json& data) override;
+        void compile(CompiledMaterial& compiled) const override;
     };
 
     // This function returns a new material instance based on the given type
@@ -63,4 +63,16 @@ namespace our {
         depthMask = data.value("depthMask", depthMask);
     }
 
+    bool PipelineState::operator==(const PipelineState& other) const {
+        // Disabled options are ignored since they don't affect the pipeline
+        if(faceCulling.enabled != other.faceCulling.enabled) return false;
+        if(faceCulling.enabled && (faceCulling.culledFace != other.faceCulling.culledFace || faceCulling.frontFace != other.faceCulling.frontFace)) return false;
+        if(depthTesting.enabled != other.depthTesting.enabled) return false;
+        if(depthTesting.enabled && depthTesting.function != other.depthTesting.function) return false;
+        if(blending.enabled != other.blending.enabled) return false;
+        if(blending.enabled && (blending.equation != other.blending.equation || blending.sourceFactor != other.blending.sourceFactor ||
+            blending.destinationFactor != other.blending.destinationFactor || blending.constantColor != other.blending.constantColor)) return false;
+        return colorMask == other.colorMask && depthMask == other.depthMask;
+    }
+
 }
\ No newline at end of file
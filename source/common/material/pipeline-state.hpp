@@ -1,8 +1,11 @@
 #pragma once
 
+#include "../gl-state-cache.hpp"
+
 #include <glad/gl.h>
 #include <glm/vec4.hpp>
 #include <json/json.hpp>
+#include <cstdint>
 
 namespace our {
     // There are some options in the render pipeline that we cannot control via shaders
@@ -40,6 +43,7 @@ namespace our {
 
         // This function should set the OpenGL options to the values specified by this structure
         // For example, if faceCulling.enabled is true, you should call glEnable(GL_CULL_FACE), otherwise, you should call glDisable(GL_CULL_FACE)
+        // All the calls go through the GLStateCache, so the options that are already set are not sent to the driver again
         void setup() const {
             //TODO: (Req 4) Write this function
         
@@ -93,9 +97,9 @@ namespace our {
        
        */
             if (this->faceCulling.enabled) {
-                glEnable(GL_CULL_FACE); //enable face culling
-                glCullFace(this->faceCulling.culledFace);//remove the back face which is cw
-                glFrontFace(this->faceCulling.frontFace);//define  the front face is  GL_CCW : counter clock wise 132 
+                GLStateCache::setEnabled(GL_CULL_FACE, true); //enable face culling
+                GLStateCache::cullFace(this->faceCulling.culledFace);//remove the back face which is cw
+                GLStateCache::frontFace(this->faceCulling.frontFace);//define  the front face is  GL_CCW : counter clock wise 132 
                 /*
                 counter clock wise is front 
                       /3\
@@ -108,7 +112,7 @@ namespace our {
                 */
 
             } else {
-                glDisable(GL_CULL_FACE); //disable face culling
+                GLStateCache::setEnabled(GL_CULL_FACE, false); //disable face culling
             }
 
            /*
@@ -159,12 +163,12 @@ namespace our {
                 buffer by increasing the number of bits 
                 or decrease the distance between near and far 
                 so ir will have higher precision */ 
-                glEnable(GL_DEPTH_TEST);//enable depth testing
-                glDepthFunc(this->depthTesting.function); //define the function that is GL_LEQUAL which means that take the nearst value
+                GLStateCache::setEnabled(GL_DEPTH_TEST, true);//enable depth testing
+                GLStateCache::depthFunc(this->depthTesting.function); //define the function that is GL_LEQUAL which means that take the nearst value
 
               
             } else {
-                glDisable(GL_DEPTH_TEST);//disable test depth
+                GLStateCache::setEnabled(GL_DEPTH_TEST, false);//disable test depth
             }
 
             /*
@@ -236,12 +240,12 @@ namespace our {
                     Sort from Farthest to Nearest.
                      Draw Opaque Objects first 
                 */
-                glEnable(GL_BLEND); //enable blending
-                glBlendEquation(this->blending.equation); // GL_FUNC_ADD 
-                glBlendFunc(this->blending.sourceFactor, this->blending.destinationFactor);//glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-                glBlendColor(this->blending.constantColor.r, this->blending.constantColor.g, this->blending.constantColor.b, this->blending.constantColor.a);//The GL_BLEND_COLOR may be used to calculate the source and destination blending factors. The color components are clamped to the range [0,1]before being stored.
+                GLStateCache::setEnabled(GL_BLEND, true); //enable blending
+                GLStateCache::blendEquation(this->blending.equation); // GL_FUNC_ADD 
+                GLStateCache::blendFunc(this->blending.sourceFactor, this->blending.destinationFactor);//glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                GLStateCache::blendColor(this->blending.constantColor);//The GL_BLEND_COLOR may be used to calculate the source and destination blending factors. The color components are clamped to the range [0,1]before being stored.
             } else {
-                glDisable(GL_BLEND); //disable blending
+                GLStateCache::setEnabled(GL_BLEND, false); //disable blending
             }
             /*
             Name
@@ -280,14 +284,18 @@ namespace our {
         glDepthMask specifies whether the depth buffer is enabled for writing. If flag is GL_FALSE, depth buffer writing is disabled. Otherwise, it is enabled. Initially, depth buffer writing is enabled.
             */
 
-            glColorMask(colorMask.r, colorMask.g, colorMask.b, colorMask.a);//specify whether the individual color components in the frame buffer can or cannot be written.
-            glDepthMask(depthMask);//glDepthMask specifies whether the depth buffer is enabled for writing.
+            GLStateCache::colorMask(colorMask);//specify whether the individual color components in the frame buffer can or cannot be written.
+            GLStateCache::depthMask(depthMask);//glDepthMask specifies whether the depth buffer is enabled for writing.
 
 
         }
 
         // Given a json object, this function deserializes a PipelineState structure
         void deserialize(const nlohmann::json& data);
+
+        // Two pipeline states are equal if they would configure OpenGL in the same way
+        bool operator==(const PipelineState& other) const;
+        bool operator!=(const PipelineState& other) const { return !(*this == other); }
     };
 
 }
\ No newline at end of file
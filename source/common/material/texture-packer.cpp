@@ -0,0 +1,138 @@
+#include "texture-packer.hpp"
+#include "material.hpp"
+
+#include <glm/glm.hpp>
+#include <map>
+#include <tuple>
+#include <array>
+
+namespace our {
+
+    // The size and the internal format of the textures of a slot
+    using SlotFormat = std::tuple<GLint, GLint, GLint>;
+
+    // The color written to the layer of a slot if the material has no texture for it
+    // (white albedo and ambient occlusion, no specular, fully rough and no emission)
+    static const glm::vec4 defaultSlotColors[LIT_TEXTURE_SLOT_COUNT] = {
+        glm::vec4(1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(1.0f), glm::vec4(1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+    };
+
+    // Returns the textures of the material in the order of the slots
+    static std::array<Texture2D*, LIT_TEXTURE_SLOT_COUNT> getTextures(const LitMaterial* material){
+        return { material->albedo, material->specular, material->ambient_occlusion, material->roughness, material->emissive };
+    }
+
+    // Reads the size and the internal format of the first level of the texture (a missing texture is replaced by a single texel)
+    static SlotFormat getFormat(Texture2D* texture){
+        if(!texture) return SlotFormat(1, 1, GL_RGBA8);
+        GLint width = 0, height = 0, format = 0;
+        texture->bind();
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        return SlotFormat(width, height, format);
+    }
+
+    // Returns true if the two materials of the same set need exactly the same state apart from their texture layer
+    static bool canShareDraws(const LitMaterial* first, const LitMaterial* second){
+        return first->shader == second->shader && first->pipelineState == second->pipelineState &&
+            first->textureDefines == second->textureDefines &&
+            first->transparent == second->transparent && first->sampler == second->sampler &&
+            first->tint == second->tint && first->alphaThreshold == second->alphaThreshold;
+    }
+
+    void TexturePacker::pack(const std::vector<LitMaterial*>& materials){
+        if(materials.empty()) return;
+        GLint maxLayers = 256;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+        // Group the materials by the formats of their slots (a map is used so the sets are always created in the same order)
+        std::map<std::array<SlotFormat, LIT_TEXTURE_SLOT_COUNT>, std::vector<LitMaterial*>> groups;
+        for(LitMaterial* material : materials){
+            auto textures = getTextures(material);
+            std::array<SlotFormat, LIT_TEXTURE_SLOT_COUNT> formats;
+            for(int slot = 0; slot < LIT_TEXTURE_SLOT_COUNT; slot++) formats[slot] = getFormat(textures[slot]);
+            groups[formats].push_back(material);
+        }
+
+        // The textures are copied on the GPU by blitting them from a read framebuffer to the layers attached to a draw framebuffer
+        GLuint framebuffers[2];
+        glGenFramebuffers(2, framebuffers);
+        GLStateCache::bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+        GLStateCache::bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+
+        for(auto& [formats, groupMaterials] : groups){
+            // Materials with the same textures share a layer
+            std::map<std::array<Texture2D*, LIT_TEXTURE_SLOT_COUNT>, int> layers;
+            std::vector<std::array<Texture2D*, LIT_TEXTURE_SLOT_COUNT>> layerTextures;
+            std::vector<int> materialLayers;
+            for(LitMaterial* material : groupMaterials){
+                auto textures = getTextures(material);
+                auto it = layers.find(textures);
+                if(it == layers.end()){
+                    it = layers.emplace(textures, (int)layerTextures.size()).first;
+                    layerTextures.push_back(textures);
+                }
+                materialLayers.push_back(it->second);
+            }
+
+            // A group with more layers than an array can hold is split into several sets
+            for(int firstLayer = 0; firstLayer < (int)layerTextures.size(); firstLayer += maxLayers){
+                TextureSet* set = new TextureSet();
+                set->layerCount = glm::min((int)layerTextures.size() - firstLayer, (int)maxLayers);
+                for(int slot = 0; slot < LIT_TEXTURE_SLOT_COUNT; slot++){
+                    auto [width, height, format] = formats[slot];
+                    Texture2DArray* array = new Texture2DArray();
+                    array->bind();
+                    GLsizei levels = (GLsizei)glm::floor(glm::log2((float)glm::max(width, height))) + 1;
+                    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, format, width, height, set->layerCount);
+                    for(int layer = 0; layer < set->layerCount; layer++){
+                        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, array->getOpenGLName(), 0, layer);
+                        Texture2D* texture = layerTextures[firstLayer + layer][slot];
+                        if(texture){
+                            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->getOpenGLName(), 0);
+                            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                        } else {
+                            glClearBufferfv(GL_COLOR, 0, &defaultSlotColors[slot][0]);
+                        }
+                    }
+                    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+                    set->arrays[slot] = array;
+                }
+                sets.push_back(set);
+
+                // Then the materials of this set are given their layers and the ones that can share draws get the same batch id
+                std::vector<LitMaterial*> setMaterials;
+                for(size_t index = 0; index < groupMaterials.size(); index++){
+                    int layer = materialLayers[index] - firstLayer;
+                    if(layer < 0 || layer >= set->layerCount) continue;
+                    LitMaterial* material = groupMaterials[index];
+                    material->textureSet = set;
+                    material->textureLayer = layer;
+                    material->batchId = material->sortId;
+                    for(LitMaterial* other : setMaterials){
+                        if(canShareDraws(material, other)){
+                            material->batchId = other->batchId;
+                            break;
+                        }
+                    }
+                    setMaterials.push_back(material);
+                }
+            }
+        }
+
+        GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(2, framebuffers);
+        GLStateCache::onFramebufferDeleted(framebuffers[0]);
+        GLStateCache::onFramebufferDeleted(framebuffers[1]);
+    }
+
+    void TexturePacker::clear(){
+        for(TextureSet* set : sets){
+            for(Texture2DArray* array : set->arrays) delete array;
+            delete set;
+        }
+        sets.clear();
+    }
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../texture/texture2d-array.hpp"
+
+#include <vector>
+
+namespace our {
+
+    class LitMaterial;
+
+    // The textures read by a lit material (in the order of its texture units)
+    enum LitTextureSlot {
+        ALBEDO_SLOT = 0,
+        SPECULAR_SLOT,
+        AMBIENT_OCCLUSION_SLOT,
+        ROUGHNESS_SLOT,
+        EMISSIVE_SLOT,
+        LIT_TEXTURE_SLOT_COUNT
+    };
+
+    // The textures of a group of lit materials packed into one texture array per slot.
+    // The five textures of a material are stored in the same layer of the five arrays,
+    // so a single layer index (see Material::getTextureLayer) is enough to find all of them.
+    struct TextureSet {
+        Texture2DArray* arrays[LIT_TEXTURE_SLOT_COUNT] = {};
+        int layerCount = 0;
+    };
+
+    // The texture packer is run when the materials are loaded. It groups the lit materials whose textures have the same sizes
+    // and formats (slot by slot) and copies the textures of each group into a texture set.
+    // The materials of a set that only differ by their textures can then be drawn together: they are given the same batch id
+    // so the renderer sorts them next to each other and draws the instances of a mesh in one call
+    // (the layer of each instance is read from the instance data).
+    class TexturePacker {
+        // The texture sets owned by the packer (they are deleted by "clear")
+        static inline std::vector<TextureSet*> sets;
+    public:
+        // Packs the textures of the given materials and sets their texture set, texture layer and batch id
+        static void pack(const std::vector<LitMaterial*>& materials);
+        // Deletes all the texture sets (should be called when the materials are cleared)
+        static void clear();
+
+        static size_t getSetCount() { return sets.size(); }
+    };
+
+}
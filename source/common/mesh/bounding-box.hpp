@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cfloat>
+
+namespace our {
+
+    // An axis aligned bounding box defined by its minimum and maximum corners
+    // A default constructed box is empty (its minimum is larger than its maximum) until a point is added to it
+    struct BoundingBox {
+        glm::vec3 min = glm::vec3(FLT_MAX);
+        glm::vec3 max = glm::vec3(-FLT_MAX);
+
+        // Returns true if no point was added to the box
+        bool isEmpty() const { return min.x > max.x; }
+
+        // Grows the box to contain the given point
+        void expand(const glm::vec3& point){
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+
+        // Grows the box to contain the given box
+        void expand(const BoundingBox& other){
+            if(other.isEmpty()) return;
+            expand(other.min);
+            expand(other.max);
+        }
+
+        glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+
+        // Returns the box that contains this box after transforming it by the given matrix
+        // (the 8 corners are transformed then a new axis aligned box is fitted around them)
+        BoundingBox transformed(const glm::mat4& matrix) const {
+            BoundingBox result;
+            if(isEmpty()) return result;
+            for(int corner = 0; corner < 8; corner++){
+                glm::vec3 point(
+                    (corner & 1) ? max.x : min.x,
+                    (corner & 2) ? max.y : min.y,
+                    (corner & 4) ? max.z : min.z
+                );
+                result.expand(glm::vec3(matrix * glm::vec4(point, 1.0f)));
+            }
+            return result;
+        }
+    };
+
+}
@@ -0,0 +1,223 @@
+#include "mesh-arena.hpp"
+#include "../gl-state-cache.hpp"
+
+#include <algorithm>
+
+namespace our {
+
+    // The initial capacities of the buffers (they grow when needed)
+    static constexpr GLsizei INITIAL_VERTEX_CAPACITY = 1 << 16;
+    static constexpr GLsizei INITIAL_INDEX_CAPACITY = 1 << 18;
+
+    // Takes "count" items from the first free range that can hold them (first fit) and returns the offset or -1 if none can
+    template<typename Range>
+    static GLsizei takeRange(std::vector<Range>& ranges, GLsizei count){
+        for(auto it = ranges.begin(); it != ranges.end(); ++it){
+            if(it->count < count) continue;
+            GLsizei offset = it->offset;
+            it->offset += count;
+            it->count -= count;
+            if(it->count == 0) ranges.erase(it);
+            return offset;
+        }
+        return -1;
+    }
+
+    // Returns a range to the free list while keeping it sorted and merging it with its neighbors
+    template<typename Range>
+    static void returnRange(std::vector<Range>& ranges, GLsizei offset, GLsizei count){
+        if(count == 0) return;
+        auto it = std::lower_bound(ranges.begin(), ranges.end(), offset, [](const Range& range, GLsizei value){ return range.offset < value; });
+        it = ranges.insert(it, Range{offset, count});
+        // Merge with the next range
+        if(auto next = it + 1; next != ranges.end() && it->offset + it->count == next->offset){
+            it->count += next->count;
+            ranges.erase(next);
+        }
+        // Merge with the previous range
+        if(it != ranges.begin()){
+            auto previous = it - 1;
+            if(previous->offset + previous->count == it->offset){
+                previous->count += it->count;
+                ranges.erase(it);
+            }
+        }
+    }
+
+    // Replaces the given buffer with a new one of the given size that starts with the content of the old one
+    static GLuint resizeBuffer(GLuint buffer, GLsizeiptr oldSize, GLsizeiptr newSize){
+        GLuint newBuffer;
+        glGenBuffers(1, &newBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+        if(buffer){
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+            glDeleteBuffers(1, &buffer);
+        }
+        return newBuffer;
+    }
+
+    void MeshArena::MultiDraw::add(const Allocation& allocation){
+        counts.push_back(allocation.indexCount);
+        offsets.push_back((const void*)(allocation.firstIndex * sizeof(GLuint)));
+        baseVertices.push_back(allocation.baseVertex);
+    }
+
+    void MeshArena::MultiDraw::submit(){
+        if(counts.empty()) return;
+        MeshArena::get().bind();
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), (GLsizei)counts.size(), baseVertices.data());
+        counts.clear();
+        offsets.clear();
+        baseVertices.clear();
+    }
+
+    MeshArena& MeshArena::get(){
+        static MeshArena arena;
+        return arena;
+    }
+
+    void MeshArena::create(){
+        glGenVertexArrays(1, &VAO);
+        growVertices(INITIAL_VERTEX_CAPACITY);
+        growIndices(INITIAL_INDEX_CAPACITY);
+    }
+
+    void MeshArena::setupVertexAttributes(){
+        GLStateCache::bindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        // For each attribute, we enable it then define how to read it from the vertex buffer:
+        // its location, the number of components, their type, whether to normalize them, the stride (the size of a vertex) and its offset in the vertex
+        glEnableVertexAttribArray(ATTRIB_LOC_POSITION);
+        glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, false, sizeof(Vertex), (void*)offsetof(Vertex, position));
+        // The color is stored in bytes so we normalize it to get values between 0 and 1
+        glEnableVertexAttribArray(ATTRIB_LOC_COLOR);
+        glVertexAttribPointer(ATTRIB_LOC_COLOR, 4, GL_UNSIGNED_BYTE, true, sizeof(Vertex), (void*)offsetof(Vertex, color));
+        glEnableVertexAttribArray(ATTRIB_LOC_TEXCOORD);
+        glVertexAttribPointer(ATTRIB_LOC_TEXCOORD, 2, GL_FLOAT, false, sizeof(Vertex), (void*)offsetof(Vertex, tex_coord));
+        glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
+        glVertexAttribPointer(ATTRIB_LOC_NORMAL, 3, GL_FLOAT, false, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    }
+
+    void MeshArena::growVertices(GLsizei minimumCapacity){
+        GLsizei newCapacity = std::max(minimumCapacity, vertexCapacity * 2);
+        VBO = resizeBuffer(VBO, (GLsizeiptr)vertexCapacity * sizeof(Vertex), (GLsizeiptr)newCapacity * sizeof(Vertex));
+        // The vertex array stores the buffer from which each attribute is read, so the attributes must be redefined
+        setupVertexAttributes();
+        returnRange(freeVertices, vertexCapacity, newCapacity - vertexCapacity);
+        vertexCapacity = newCapacity;
+    }
+
+    void MeshArena::growIndices(GLsizei minimumCapacity){
+        GLsizei newCapacity = std::max(minimumCapacity, indexCapacity * 2);
+        EBO = resizeBuffer(EBO, (GLsizeiptr)indexCapacity * sizeof(GLuint), (GLsizeiptr)newCapacity * sizeof(GLuint));
+        // The element buffer binding is a part of the vertex array state
+        GLStateCache::bindVertexArray(VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        returnRange(freeIndices, indexCapacity, newCapacity - indexCapacity);
+        indexCapacity = newCapacity;
+    }
+
+    MeshArena::Allocation MeshArena::allocate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements){
+        if(!VAO) create();
+        Allocation allocation;
+        allocation.vertexCount = (GLsizei)vertices.size();
+        allocation.indexCount = (GLsizei)elements.size();
+
+        // Find a free range for the vertices (growing the buffer if none is large enough)
+        GLsizei vertexOffset = takeRange(freeVertices, allocation.vertexCount);
+        if(vertexOffset < 0){
+            // The new space is merged with the free range at the end of the buffer (if any), so this is enough to fit the vertices
+            growVertices(vertexCapacity + allocation.vertexCount);
+            vertexOffset = takeRange(freeVertices, allocation.vertexCount);
+        }
+        GLsizei indexOffset = takeRange(freeIndices, allocation.indexCount);
+        if(indexOffset < 0){
+            growIndices(indexCapacity + allocation.indexCount);
+            indexOffset = takeRange(freeIndices, allocation.indexCount);
+        }
+        allocation.baseVertex = vertexOffset;
+        allocation.firstIndex = indexOffset;
+        usedVertices += allocation.vertexCount;
+        usedIndices += allocation.indexCount;
+
+        // Then copy the data to its place in the buffers
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)vertexOffset * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data());
+        GLStateCache::bindVertexArray(VAO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)indexOffset * sizeof(GLuint), elements.size() * sizeof(GLuint), elements.data());
+        return allocation;
+    }
+
+    void MeshArena::free(const Allocation& allocation){
+        // If the arena was already destroyed, there is nothing to free
+        if(!VAO) return;
+        returnRange(freeVertices, allocation.baseVertex, allocation.vertexCount);
+        returnRange(freeIndices, allocation.firstIndex, allocation.indexCount);
+        usedVertices -= allocation.vertexCount;
+        usedIndices -= allocation.indexCount;
+    }
+
+    void MeshArena::read(const Allocation& allocation, std::vector<Vertex>& vertices, std::vector<unsigned int>& elements){
+        vertices.resize(allocation.vertexCount);
+        elements.resize(allocation.indexCount);
+        if(!VAO) return;
+        // The copy read target is used for both buffers so the vertex array state is not touched
+        glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)allocation.baseVertex * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)allocation.firstIndex * sizeof(GLuint), elements.size() * sizeof(GLuint), elements.data());
+    }
+
+    void MeshArena::clearElements(const Allocation& allocation, GLsizei first, GLsizei count){
+        if(!VAO || count <= 0) return;
+        std::vector<GLuint> zeros(count, 0);
+        GLStateCache::bindVertexArray(VAO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)(allocation.firstIndex + first) * sizeof(GLuint), count * sizeof(GLuint), zeros.data());
+    }
+
+    void MeshArena::bind(){
+        GLStateCache::bindVertexArray(VAO);
+    }
+
+    void MeshArena::bindInstances(GLuint instanceBuffer, GLintptr offset){
+        bind();
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        // The instance attributes advance once per instance (divisor = 1) instead of once per vertex
+        if(!instanceAttributesEnabled){
+            for(int column = 0; column < 4; column++){
+                glEnableVertexAttribArray(ATTRIB_LOC_INSTANCE_MODEL + column);
+                glVertexAttribDivisor(ATTRIB_LOC_INSTANCE_MODEL + column, 1);
+            }
+            glEnableVertexAttribArray(ATTRIB_LOC_INSTANCE_TINT);
+            glVertexAttribDivisor(ATTRIB_LOC_INSTANCE_TINT, 1);
+            glEnableVertexAttribArray(ATTRIB_LOC_INSTANCE_TEXTURE_LAYER);
+            glVertexAttribDivisor(ATTRIB_LOC_INSTANCE_TEXTURE_LAYER, 1);
+            instanceAttributesEnabled = true;
+        }
+        // Since GL 3.3 has no base instance, the attribute pointers are moved to the first instance of each draw
+        for(int column = 0; column < 4; column++){
+            glVertexAttribPointer(ATTRIB_LOC_INSTANCE_MODEL + column, 4, GL_FLOAT, false, sizeof(InstanceData),
+                (void*)(offset + offsetof(InstanceData, localToWorld) + column * sizeof(glm::vec4)));
+        }
+        glVertexAttribPointer(ATTRIB_LOC_INSTANCE_TINT, 4, GL_FLOAT, false, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, tint)));
+        // The layer is an integer so it is read using the integer variant (it would be converted to a float otherwise)
+        glVertexAttribIPointer(ATTRIB_LOC_INSTANCE_TEXTURE_LAYER, 1, GL_INT, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, textureLayer)));
+    }
+
+    void MeshArena::destroy(){
+        if(!VAO) return;
+        glDeleteVertexArrays(1, &VAO);
+        GLStateCache::onVertexArrayDeleted(VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+        vertexCapacity = indexCapacity = 0;
+        usedVertices = usedIndices = 0;
+        freeVertices.clear();
+        freeIndices.clear();
+        instanceAttributesEnabled = false;
+    }
+
+}
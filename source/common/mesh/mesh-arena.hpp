@@ -0,0 +1,102 @@
+#pragma once
+
+#include <glad/gl.h>
+#include "vertex.hpp"
+#include <vector>
+
+namespace our {
+
+    #define ATTRIB_LOC_POSITION 0
+    #define ATTRIB_LOC_COLOR    1
+    #define ATTRIB_LOC_TEXCOORD 2
+    #define ATTRIB_LOC_NORMAL   3
+    // The per-instance attributes (a mat4 attribute takes 4 locations so the model matrix uses the locations 4 to 7)
+    #define ATTRIB_LOC_INSTANCE_MODEL 4
+    #define ATTRIB_LOC_INSTANCE_TINT  8
+    #define ATTRIB_LOC_INSTANCE_TEXTURE_LAYER 9
+
+    // The mesh arena stores the geometry of all the meshes in one shared vertex buffer and one shared element buffer
+    // which are read through a single vertex array object.
+    // Each mesh is an allocation (a range of vertices and a range of elements) in these buffers,
+    // so switching from a mesh to another doesn't require binding another vertex array
+    // and the meshes drawn with the same state can be submitted together using glMultiDrawElementsBaseVertex.
+    // The element indices of a mesh are relative to its first vertex (they are offset using the base vertex while drawing).
+    class MeshArena {
+    public:
+        // The place of a mesh in the arena
+        struct Allocation {
+            GLint baseVertex = 0;       // The index of the first vertex of the mesh in the vertex buffer
+            GLsizei vertexCount = 0;
+            GLsizei firstIndex = 0;     // The index of the first element of the mesh in the element buffer
+            GLsizei indexCount = 0;
+        };
+
+        // A list of meshes that will be drawn using a single glMultiDrawElementsBaseVertex call
+        // (it keeps its arrays between submissions to avoid reallocating them)
+        class MultiDraw {
+            std::vector<GLsizei> counts;
+            std::vector<const void*> offsets;
+            std::vector<GLint> baseVertices;
+        public:
+            void add(const Allocation& allocation);
+            // Draws all the added meshes then clears the list
+            void submit();
+            size_t size() const { return counts.size(); }
+        };
+
+        // Returns the arena shared by all the meshes
+        static MeshArena& get();
+
+        // Copies the given vertices & elements into the arena and returns where they were stored
+        // The buffers grow (and their content is copied to the new buffers) if there is no free range large enough
+        Allocation allocate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements);
+        // Returns the ranges of the allocation to the free lists so they can be reused by other meshes
+        void free(const Allocation& allocation);
+
+        // Reads the vertices & elements of the allocation back from the buffers (the elements are relative to its first vertex)
+        // This waits for the GPU so it should only be used while loading
+        void read(const Allocation& allocation, std::vector<Vertex>& vertices, std::vector<unsigned int>& elements);
+
+        // Overwrites the elements [first, first + count) of the allocation with zeros, so the triangles they formed become degenerate
+        // and nothing is drawn for them (the rest of the allocation is not touched)
+        void clearElements(const Allocation& allocation, GLsizei first, GLsizei count);
+
+        // Binds the vertex array of the arena
+        void bind();
+        // Points the instance attributes to the given instance buffer starting from the given offset (an array of InstanceData)
+        void bindInstances(GLuint instanceBuffer, GLintptr offset);
+
+        // Deletes the buffers and the vertex array (should be called before the OpenGL context is destroyed)
+        void destroy();
+
+        // The number of vertices & elements that the buffers can hold and the number that is currently used
+        GLsizei getVertexCapacity() const { return vertexCapacity; }
+        GLsizei getIndexCapacity() const { return indexCapacity; }
+        GLsizei getUsedVertices() const { return usedVertices; }
+        GLsizei getUsedIndices() const { return usedIndices; }
+
+    private:
+        // A free range of vertices or elements
+        struct Range {
+            GLsizei offset, count;
+        };
+
+        GLuint VAO = 0, VBO = 0, EBO = 0;
+        GLsizei vertexCapacity = 0, indexCapacity = 0;
+        GLsizei usedVertices = 0, usedIndices = 0;
+        // The free ranges of each buffer sorted by their offsets (adjacent ranges are always merged)
+        std::vector<Range> freeVertices, freeIndices;
+        // Whether the instance attributes were already enabled on the vertex array
+        bool instanceAttributesEnabled = false;
+
+        MeshArena() = default;
+        // Creates the vertex array and the buffers with the initial capacities
+        void create();
+        // Replaces the buffer with a larger one (copying its content) then adds the new space to the free list
+        void growVertices(GLsizei minimumCapacity);
+        void growIndices(GLsizei minimumCapacity);
+        // Defines how the vertices are read from the vertex buffer (must be called whenever the vertex buffer changes)
+        void setupVertexAttributes();
+    };
+
+}
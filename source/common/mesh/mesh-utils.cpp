@@ -7,8 +7,11 @@
 #include <iostream>
 #include <vector>
 #include <unordered_map>
+#include <queue>
+#include <algorithm>
+#include <limits>
 
-our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
+our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename, int lodCount, float lodRatio) {
 
     // The data that we will use to initialize our mesh
     std::vector<our::Vertex> vertices;
@@ -81,7 +84,227 @@ our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
         }
     }
 
-    return new our::Mesh(vertices, elements);
+    our::Mesh* mesh = new our::Mesh(vertices, elements);
+
+    // Each level is simplified from the previous one (which is faster and keeps the levels consistent)
+    for(int level = 1; level <= lodCount; level++){
+        std::vector<our::Vertex> lodVertices;
+        std::vector<GLuint> lodElements;
+        size_t target = (size_t)(elements.size() / 3 * lodRatio);
+        simplify(vertices, elements, target, lodVertices, lodElements);
+        // Stop if the mesh can't be simplified much more
+        if(lodElements.empty() || lodElements.size() > elements.size() * 0.9f) break;
+        mesh->addLod(new our::Mesh(lodVertices, lodElements));
+        vertices.swap(lodVertices);
+        elements.swap(lodElements);
+    }
+    return mesh;
+}
+
+namespace {
+    // A symmetric 4x4 matrix storing the sum of the squared distances to a set of planes (only the 10 unique values are stored)
+    // For a plane (a, b, c, d), the quadric is the outer product of the plane with itself
+    struct Quadric {
+        double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+        static Quadric fromPlane(const glm::dvec4& plane, double weight){
+            Quadric q;
+            q.a2 = weight * plane.x * plane.x; q.ab = weight * plane.x * plane.y; q.ac = weight * plane.x * plane.z; q.ad = weight * plane.x * plane.w;
+            q.b2 = weight * plane.y * plane.y; q.bc = weight * plane.y * plane.z; q.bd = weight * plane.y * plane.w;
+            q.c2 = weight * plane.z * plane.z; q.cd = weight * plane.z * plane.w;
+            q.d2 = weight * plane.w * plane.w;
+            return q;
+        }
+
+        Quadric& operator+=(const Quadric& o){
+            a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad; b2 += o.b2; bc += o.bc; bd += o.bd; c2 += o.c2; cd += o.cd; d2 += o.d2;
+            return *this;
+        }
+        Quadric operator+(const Quadric& o) const { Quadric q = *this; q += o; return q; }
+
+        // Returns the sum of the squared distances from the point to the planes (v^T Q v where v = (x, y, z, 1))
+        double evaluate(const glm::vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            return a2*x*x + 2*ab*x*y + 2*ac*x*z + 2*ad*x + b2*y*y + 2*bc*y*z + 2*bd*y + c2*z*z + 2*cd*z + d2;
+        }
+    };
+
+    // A candidate collapse that moves the position "from" onto the position "to"
+    // The versions are used to skip the candidates computed before one of the positions changed
+    struct Collapse {
+        double cost;
+        GLuint from, to;
+        GLuint fromVersion, toVersion;
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+}
+
+void our::mesh_utils::simplify(const std::vector<our::Vertex>& vertices, const std::vector<GLuint>& elements, size_t targetTriangles,
+    std::vector<our::Vertex>& simplifiedVertices, std::vector<GLuint>& simplifiedElements) {
+
+    // The vertices that share a position but differ in their other attributes (at texture or normal seams) are grouped,
+    // so the simplification works on the positions and the seams are collapsed together instead of being torn apart
+    std::unordered_map<glm::vec3, GLuint> positionIndices;
+    std::vector<GLuint> positionOf(vertices.size());
+    std::vector<glm::vec3> positions;
+    std::vector<std::vector<GLuint>> positionVertices;
+    for(GLuint v = 0; v < vertices.size(); v++){
+        auto [it, inserted] = positionIndices.emplace(vertices[v].position, (GLuint)positions.size());
+        if(inserted){
+            positions.push_back(vertices[v].position);
+            positionVertices.emplace_back();
+        }
+        positionOf[v] = it->second;
+        positionVertices[it->second].push_back(v);
+    }
+    size_t positionCount = positions.size();
+
+    // The corners of the triangles (vertex indices) are modified in place while collapsing
+    std::vector<GLuint> corners = elements;
+    size_t triangleCount = corners.size() / 3;
+    std::vector<bool> triangleRemoved(triangleCount, false);
+    std::vector<std::vector<GLuint>> positionTriangles(positionCount);
+    std::vector<Quadric> quadrics(positionCount);
+    size_t liveTriangles = 0;
+    // Each position accumulates the planes of its triangles (weighted by their areas)
+    for(GLuint t = 0; t < triangleCount; t++){
+        GLuint p0 = positionOf[corners[3*t]], p1 = positionOf[corners[3*t+1]], p2 = positionOf[corners[3*t+2]];
+        if(p0 == p1 || p1 == p2 || p2 == p0){
+            triangleRemoved[t] = true;
+            continue;
+        }
+        glm::dvec3 normal = glm::cross(glm::dvec3(positions[p1] - positions[p0]), glm::dvec3(positions[p2] - positions[p0]));
+        double length = glm::length(normal);
+        if(length > 0){
+            normal /= length;
+            Quadric q = Quadric::fromPlane(glm::dvec4(normal, -glm::dot(normal, glm::dvec3(positions[p0]))), length * 0.5);
+            quadrics[p0] += q; quadrics[p1] += q; quadrics[p2] += q;
+        }
+        positionTriangles[p0].push_back(t);
+        positionTriangles[p1].push_back(t);
+        positionTriangles[p2].push_back(t);
+        liveTriangles++;
+    }
+
+    // The positions on the border of the mesh (on an edge used by a single triangle) are locked so the outline of the mesh is kept
+    auto edgeKey = [](GLuint a, GLuint b){ return a < b ? ((std::uint64_t)a << 32) | b : ((std::uint64_t)b << 32) | a; };
+    std::unordered_map<std::uint64_t, int> edgeUses;
+    for(GLuint t = 0; t < triangleCount; t++){
+        if(triangleRemoved[t]) continue;
+        for(int k = 0; k < 3; k++)
+            edgeUses[edgeKey(positionOf[corners[3*t+k]], positionOf[corners[3*t+(k+1)%3]])]++;
+    }
+    std::vector<bool> locked(positionCount, false);
+    for(auto& [key, uses] : edgeUses){
+        if(uses != 1) continue;
+        locked[key >> 32] = true;
+        locked[key & 0xFFFFFFFFu] = true;
+    }
+
+    // The candidate collapses sorted by their cost (the smallest error first)
+    std::vector<GLuint> versions(positionCount, 0);
+    std::vector<bool> positionRemoved(positionCount, false);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> candidates;
+    const double infinity = std::numeric_limits<double>::infinity();
+    auto pushEdge = [&](GLuint a, GLuint b){
+        // The position that stays is picked to minimize the error of the combined quadric
+        Quadric q = quadrics[a] + quadrics[b];
+        double costAB = locked[a] ? infinity : q.evaluate(positions[b]);
+        double costBA = locked[b] ? infinity : q.evaluate(positions[a]);
+        if(costAB == infinity && costBA == infinity) return;
+        if(costAB <= costBA) candidates.push({costAB, a, b, versions[a], versions[b]});
+        else candidates.push({costBA, b, a, versions[b], versions[a]});
+    };
+    for(auto& [key, uses] : edgeUses) pushEdge((GLuint)(key >> 32), (GLuint)(key & 0xFFFFFFFFu));
+
+    // When a vertex moves to another position, it takes the vertex of that position with the closest attributes
+    auto closestVertex = [&](GLuint vertex, GLuint position){
+        GLuint best = positionVertices[position][0];
+        float bestDistance = std::numeric_limits<float>::max();
+        for(GLuint candidate : positionVertices[position]){
+            float distance = glm::length(vertices[candidate].tex_coord - vertices[vertex].tex_coord) +
+                             glm::length(vertices[candidate].normal - vertices[vertex].normal);
+            if(distance < bestDistance){
+                bestDistance = distance;
+                best = candidate;
+            }
+        }
+        return best;
+    };
+
+    while(liveTriangles > targetTriangles && !candidates.empty()){
+        Collapse collapse = candidates.top();
+        candidates.pop();
+        GLuint from = collapse.from, to = collapse.to;
+        if(positionRemoved[from] || positionRemoved[to]) continue;
+        if(versions[from] != collapse.fromVersion || versions[to] != collapse.toVersion) continue;
+
+        // Reject the collapse if it flips any of the remaining triangles around "from"
+        bool flips = false;
+        for(GLuint t : positionTriangles[from]){
+            if(triangleRemoved[t]) continue;
+            glm::vec3 before[3], after[3];
+            bool sharesEdge = false;
+            for(int k = 0; k < 3; k++){
+                GLuint p = positionOf[corners[3*t+k]];
+                if(p == to) sharesEdge = true;
+                before[k] = positions[p];
+                after[k] = p == from ? positions[to] : positions[p];
+            }
+            if(sharesEdge) continue; // This triangle disappears
+            glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if(glm::dot(oldNormal, newNormal) <= 0.0f){
+                flips = true;
+                break;
+            }
+        }
+        if(flips) continue;
+
+        // Move every triangle of "from" to "to" (the triangles using both collapse into lines and are removed)
+        for(GLuint t : positionTriangles[from]){
+            if(triangleRemoved[t]) continue;
+            bool degenerate = false;
+            for(int k = 0; k < 3; k++) if(positionOf[corners[3*t+k]] == to) degenerate = true;
+            if(degenerate){
+                triangleRemoved[t] = true;
+                liveTriangles--;
+                continue;
+            }
+            for(int k = 0; k < 3; k++)
+                if(positionOf[corners[3*t+k]] == from) corners[3*t+k] = closestVertex(corners[3*t+k], to);
+            positionTriangles[to].push_back(t);
+        }
+        positionTriangles[from].clear();
+        positionRemoved[from] = true;
+        quadrics[to] += quadrics[from];
+        versions[to]++;
+
+        // Drop the removed triangles of "to" then update the candidates of its edges
+        auto& triangles = positionTriangles[to];
+        triangles.erase(std::remove_if(triangles.begin(), triangles.end(), [&](GLuint t){ return triangleRemoved[t]; }), triangles.end());
+        for(GLuint t : triangles)
+            for(int k = 0; k < 3; k++){
+                GLuint p = positionOf[corners[3*t+k]];
+                if(p != to) pushEdge(to, p);
+            }
+    }
+
+    // Copy the remaining triangles and the vertices that they use
+    simplifiedVertices.clear();
+    simplifiedElements.clear();
+    std::vector<GLuint> remap(vertices.size(), std::numeric_limits<GLuint>::max());
+    for(GLuint t = 0; t < triangleCount; t++){
+        if(triangleRemoved[t]) continue;
+        for(int k = 0; k < 3; k++){
+            GLuint vertex = corners[3*t+k];
+            if(remap[vertex] == std::numeric_limits<GLuint>::max()){
+                remap[vertex] = (GLuint)simplifiedVertices.size();
+                simplifiedVertices.push_back(vertices[vertex]);
+            }
+            simplifiedElements.push_back(remap[vertex]);
+        }
+    }
 }
 
 // Create a sphere (the vertex order in the triangles are CCW from the outside)
@@ -2,10 +2,18 @@
 
 #include "mesh.hpp"
 #include <string>
+#include <vector>
 
 namespace our::mesh_utils {
     // Load an ".obj" file into the mesh
-    Mesh* loadOBJ(const std::string& filename);
+    // If "lodCount" is more than 0, up to "lodCount" simplified levels are generated and added to the mesh,
+    // each of them having about "lodRatio" of the triangles of the previous level
+    Mesh* loadOBJ(const std::string& filename, int lodCount = 0, float lodRatio = 0.5f);
+    // Simplifies a mesh using quadric error metrics (Garland & Heckbert) until it has at most "targetTriangles" triangles
+    // (or until no edge can be collapsed without moving the border or flipping a triangle).
+    // The result only contains the vertices that are still used.
+    void simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements, size_t targetTriangles,
+        std::vector<Vertex>& simplifiedVertices, std::vector<unsigned int>& simplifiedElements);
     // Create a sphere (the vertex order in the triangles are CCW from the outside)
     // Segments define the number of divisions on the both the latitude and the longitude
     Mesh* sphere(const glm::ivec2& segments);
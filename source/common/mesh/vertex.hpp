@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtx/hash.hpp>
+#include <cstdint>
 
 namespace our {
 
@@ -24,6 +25,14 @@ namespace our {
         }
     };
 
+    // The data of a single instance when a mesh is drawn using instancing
+    // The instances of a draw are read from an instance buffer (one InstanceData per instance)
+    struct InstanceData {
+        glm::mat4 localToWorld; // The model matrix of the instance
+        glm::vec4 tint;         // A color multiplied by the vertex color of the instance
+        std::int32_t textureLayer; // The layer of the textures of the material in its texture arrays (see TexturePacker)
+    };
+
 }
 
 // We plan to use struct Vertex as a key for a map so we need to define a hash function for it
@@ -0,0 +1,113 @@
+#include "render-thread.hpp"
+
+namespace our {
+
+    RenderThread& RenderThread::get(){
+        static RenderThread renderThread;
+        return renderThread;
+    }
+
+    void RenderThread::start(GLFWwindow* window){
+        if(running) return;
+        this->window = window;
+        // A context can only be current on one thread at a time
+        glfwMakeContextCurrent(nullptr);
+        running = true;
+        borrowed = false;
+        stopping = false;
+        thread = std::thread(&RenderThread::threadLoop, this);
+    }
+
+    void RenderThread::stop(){
+        if(!running) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        thread.join();
+        running = false;
+        borrowed = false;
+        pending.clear();
+        glfwMakeContextCurrent(window);
+    }
+
+    void RenderThread::threadLoop(){
+        bool contextCurrent = false;
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true){
+            condition.wait(lock, [&]{ return frameSubmitted || releaseRequested || stopping; });
+            if(releaseRequested){
+                if(contextCurrent) glfwMakeContextCurrent(nullptr);
+                contextCurrent = false;
+                releaseRequested = false;
+                condition.notify_all();
+            } else if(frameSubmitted){
+                executing.swap(submitted);
+                frameSubmitted = false;
+                busy = true;
+                lock.unlock();
+                if(!contextCurrent) glfwMakeContextCurrent(window);
+                contextCurrent = true;
+                for(auto& task : executing) task();
+                executing.clear();
+                lock.lock();
+                busy = false;
+                condition.notify_all();
+            } else {
+                // Stopping (the submitted frame was finished first)
+                if(contextCurrent) glfwMakeContextCurrent(nullptr);
+                return;
+            }
+        }
+    }
+
+    void RenderThread::waitIdle(std::unique_lock<std::mutex>& lock){
+        condition.wait(lock, [&]{ return !frameSubmitted && !busy; });
+    }
+
+    void RenderThread::enqueue(std::function<void()> task){
+        if(!isDeferring()) task();
+        else pending.push_back(std::move(task));
+    }
+
+    void RenderThread::submitFrame(){
+        if(!isDeferring()) return;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            waitIdle(lock);
+            submitted.swap(pending);
+            pending.clear();
+            frameSubmitted = true;
+        }
+        condition.notify_all();
+    }
+
+    void RenderThread::wait(){
+        if(!running) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        waitIdle(lock);
+    }
+
+    void RenderThread::borrowContext(){
+        if(!running || borrowed) return;
+        // The tasks recorded so far must run before the main thread uses the context
+        submitFrame();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            waitIdle(lock);
+            releaseRequested = true;
+            condition.notify_all();
+            condition.wait(lock, [&]{ return !releaseRequested; });
+        }
+        glfwMakeContextCurrent(window);
+        borrowed = true;
+    }
+
+    void RenderThread::returnContext(){
+        if(!running || !borrowed) return;
+        glfwMakeContextCurrent(nullptr);
+        borrowed = false;
+    }
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace our {
+
+    // The render thread owns the OpenGL context while the game runs, so the main thread can simulate the next frame
+    // while the current frame is being submitted to the GPU (enable it using "renderThread": true in the app config).
+    // The main thread records the OpenGL work of a frame as tasks (using "enqueue") which must only read data that the main thread
+    // won't change until the frame is done (e.g. a snapshot of the scene), then hands them over using "submitFrame".
+    // At most one frame is in flight: submitting a frame waits for the previous one to finish.
+    // If the thread isn't running (or the main thread borrowed the context), the tasks run immediately on the calling thread,
+    // so the code that records them works the same way with or without the render thread.
+    class RenderThread {
+        std::thread thread;
+        GLFWwindow* window = nullptr;
+        bool running = false;
+        // True if the main thread currently holds the context (see "borrowContext")
+        bool borrowed = false;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        // The tasks recorded for the next frame, the tasks of the submitted frame and the tasks being executed
+        std::vector<std::function<void()>> pending, submitted, executing;
+        bool frameSubmitted = false, busy = false, releaseRequested = false, stopping = false;
+
+        RenderThread() = default;
+        void threadLoop();
+        // Waits until the submitted frame is done (the lock must be held)
+        void waitIdle(std::unique_lock<std::mutex>& lock);
+
+    public:
+        RenderThread(const RenderThread&) = delete;
+        RenderThread& operator=(const RenderThread&) = delete;
+
+        // Returns the render thread of the application
+        static RenderThread& get();
+
+        // Moves the context of the window (which must be current on the calling thread) to a new render thread
+        void start(GLFWwindow* window);
+        // Finishes the submitted frame, stops the thread and makes the context current on the calling thread again
+        void stop();
+        bool isRunning() const { return running; }
+        // Returns true if the tasks are deferred to the render thread (false if they run immediately)
+        bool isDeferring() const { return running && !borrowed; }
+
+        // Records a task for the next frame (or runs it immediately if the tasks are not deferred)
+        void enqueue(std::function<void()> task);
+        // Waits for the previous frame to finish then starts executing the tasks recorded since the last submission
+        void submitFrame();
+        // Waits until the submitted frame is done
+        void wait();
+
+        // Makes the context current on the calling thread until "returnContext" is called
+        // (needed by the code that calls OpenGL directly, e.g. loading assets or the states that don't record their draws)
+        void borrowContext();
+        // Gives the context back to the render thread (it takes it when the next frame is submitted)
+        void returnContext();
+    };
+
+}
@@ -0,0 +1,133 @@
+#include "program-cache.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <cstdio>
+
+namespace our {
+
+    // Written at the start of every cache file to recognize them (and to reject the files written by an older layout)
+    static constexpr char FILE_MAGIC[8] = {'O', 'U', 'R', 'P', 'R', 'O', 'G', '1'};
+
+    // The 64-bit FNV-1a hash (it is only used to name the cache files, so it doesn't need to be strong)
+    static std::uint64_t hashBytes(std::uint64_t hash, const void* data, size_t size){
+        const unsigned char* bytes = (const unsigned char*)data;
+        for(size_t i = 0; i < size; i++){
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+    static std::uint64_t hashString(std::uint64_t hash, const std::string& string){
+        // The size is hashed too so the boundaries between the strings are part of the key
+        size_t size = string.size();
+        hash = hashBytes(hash, &size, sizeof(size));
+        return hashBytes(hash, string.data(), size);
+    }
+
+    void ProgramCache::initialize(const std::string& directory){
+        ProgramCache::directory = directory;
+        GLint formatCount = 0;
+        if(GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        // Some drivers support the functions but no binary format, in which case there is nothing to cache
+        enabled = formatCount > 0;
+        if(!enabled){
+            std::cout << "The program cache is disabled since the driver has no program binary format" << std::endl;
+            return;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        driverHash = 14695981039346656037ull;
+        for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION}){
+            const GLubyte* string = glGetString(name);
+            driverHash = hashString(driverHash, string ? std::string((const char*)string) : std::string());
+        }
+    }
+
+    std::uint64_t ProgramCache::computeKey(const std::vector<std::pair<GLenum, std::string>>& sources){
+        std::uint64_t key = driverHash;
+        for(auto& [type, source] : sources){
+            key = hashBytes(key, &type, sizeof(type));
+            key = hashString(key, source);
+        }
+        return key;
+    }
+
+    std::string ProgramCache::getPath(std::uint64_t key){
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return (std::filesystem::path(directory) / name).string();
+    }
+
+    void ProgramCache::prepare(GLuint program){
+        if(enabled) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    bool ProgramCache::load(GLuint program, std::uint64_t key){
+        if(!enabled) return false;
+        std::string path = getPath(key);
+        std::ifstream file(path, std::ios::binary);
+        if(!file) return false;
+
+        // The file contains: the magic, the key, the binary format then the binary itself
+        char magic[sizeof(FILE_MAGIC)];
+        std::uint64_t storedKey = 0;
+        GLenum format = 0;
+        std::vector<char> binary;
+        bool valid = (bool)file.read(magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), FILE_MAGIC) &&
+            file.read((char*)&storedKey, sizeof(storedKey)) && storedKey == key &&
+            file.read((char*)&format, sizeof(format));
+        if(valid){
+            binary.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            valid = !binary.empty();
+        }
+        file.close();
+        if(valid){
+            glProgramBinary(program, format, binary.data(), (GLsizei)binary.size());
+            GLint status = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &status);
+            valid = status == GL_TRUE;
+        }
+        if(!valid){
+            // The file is broken or the driver doesn't accept it anymore, so it is replaced once the program is compiled
+            std::error_code error;
+            std::filesystem::remove(path, error);
+            return false;
+        }
+        loadedCount++;
+        return true;
+    }
+
+    void ProgramCache::store(GLuint program, std::uint64_t key){
+        compiledCount++;
+        if(!enabled) return;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0) return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+
+        // The binary is written to a temporary file first so a crash never leaves a partial file under the real name
+        std::string path = getPath(key);
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if(!file) return;
+            file.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+            file.write((const char*)&key, sizeof(key));
+            file.write((const char*)&format, sizeof(format));
+            file.write(binary.data(), length);
+            if(!file) return;
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, path, error);
+        if(error) std::filesystem::remove(temporaryPath, error);
+    }
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+namespace our {
+
+    // The program cache stores the binaries of the linked shader programs on the disk (glGetProgramBinary)
+    // so the next runs (and the next scene changes) load them (glProgramBinary) instead of compiling the GLSL again.
+    // A binary is found using a key hashed from the sources of the program and the vendor, renderer & version strings of the driver,
+    // so editing a shader or updating the driver gives a new key and the old binary is simply never read again.
+    // If the driver rejects a binary (which it is allowed to do at any time), the file is deleted and the program is compiled.
+    class ProgramCache {
+        static inline bool enabled = false;
+        static inline std::string directory;
+        // The hash of the driver strings (mixed into every key)
+        static inline std::uint64_t driverHash = 0;
+        // The number of programs that were loaded from the cache or compiled from their sources since the start
+        static inline std::size_t loadedCount = 0;
+        static inline std::size_t compiledCount = 0;
+
+        static std::string getPath(std::uint64_t key);
+    public:
+        // Should be called once the OpenGL functions are loaded. The cache stays disabled if the driver can't retrieve program binaries
+        static void initialize(const std::string& directory);
+        static bool isEnabled() { return enabled; }
+
+        // Returns the key of a program made of the given shader sources (type & GLSL code)
+        static std::uint64_t computeKey(const std::vector<std::pair<GLenum, std::string>>& sources);
+        // Should be called before linking a program so the driver keeps its binary retrievable
+        static void prepare(GLuint program);
+        // Loads the binary of the given key into the program. Returns false if there is none or if the driver rejected it.
+        static bool load(GLuint program, std::uint64_t key);
+        // Stores the binary of a program that was just compiled and linked
+        static void store(GLuint program, std::uint64_t key);
+
+        static std::size_t getLoadedCount() { return loadedCount; }
+        static std::size_t getCompiledCount() { return compiledCount; }
+    };
+
+}
@@ -1,25 +1,117 @@
 #include "shader.hpp"
+#include "program-cache.hpp"
 
 #include <cassert>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <thread>
 
 //Forward definition for error checking functions
 std::string checkForShaderCompilationErrors(GLuint shader);
 std::string checkForLinkingErrors(GLuint program);
 
-bool our::ShaderProgram::attach(const std::string &filename, GLenum type) const {
-    // Here, we open the file and read a string from it containing the GLSL code of our shader
+// Inserts a "#define" line for each of the given defines right after the "#version" line of the source
+// (the version must stay the first statement of a GLSL shader)
+static std::string insertDefines(const std::string& source, const std::vector<std::string>& defines){
+    if(defines.empty()) return source;
+    std::string lines;
+    for(auto& define : defines) lines += "#define " + define + "\n";
+    size_t position = 0;
+    if(size_t version = source.find("#version"); version != std::string::npos){
+        position = source.find('\n', version);
+        position = position == std::string::npos ? source.size() : position + 1;
+    }
+    std::string result = source;
+    // A shader ending right after its version line needs a line break before the defines
+    if(position > 0 && result[position - 1] != '\n') lines = "\n" + lines;
+    result.insert(position, lines);
+    return result;
+}
+
+// Reads a shader file and replaces each line of the form '#include "path"' by the content of the included file
+// (GLSL has no include directive, the path is relative to the directory of the file containing the line)
+static bool readShaderFile(const std::string& filename, std::string& source, int depth = 0){
     std::ifstream file(filename);
     if(!file){
         std::cerr << "ERROR: Couldn't open shader file: " << filename << std::endl;
         return false;
     }
-    std::string sourceString = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if(depth > 16){
+        std::cerr << "ERROR: Too many nested includes in shader file: " << filename << std::endl;
+        return false;
+    }
+    std::string directory = filename.substr(0, filename.find_last_of("/\\") + 1);
+    std::string line;
+    while(std::getline(file, line)){
+        size_t start = line.find_first_not_of(" \t");
+        if(start != std::string::npos && line.compare(start, 8, "#include") == 0){
+            size_t open = line.find('"', start), close = line.rfind('"');
+            if(open != std::string::npos && close > open){
+                std::string included;
+                if(!readShaderFile(directory + line.substr(open + 1, close - open - 1), included, depth + 1)) return false;
+                source += included;
+                if(!included.empty() && included.back() != '\n') source += '\n';
+                continue;
+            }
+        }
+        source += line;
+        source += '\n';
+    }
+    return true;
+}
+
+bool our::ShaderProgram::attach(const std::string &filename, GLenum type, const std::vector<std::string> &defines) {
+    // Here, we open the file and read a string from it containing the GLSL code of our shader (with its includes)
+    std::string sourceString;
+    if(!readShaderFile(filename, sourceString)) return false;
+    return attachSource(sourceString, type, filename, defines);
+}
+
+bool our::ShaderProgram::attachSource(const std::string &source, GLenum type, const std::string &name, const std::vector<std::string> &defines) {
+    // The shader is only compiled by "link" if the binary of the program isn't found in the program cache
+    sources.emplace_back(type, insertDefines(source, defines));
+    sourceFiles.push_back(name);
+    return true;
+}
+
+our::ShaderProgram* our::ShaderProgram::createPermutation(const std::vector<std::string> &defines) const {
+    ShaderProgram* permutation = new ShaderProgram();
+    for(auto& [type, source] : sources) permutation->sources.emplace_back(type, insertDefines(source, defines));
+    permutation->sourceFiles = sourceFiles;
+    // The instanced variant gets the same defines so the renderer can switch to it as it does with the original program.
+    // The depth variant is not copied: its empty fragment shader doesn't use the features, so the one of the original program is used
+    if(instancedVariant) permutation->setInstancedVariant(instancedVariant->createPermutation(defines));
+    permutation->beginLink();
+    return permutation;
+}
+
+our::ShaderProgram* our::ShaderProgram::getPermutation(const std::vector<std::string> &extraDefines) {
+    if(extraDefines.empty()) return this;
+    // The defines are sorted and duplicates removed so the same features always give the same permutation
+    std::vector<std::string> combined = defines;
+    combined.insert(combined.end(), extraDefines.begin(), extraDefines.end());
+    std::sort(combined.begin(), combined.end());
+    combined.erase(std::unique(combined.begin(), combined.end()), combined.end());
+    if(combined == defines) return this;
+
+    std::string key;
+    for(auto& define : combined) key += define + ";";
+    auto& cache = root->permutations;
+    if(auto it = cache.find(key); it != cache.end()) return it->second;
+    ShaderProgram* permutation = root->createPermutation(combined);
+    permutation->root = root;
+    permutation->defines = std::move(combined);
+    cache[key] = permutation;
+    return permutation;
+}
+
+void our::ShaderProgram::compile(const std::string &sourceString, GLenum type) {
     const char* sourceCStr = sourceString.c_str();
-    file.close();
- 
 
    /* 
      glCreateShader — Creates a shader object
@@ -80,15 +172,11 @@ Description
     glShaderSource(shaderID, 1, &sourceCStr, nullptr);
     glCompileShader(shaderID);
 
-     if(std::string error = checkForShaderCompilationErrors(shaderID); error.size() != 0){
-        std::cerr << "ERROR IN " << filename << std::endl;
-        std::cerr << error << std::endl;
-        glDeleteShader(shaderID); // there is an error in shader so delete it and return false 
-        return false;
-    }
- 
+    // The compile status is not queried here since the query would wait for the compilation to finish.
+    // It is checked by "finishLink" (a shader that failed to compile also makes the link fail)
+
     // attach the shader to the program then delete the shader
-    // no error so attach shader to profram and then delete shader and return true
+    // (it is only deleted once the program is deleted, so its status and log can still be read until then)
 
     /*
    Name
@@ -107,11 +195,7 @@ Description
     */
     glAttachShader(program, shaderID);
     glDeleteShader(shaderID);
-  
-
-  //We return true if the compilation succeeded
-    return true;
-    
+    compiledShaders.push_back(shaderID);
 
     //TODO: Complete this function
     //Note: The function "checkForShaderCompilationErrors" checks if there is
@@ -121,30 +205,142 @@ Description
 
 }
 
+bool our::ShaderProgram::enableParallelCompilation() {
+    // Let the driver use as many compiler threads as it wants (0xFFFFFFFF means no limit)
+    if(GLAD_GL_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    else if(GLAD_GL_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    parallelCompilation = GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+    return parallelCompilation;
+}
 
+bool our::ShaderProgram::link() {
+    // Linking right away is the same as starting the link then waiting for it
+    return beginLink() && finishLink();
+}
 
-bool our::ShaderProgram::link() const {
-    /*
-    Name
-     glLinkProgram — Links a program object
-
-    C Specification
-      void glLinkProgram(	GLuint program);
+bool our::ShaderProgram::beginLink() {
+    if(linkPending) return true;
+    // The binary of the program is looked up in the program cache first (see ProgramCache)
+    // and the shaders are only compiled and linked if it wasn't found or if the driver rejected it
+    cacheKey = ProgramCache::computeKey(sources);
+    loadedFromCache = ProgramCache::load(program, cacheKey);
+    if(!loadedFromCache){
+        compiledShaders.clear();
+        for(auto& [type, source] : sources) compile(source, type);
+        ProgramCache::prepare(program);
+        /*
+        Name
+         glLinkProgram — Links a program object
+
+        C Specification
+          void glLinkProgram(	GLuint program);
  
-    Parameters
-      1-program : Specifies the handle of the program object to be linked.
+        Parameters
+          1-program : Specifies the handle of the program object to be linked.
     
     
-    */
-    glLinkProgram(program);
+        */
+        glLinkProgram(program);
+    }
+    linkPending = true;
+    pendingLinks.push_back(this);
+    return true;
+}
 
-    
-    // checkk for linking error if there is an error return false 
-    if(auto error = checkForLinkingErrors(program); error.size() != 0){
-        std::cerr << "LINKING ERROR" << std::endl;
-        std::cerr << error << std::endl;
-        return false;
+bool our::ShaderProgram::isLinkComplete() const {
+    // Without the extension, the status queries of "finishLink" simply wait for the driver
+    if(!linkPending || loadedFromCache || !parallelCompilation) return true;
+    GLint complete = GL_FALSE;
+    glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+bool our::ShaderProgram::finishLink() {
+    if(!linkPending) return linked;
+    linkPending = false;
+    pendingLinks.erase(std::remove(pendingLinks.begin(), pendingLinks.end(), this), pendingLinks.end());
+
+    if(!loadedFromCache){
+        // The errors of the shaders are printed first since they are more useful than the link error they cause
+        bool compiled = true;
+        for(size_t index = 0; index < compiledShaders.size(); index++){
+            if(std::string error = checkForShaderCompilationErrors(compiledShaders[index]); error.size() != 0){
+                std::cerr << "ERROR IN " << sourceFiles[index] << std::endl;
+                std::cerr << error << std::endl;
+                compiled = false;
+            }
+        }
+        compiledShaders.clear();
+        if(!compiled) return false;
+
+        // checkk for linking error if there is an error return false 
+        if(auto error = checkForLinkingErrors(program); error.size() != 0){
+            std::cerr << "LINKING ERROR" << std::endl;
+            std::cerr << error << std::endl;
+            return false;
+        }
+        ProgramCache::store(program, cacheKey);
+    }
+    return readProgramInterface();
+}
+
+void our::ShaderProgram::finishPendingLinks() {
+    // The programs are finished in the order in which the driver completes them
+    // (finishing a program removes it from the list, so the index only moves past the programs that are still compiling)
+    while(!pendingLinks.empty()){
+        bool finishedAny = false;
+        for(size_t index = 0; index < pendingLinks.size();){
+            ShaderProgram* pending = pendingLinks[index];
+            if(pending->isLinkComplete()){
+                pending->finishLink();
+                finishedAny = true;
+            } else {
+                index++;
+            }
+        }
+        if(!finishedAny) std::this_thread::yield();
+    }
+}
+
+bool our::ShaderProgram::readProgramInterface() {
+    // Now that the locations are fixed, we read all the active uniforms once so that "set" never needs to query the driver by name
+    uniformLocations.clear();
+    handleLocations.clear();
+    GLint uniformCount = 0, maxNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    std::vector<GLchar> nameBuffer(std::max(maxNameLength, 1));
+    for(GLint index = 0; index < uniformCount; index++){
+        GLsizei nameLength = 0;
+        GLint arraySize = 0;
+        GLenum type;
+        glGetActiveUniform(program, (GLuint)index, (GLsizei)nameBuffer.size(), &nameLength, &arraySize, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), nameLength);
+        GLint location = glGetUniformLocation(program, name.c_str());
+        // Members of uniform blocks have no location so we skip them
+        if(location < 0) continue;
+        uniformLocations[name] = location;
+        // Arrays of basic types are reported once as "name[0]", so we also store the plain name and the remaining elements
+        if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0){
+            std::string baseName = name.substr(0, name.size() - 3);
+            uniformLocations[baseName] = location;
+            for(GLint element = 1; element < arraySize; element++){
+                std::string elementName = baseName + "[" + std::to_string(element) + "]";
+                uniformLocations[elementName] = glGetUniformLocation(program, elementName.c_str());
+            }
+        }
+    }
+    // Bind the uniform blocks that the renderer streams (and the material block) to their binding points
+    const std::pair<const char*, GLuint> blocks[] = {
+        {"Frame", FRAME_BLOCK_BINDING},
+        {"Object", OBJECT_BLOCK_BINDING},
+        {"MaterialBlock", MATERIAL_BLOCK_BINDING}
+    };
+    for(auto& [blockName, binding] : blocks){
+        GLuint blockIndex = glGetUniformBlockIndex(program, blockName);
+        if(blockIndex != GL_INVALID_INDEX) glUniformBlockBinding(program, blockIndex, binding);
     }
+    linked = true;
 
     return true;
       //TODO: Complete this function
@@ -154,6 +350,38 @@ bool our::ShaderProgram::link() const {
     // program. The returned string will be empty if there is no errors.
 }
 
+////////////////////////////////////////////////////////////////////
+// Uniform handles                                                //
+////////////////////////////////////////////////////////////////////
+
+// The interned uniform names (the index of a name is the id of its handles)
+// They are function-local statics so that handles defined as static variables in other files can be safely constructed at startup
+static std::vector<std::string>& internedUniformNames(){
+    static std::vector<std::string> names;
+    return names;
+}
+
+static std::unordered_map<std::string, GLuint>& internedUniformIds(){
+    static std::unordered_map<std::string, GLuint> ids;
+    return ids;
+}
+
+our::UniformHandle::UniformHandle(const std::string& name) {
+    auto& ids = internedUniformIds();
+    if(auto it = ids.find(name); it != ids.end()){
+        id = it->second;
+    } else {
+        auto& names = internedUniformNames();
+        id = (GLuint)names.size();
+        names.push_back(name);
+        ids[name] = id;
+    }
+}
+
+const std::string& our::UniformHandle::getName() const {
+    return internedUniformNames()[id];
+}
+
 ////////////////////////////////////////////////////////////////////
 // Function to check for compilation and linking error in shaders //
 ////////////////////////////////////////////////////////////////////
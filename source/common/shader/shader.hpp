@@ -2,20 +2,98 @@
 #define SHADER_HPP
 
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
 
 #include <glad/gl.h>
+#include "../gl-state-cache.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 namespace our {
 
+    // A uniform handle is a uniform name that is interned once (e.g. as a static variable in a material or the renderer)
+    // Every shader program keeps a small table indexed by the handle id, so setting a uniform through a handle
+    // costs an array lookup instead of hashing a string or asking the driver for the location
+    class UniformHandle {
+        // The index of the name in the global list of interned uniform names
+        GLuint id;
+    public:
+        // Interns the given name (handles created with the same name share the same id)
+        explicit UniformHandle(const std::string& name);
+
+        GLuint getID() const { return id; }
+        // Returns the uniform name that this handle refers to
+        const std::string& getName() const;
+    };
+
     class ShaderProgram {
 
     private:
         //Shader Program Handle (OpenGL object name)
         GLuint program;
 
+        // The locations of the active uniforms (filled once by "link" from the list of active uniforms)
+        // Array uniforms are stored using their plain name in addition to the name of each element, e.g. "lights", "lights[0]", "lights[1]"...
+        std::unordered_map<std::string, GLint> uniformLocations;
+        // The location of every uniform handle used with this program indexed by the handle id
+        // An entry equal to UNRESOLVED_LOCATION means that the handle was not used with this program yet
+        std::vector<GLint> handleLocations;
+        static constexpr GLint UNRESOLVED_LOCATION = -2;
+        // Whether the program was linked successfully (only then the location table is complete)
+        bool linked = false;
+
+        // The number of times we had to fall back to "glGetUniformLocation" since the last reset
+        static inline std::size_t driverLookups = 0;
+
+        // The program used to draw instanced meshes with the same fragment shader (owned by this program, may be null)
+        ShaderProgram* instancedVariant = nullptr;
+        // The program used to draw the meshes in the depth pre-pass (owned by this program, may be null)
+        ShaderProgram* depthVariant = nullptr;
+
+        // A small sequential id used by the render queue to group the draws using the same program
+        static inline std::uint32_t nextSortId = 0;
+        std::uint32_t sortId = nextSortId++;
+
+        // The GLSL code of the attached shaders (type & source) and the files they were read from
+        // They are only compiled if the program binary isn't found in the program cache
+        std::vector<std::pair<GLenum, std::string>> sources;
+        std::vector<std::string> sourceFiles;
+
+        // The state of a link started by "beginLink": the shaders being compiled (in the order of "sources"),
+        // the key of the program in the program cache and whether the program was loaded from it
+        std::vector<GLuint> compiledShaders;
+        std::uint64_t cacheKey = 0;
+        bool loadedFromCache = false;
+        bool linkPending = false;
+        // The programs whose link was started but not finished yet
+        static inline std::vector<ShaderProgram*> pendingLinks;
+        // Whether the driver compiles the shaders in the background (KHR_parallel_shader_compile)
+        static inline bool parallelCompilation = false;
+
+        // A permutation is a copy of a program compiled with extra #defines (e.g. "ALPHA_TEST" or "GLOBAL_LIGHT_COUNT 2")
+        // so the shader can remove the code of the features it doesn't use at compile time.
+        // All the permutations are owned and cached by the program they were created from (the root) using their sorted defines as the key
+        ShaderProgram* root = this;
+        std::vector<std::string> defines;
+        std::map<std::string, ShaderProgram*> permutations;
+
+        // Submits a shader to the driver and attaches it to the program (its status is only checked by "finishLink")
+        void compile(const std::string &source, GLenum type);
+        // Reads the active uniforms into the location table and binds the uniform blocks
+        bool readProgramInterface();
+
     public:
+        // The binding points of the uniform blocks streamed by the renderer (GLSL 330 can't choose them in the shader,
+        // so "link" binds the blocks named "Frame" and "Object" to them) and of the material block read from the material table
+        static constexpr GLuint FRAME_BLOCK_BINDING = 0;
+        static constexpr GLuint OBJECT_BLOCK_BINDING = 1;
+        static constexpr GLuint MATERIAL_BLOCK_BINDING = 2;
+
         ShaderProgram(){
             //TODO: (Req 1) Create A shader program
             /*
@@ -33,18 +111,74 @@ namespace our {
             Program objects can be deleted by calling glDeleteProgram().
              The memory associated with the program object will be deleted when it is no longer part of current rendering state for any context.
             */
-            if(program) // check if there is a shader program then delete it 
-            glDeleteProgram(program); 
+            for(auto& [key, permutation] : permutations) delete permutation;
+            delete instancedVariant;
+            delete depthVariant;
+            if(linkPending) pendingLinks.erase(std::find(pendingLinks.begin(), pendingLinks.end(), this));
+            if(program){ // check if there is a shader program then delete it 
+                glDeleteProgram(program); 
+                GLStateCache::onProgramDeleted(program);
+            }
 
         }
 
-        bool attach(const std::string &filename, GLenum type) const;
-
-        bool link() const;
+        // Reads the shader from the given file (returns false if it can't be opened)
+        // The given defines are inserted after the "#version" line (each one is a name optionally followed by a value)
+        // The file can include other files using '#include "path"' (relative to its directory)
+        bool attach(const std::string &filename, GLenum type, const std::vector<std::string> &defines = {});
+        // Same as "attach" but the GLSL code is given directly (e.g. a generated shader). The name is only used in the error messages
+        bool attachSource(const std::string &source, GLenum type, const std::string &name, const std::vector<std::string> &defines = {});
+
+        // Links the program then reads all the active uniforms into the location table
+        // The program is loaded from the program cache if possible, otherwise the attached shaders are compiled and linked
+        bool link();
+
+        // The link can also be split in two so that many programs are compiled at the same time:
+        // "beginLink" submits the shaders and the link to the driver without waiting for them (or loads the cached binary)
+        // and "finishLink" checks the results then reads the uniforms (it waits for the driver if it didn't finish yet)
+        bool beginLink();
+        bool finishLink();
+        // Returns true if "finishLink" won't have to wait for the driver
+        bool isLinkComplete() const;
+        // Finishes the links of all the programs that were started, in the order in which the driver completes them
+        static void finishPendingLinks();
+        // Asks the driver to compile the shaders on its own threads (if it supports KHR_parallel_shader_compile)
+        // Should be called once after the OpenGL functions are loaded. Returns false if the extension isn't available.
+        static bool enableParallelCompilation();
 
         void use() { 
-            glUseProgram(program);
+            // A program can't be used before its link is finished
+            if(linkPending) finishLink();
+            GLStateCache::useProgram(program);
+        }
+
+        // Returns the id used to sort the draw commands by program
+        std::uint32_t getSortId() const { return sortId; }
+
+        // The instanced variant reads the model matrix (and a tint) per instance instead of from uniforms
+        // The renderer draws repeated meshes with it when it exists. This program takes the ownership of the variant.
+        void setInstancedVariant(ShaderProgram* variant){
+            delete instancedVariant;
+            instancedVariant = variant;
+        }
+        ShaderProgram* getInstancedVariant() const { return instancedVariant; }
+
+        // The depth variant links the same vertex shader with an empty fragment shader.
+        // The renderer uses it to fill the depth buffer before drawing the expensive materials. This program takes the ownership of the variant.
+        void setDepthVariant(ShaderProgram* variant){
+            delete depthVariant;
+            depthVariant = variant;
         }
+        ShaderProgram* getDepthVariant() const { return depthVariant; }
+
+        // Creates a new program from the sources of this one (and a copy of its instanced variant) with the given defines added.
+        // The caller takes the ownership of the program. Its link is started but not finished.
+        ShaderProgram* createPermutation(const std::vector<std::string> &defines) const;
+        // Returns the permutation of the root program that has the defines of this program in addition to the given ones
+        // (it is created the first time it is requested, then it is returned from the cache of the root)
+        ShaderProgram* getPermutation(const std::vector<std::string> &defines);
+        // The defines this program was compiled with (empty for a root program)
+        const std::vector<std::string>& getDefines() const { return defines; }
         /*
         glGetUniformLocation — Returns the location of a uniform variable
 
@@ -250,12 +384,34 @@ namespace our {
                 4-value : For the vector and matrix commands, specifies a pointer to an array of count values that will be used to update 
                 the specified uniform variable.
         */
-        GLuint getUniformLocation(const std::string &name) {
+        GLint getUniformLocation(const std::string &name) {
             //TODO: (Req 1) Return the location of the uniform with the given name
-            return glGetUniformLocation(program,name.c_str());
+            // We first search the table built during linking
+            if(auto it = uniformLocations.find(name); it != uniformLocations.end()) return it->second;
+            // After a successful link, the table holds every active uniform, so a simple name that is not in the table is inactive
+            // Names with subscripts or fields could still be valid (e.g. "lights[2].position" of a partially used array)
+            if(linked && name.find_first_of("[.") == std::string::npos) return -1;
+            // Otherwise, we ask the driver and remember the answer so that we don't ask again
+            ++driverLookups;
+            GLint location = glGetUniformLocation(program,name.c_str());
+            uniformLocations[name] = location;
+            return location;
+        }
 
+        // Returns the location of the uniform referred to by the handle
+        // The first use of a handle with this program resolves it from the table, later uses are just an array access
+        GLint getUniformLocation(const UniformHandle &handle) {
+            GLuint id = handle.getID();
+            if(id >= handleLocations.size()) handleLocations.resize(id + 1, UNRESOLVED_LOCATION);
+            if(handleLocations[id] == UNRESOLVED_LOCATION) handleLocations[id] = getUniformLocation(handle.getName());
+            return handleLocations[id];
         }
 
+        // The number of "glGetUniformLocation" calls issued while setting uniforms since the last reset
+        // The renderer resets it every frame, so after the first frame it should stay at zero
+        static std::size_t getDriverLookupCount() { return driverLookups; }
+        static void resetDriverLookupCount() { driverLookups = 0; }
+
         void set(const std::string &uniform, GLfloat value) {
             //TODO: (Req 1) Send the given float value to the given uniform
             glUniform1f(getUniformLocation(uniform),value);
@@ -292,6 +448,39 @@ namespace our {
             glUniformMatrix4fv(getUniformLocation(uniform), 1, false, glm::value_ptr(matrix));
         }
 
+        // The same setters but using pre-resolved uniform handles (used by the materials and the renderer)
+        void set(const UniformHandle &uniform, GLfloat value) {
+            glUniform1f(getUniformLocation(uniform), value);
+        }
+
+        void set(const UniformHandle &uniform, GLuint value) {
+            glUniform1ui(getUniformLocation(uniform), value);
+        }
+
+        void set(const UniformHandle &uniform, GLint value) {
+            glUniform1i(getUniformLocation(uniform), value);
+        }
+
+        void set(const UniformHandle &uniform, glm::vec2 value) {
+            glUniform2f(getUniformLocation(uniform), value.x, value.y);
+        }
+
+        void set(const UniformHandle &uniform, glm::vec3 value) {
+            glUniform3f(getUniformLocation(uniform), value.x, value.y, value.z);
+        }
+
+        void set(const UniformHandle &uniform, glm::vec4 value) {
+            glUniform4f(getUniformLocation(uniform), value.x, value.y, value.z, value.w);
+        }
+
+        void set(const UniformHandle &uniform, glm::ivec3 value) {
+            glUniform3i(getUniformLocation(uniform), value.x, value.y, value.z);
+        }
+
+        void set(const UniformHandle &uniform, glm::mat4 matrix) {
+            glUniformMatrix4fv(getUniformLocation(uniform), 1, false, glm::value_ptr(matrix));
+        }
+
         //TODO: (Req 1) Delete the copy constructor and assignment operator.
         //Question: Why do we delete the copy constructor and assignment operator?
         ShaderProgram(ShaderProgram const &) = delete; // Delete the copy constructor
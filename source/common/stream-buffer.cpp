@@ -0,0 +1,105 @@
+#include "stream-buffer.hpp"
+
+#include <algorithm>
+
+namespace our {
+
+    // Rounds the size up to a multiple of the alignment
+    static size_t alignUp(size_t size, size_t alignment){
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    void StreamBuffer::initialize(size_t initialRegionSize, size_t alignment){
+        this->alignment = std::max<size_t>(alignment, 16);
+        persistent = GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+        allocate(initialRegionSize);
+    }
+
+    void StreamBuffer::allocate(size_t size){
+        // The old buffer may still be read by the GPU, but deleting it is safe (the driver keeps it alive until the draws are done)
+        for(int index = 0; index < REGION_COUNT; index++) if(fences[index]){
+            glDeleteSync(fences[index]);
+            fences[index] = 0;
+        }
+        if(buffer) glDeleteBuffers(1, &buffer);
+        regionSize = alignUp(std::max<size_t>(size, 1), alignment);
+        region = 0;
+        mapped = nullptr;
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        if(persistent){
+            // The storage is immutable and stays mapped until the buffer is deleted.
+            // A coherent mapping makes the writes visible to the GPU without flushing them.
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            GLsizeiptr totalSize = (GLsizeiptr)(regionSize * REGION_COUNT);
+            glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags);
+            mapped = (std::uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags);
+            if(!mapped){
+                // If the mapping failed, we fall back to uploading the data every frame
+                persistent = false;
+                glDeleteBuffers(1, &buffer);
+                glGenBuffers(1, &buffer);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+                glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)regionSize, nullptr, GL_STREAM_DRAW);
+            }
+        } else {
+            glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)regionSize, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    void StreamBuffer::waitRegion(int index){
+        if(!fences[index]) return;
+        // Flush the commands on the first try so the fence is guaranteed to be signaled eventually
+        GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while(true){
+            GLenum result = glClientWaitSync(fences[index], flags, 1000000); // 1ms
+            if(result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) break;
+            flags = 0;
+        }
+        glDeleteSync(fences[index]);
+        fences[index] = 0;
+    }
+
+    void StreamBuffer::destroy(){
+        for(int index = 0; index < REGION_COUNT; index++) if(fences[index]){
+            glDeleteSync(fences[index]);
+            fences[index] = 0;
+        }
+        // Deleting the buffer also unmaps it
+        if(buffer) glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        mapped = nullptr;
+        regionSize = 0;
+        staging.clear();
+    }
+
+    std::uint8_t* StreamBuffer::begin(size_t size){
+        frameSize = size;
+        if(size > regionSize) allocate(std::max(size, regionSize * 2));
+        else region = (region + 1) % REGION_COUNT;
+        if(persistent){
+            waitRegion(region);
+            return mapped + region * regionSize;
+        }
+        staging.resize(size);
+        return staging.data();
+    }
+
+    void StreamBuffer::end(){
+        if(persistent || frameSize == 0) return;
+        // Orphan the old storage (the GPU may still be reading it) then upload the new data
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)regionSize, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)frameSize, staging.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    void StreamBuffer::fence(){
+        if(!persistent) return;
+        if(fences[region]) glDeleteSync(fences[region]);
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace our {
+
+    // A buffer to which the data generated every frame (e.g. the instances and the per-draw uniform blocks) is streamed.
+    // The buffer is split into REGION_COUNT regions used in turn, so the CPU writes the data of a frame while the GPU
+    // may still be reading the data of the previous frames.
+    // If the driver supports ARB_buffer_storage, the buffer is mapped once (persistently) and the data is written directly
+    // into it: a fence is inserted after the draws of each frame and the CPU only waits for it if it wraps around to that region
+    // before the GPU is done. Otherwise (plain OpenGL 3.3), the data is written to a copy in the RAM then uploaded in a single call
+    // after orphaning the storage of the buffer.
+    // In both cases, the frame data is read from "getBuffer" starting at "getOffset" (e.g. using glBindBufferRange).
+    class StreamBuffer {
+    public:
+        static constexpr int REGION_COUNT = 3;
+
+    private:
+        GLuint buffer = 0;
+        // The size of each region (a multiple of "alignment") and the region used by the current frame
+        size_t regionSize = 0;
+        size_t alignment = 256;
+        int region = 0;
+        // The fences that tell when the GPU is done with the draws that read each region
+        GLsync fences[REGION_COUNT] = {};
+        bool persistent = false;
+        std::uint8_t* mapped = nullptr;   // The persistent mapping of the whole buffer
+        std::vector<std::uint8_t> staging; // The copy in the RAM (if the buffer can't be persistently mapped)
+        size_t frameSize = 0;
+
+        // (Re)creates the buffer with regions of the given size
+        void allocate(size_t size);
+        // Waits until the GPU is done with the given region
+        void waitRegion(int index);
+
+    public:
+        // Creates the buffer. "alignment" is the alignment of the region offsets (e.g. GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT)
+        void initialize(size_t initialRegionSize, size_t alignment);
+        // Deletes the buffer (should be called before the OpenGL context is destroyed)
+        void destroy();
+
+        // Starts the data of a new frame and returns a pointer to "size" bytes to which it should be written
+        // (the regions grow if they are too small). The pointer must only be written, never read.
+        std::uint8_t* begin(size_t size);
+        // Finishes the data of the frame (uploads it if the buffer isn't persistently mapped)
+        void end();
+        // Must be called after the last draw that reads the data of the frame
+        void fence();
+
+        GLuint getBuffer() const { return buffer; }
+        // The offset of the data of the current frame in the buffer (a multiple of the alignment)
+        GLintptr getOffset() const { return persistent ? (GLintptr)(region * regionSize) : 0; }
+        bool isPersistent() const { return persistent; }
+        // The number of bytes written in the current frame
+        size_t getFrameSize() const { return frameSize; }
+    };
+
+}
@@ -0,0 +1,66 @@
+#include "color-lut.hpp"
+#include "../shader/shader.hpp"
+#include "../material/pipeline-state.hpp"
+#include "../gl-state-cache.hpp"
+
+namespace our {
+
+    static const UniformHandle lutSliceUniform("lut_slice");
+
+    Texture3D* bakeColorLUT(const std::string& functions, const std::vector<std::string>& calls, GLuint vertexArray){
+        // Each texel of a slice holds the result of the grades for the color at its position in the table
+        // (the red & green come from the texel position in the slice and the blue from the slice number)
+        std::string source =
+            "#version 330\n"
+            "\n"
+            "// Generated by bakeColorLUT\n"
+            "#define COLOR_LUT_SIZE " + std::to_string(COLOR_LUT_SIZE) + ".0\n"
+            "uniform int lut_slice;\n"
+            "out vec4 frag_color;\n"
+            "\n" + functions + "\n"
+            "void main(){\n"
+            "    vec4 color = vec4(vec3(floor(gl_FragCoord.xy), float(lut_slice)) / (COLOR_LUT_SIZE - 1.0), 1.0);\n"
+            "    // The grades don't depend on the position of the pixel, so any texture coordinate works\n"
+            "    vec2 tex_coord = vec2(0.5);\n";
+        for(const std::string& call : calls) source += "    color = " + call + "(color, tex_coord);\n";
+        source += "    frag_color = color;\n}\n";
+
+        ShaderProgram program;
+        program.attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
+        program.attachSource(source, GL_FRAGMENT_SHADER, "color LUT baker");
+        if(!program.link()) return nullptr;
+
+        // The table is stored as half floats so the colors pushed above 1 by a grade (e.g. sepia) reach the next effect unclamped
+        Texture3D* lut = new Texture3D();
+        lut->bind();
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, COLOR_LUT_SIZE, COLOR_LUT_SIZE, COLOR_LUT_SIZE, 0, GL_RGBA, GL_FLOAT, nullptr);
+        // The table is read with trilinear filtering so the colors between two entries are interpolated
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+
+        GLuint framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        GLStateCache::bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, COLOR_LUT_SIZE, COLOR_LUT_SIZE);
+        PipelineState pipelineState;
+        pipelineState.depthMask = false;
+        pipelineState.setup();
+        program.use();
+        GLStateCache::bindVertexArray(vertexArray);
+        // Each slice is attached to the framebuffer in turn and covered by a fullscreen triangle
+        for(int slice = 0; slice < COLOR_LUT_SIZE; slice++){
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, lut->getOpenGLName(), 0, slice);
+            program.set(lutSliceUniform, slice);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        GLStateCache::bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        GLStateCache::onFramebufferDeleted(framebuffer);
+        return lut;
+    }
+
+}
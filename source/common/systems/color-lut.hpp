@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../texture/texture3d.hpp"
+
+#include <glad/gl.h>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // The number of entries of a color lookup table along each axis (the table holds COLOR_LUT_SIZE^3 colors)
+    constexpr int COLOR_LUT_SIZE = 32;
+
+    // A color lookup table (LUT) maps each color to the result of a list of color grades (effects that only depend on the color of the pixel).
+    // The grades are evaluated once for every entry of the table, then a shader replaces all of them by a single texture read
+    // (see "assets/shaders/postprocess/color-lut.glsl"), so any number of grades costs the same per pixel.
+    // "functions" is the GLSL code defining the grades as "vec4 name(vec4 color, vec2 tex_coord)" and "calls" lists the names of the ones
+    // applied (in order). The table is drawn by the GPU (one fullscreen triangle per slice) using the given empty vertex array.
+    // The caller takes the ownership of the texture. Returns null if the baking shader couldn't be linked.
+    Texture3D* bakeColorLUT(const std::string& functions, const std::vector<std::string>& calls, GLuint vertexArray);
+
+}
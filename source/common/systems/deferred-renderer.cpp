@@ -0,0 +1,98 @@
+#include "deferred-renderer.hpp"
+#include "../material/material-table.hpp"
+#include "../gl-state-cache.hpp"
+
+namespace our {
+
+    static const UniformHandle albedoUniform("gbuffer_albedo");
+    static const UniformHandle normalUniform("gbuffer_normal");
+    static const UniformHandle materialUniform("gbuffer_material");
+    static const UniformHandle emissiveUniform("gbuffer_emissive");
+    static const UniformHandle depthUniform("gbuffer_depth");
+    static const UniformHandle inverseVPUniform("inverse_VP");
+    static const UniformHandle skyTopUniform("sky.top");
+    static const UniformHandle skyMiddleUniform("sky.middle");
+    static const UniformHandle skyBottomUniform("sky.bottom");
+
+    void DeferredRenderer::initialize(glm::ivec2 windowSize, const nlohmann::json& config){
+        // The lit opaque objects are put in the deferred pass and the scene is drawn to render targets
+        deferredShading = true;
+        lightingProgram = new ShaderProgram();
+        lightingProgram->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
+        lightingProgram->attach("assets/shaders/deferred-lighting.frag", GL_FRAGMENT_SHADER);
+        lightingProgram->beginLink();
+        glGenVertexArrays(1, &vertexArray);
+        lightingState.depthTesting.enabled = false;
+        lightingState.depthMask = false;
+        // The forward renderer finishes the pending links (including the lighting program)
+        ForwardRenderer::initialize(windowSize, config);
+    }
+
+    void DeferredRenderer::addDeferredPasses(RenderGraph& graph, const DeferredFrame& frame){
+        // The layout of the G-buffer is described in "gbuffer.glsl"
+        RenderGraph::Resource albedo = graph.createTarget("gbuffer albedo", {GL_RGBA8, frame.size});
+        RenderGraph::Resource normal = graph.createTarget("gbuffer normal", {GL_RG16F, frame.size});
+        RenderGraph::Resource material = graph.createTarget("gbuffer material", {GL_RGBA8, frame.size});
+        RenderGraph::Resource emissive = graph.createTarget("gbuffer emissive", {GL_R11F_G11F_B10F, frame.size});
+        RenderGraph::Resource depth = frame.sceneDepth;
+
+        // The geometry pass writes the surface data of the lit opaque objects and the depth of the scene
+        graph.addPass("gbuffer", {}, {albedo, normal, material, emissive, depth}, [frame](const RenderGraph::PassContext&){
+            GLStateCache::colorMask(glm::bvec4(true));
+            GLStateCache::depthMask(true);
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClearDepth(1.0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            frame.drawGeometry();
+        });
+
+        // The lighting pass shades the pixels covered by the lit objects (the others stay black until the forward objects and the sky are drawn)
+        graph.addPass("deferred lighting", {albedo, normal, material, emissive, depth}, {frame.sceneColor},
+            [this, frame, albedo, normal, material, emissive, depth](const RenderGraph::PassContext& pass){
+            GLStateCache::colorMask(glm::bvec4(true));
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            // The lighting program is specialized for the lights of the scene like the forward lit shaders
+            // (like the materials, the generic program is used until a new permutation is linked)
+            ShaderProgram* program = lightingProgram->getPermutation(MaterialTable::getLightDefines());
+            if(!program->isLinkComplete()) program = lightingProgram;
+            lightingState.setup();
+            program->use();
+            // The G-buffer uses the units before the ones of the light clusters and is read without a sampler (using texelFetch)
+            const RenderGraph::Resource inputs[] = {albedo, normal, material, emissive, depth};
+            const UniformHandle* uniforms[] = {&albedoUniform, &normalUniform, &materialUniform, &emissiveUniform, &depthUniform};
+            for(GLuint unit = 0; unit < 5; unit++){
+                GLStateCache::bindTexture(unit, GL_TEXTURE_2D, pass.getTexture(inputs[unit])->getOpenGLName());
+                GLStateCache::bindSampler(unit, 0);
+                program->set(*uniforms[unit], (GLint)unit);
+            }
+            frame.lightClusters->setUniforms(program);
+            // The same sky lights as the forward lit objects
+            program->set(skyTopUniform, skyLight.top);
+            program->set(skyMiddleUniform, skyLight.middle);
+            program->set(skyBottomUniform, skyLight.bottom);
+            program->set(inverseVPUniform, glm::inverse(frame.VP));
+            GLStateCache::bindVertexArray(vertexArray);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        });
+    }
+
+    void DeferredRenderer::warmLightPermutations(const std::vector<std::string>& defines){
+        // The lighting program is linked together with the permutations of the materials
+        lightingProgram->getPermutation(defines);
+        ForwardRenderer::warmLightPermutations(defines);
+    }
+
+    void DeferredRenderer::destroy(){
+        ForwardRenderer::destroy();
+        delete lightingProgram;
+        lightingProgram = nullptr;
+        if(vertexArray){
+            glDeleteVertexArrays(1, &vertexArray);
+            GLStateCache::onVertexArrayDeleted(vertexArray);
+            vertexArray = 0;
+        }
+    }
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "forward-renderer.hpp"
+#include "../shader/shader.hpp"
+#include "../material/pipeline-state.hpp"
+
+#include <glad/gl.h>
+
+namespace our
+{
+
+    // A deferred renderer draws the surface data of the lit opaque objects to a G-buffer (see "assets/shaders/gbuffer.glsl")
+    // then shades every pixel once in a fullscreen pass, so the cost of the lights doesn't depend on the overdraw of the scene.
+    // The lights are read from the same clusters as the forward shaders, so each pixel only loops over the lights of its cluster.
+    // Everything else is drawn by the forward renderer over the result using the depth of the G-buffer:
+    // the unlit objects, the sky and the transparent objects (which can't be stored in a G-buffer).
+    // It is selected using "type": "deferred" in the renderer config, so both renderers can be compared on the same world.
+    class DeferredRenderer : public ForwardRenderer {
+        // Reads the G-buffer and the depth of the scene and computes the lit color of each pixel
+        ShaderProgram* lightingProgram = nullptr;
+        // The lighting pass doesn't test nor write the depth (the depth of the G-buffer is kept for the forward objects)
+        PipelineState lightingState;
+        // The lighting pass draws a fullscreen triangle whose vertices are generated by the vertex shader, so the vertex array is empty
+        GLuint vertexArray = 0;
+
+    protected:
+        void addDeferredPasses(RenderGraph& graph, const DeferredFrame& frame) override;
+        void warmLightPermutations(const std::vector<std::string>& defines) override;
+
+    public:
+        void initialize(glm::ivec2 windowSize, const nlohmann::json& config) override;
+        void destroy() override;
+    };
+
+}
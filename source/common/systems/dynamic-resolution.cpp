@@ -0,0 +1,88 @@
+#include "dynamic-resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace our {
+
+    void DynamicResolution::initialize(const nlohmann::json& config){
+        if(!config.is_object()) return;
+        // The scene is only scaled when the config asks for it (a renderer config without the key keeps the full resolution)
+        enabled = config.value("enabled", enabled);
+        targetFrameTime = config.value("targetFrameTime", targetFrameTime);
+        minScale = std::clamp(config.value("minScale", minScale), 0.1f, 1.0f);
+        maxScale = std::clamp(config.value("maxScale", maxScale), minScale, 1.0f);
+        scaleStep = std::max(config.value("scaleStep", scaleStep), 0.01f);
+        lowerThreshold = config.value("lowerThreshold", lowerThreshold);
+        upperThreshold = std::max(config.value("upperThreshold", upperThreshold), lowerThreshold);
+        cooldownFrames = config.value("cooldownFrames", cooldownFrames);
+        smoothing = std::clamp(config.value("smoothing", smoothing), 0.01f, 1.0f);
+        if(!enabled) return;
+
+        // The scale starts at its maximum and only goes down if the GPU can't keep up
+        scale = maxScale;
+        glGenQueries(QUERY_COUNT, queries);
+    }
+
+    void DynamicResolution::destroy(){
+        if(queries[0]) glDeleteQueries(QUERY_COUNT, queries);
+        for(int index = 0; index < QUERY_COUNT; index++){
+            queries[index] = 0;
+            pending[index] = false;
+        }
+    }
+
+    void DynamicResolution::beginFrame(){
+        if(!enabled) return;
+        // Read the finished queries from the oldest to the newest (the GPU finishes them in the order they were issued)
+        for(int offset = 1; offset <= QUERY_COUNT; offset++){
+            int index = (current + offset) % QUERY_COUNT;
+            if(!pending[index]) continue;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+            if(!available) break;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &elapsed);
+            pending[index] = false;
+            lastTime = (float)(elapsed / 1.0e6);
+            smoothedTime = measured ? glm::mix(smoothedTime, lastTime, smoothing) : lastTime;
+            measured = true;
+        }
+        framesSinceChange++;
+        if(measured) updateScale();
+
+        // If the query of this frame is still pending (the GPU is more than QUERY_COUNT frames behind), the frame isn't timed
+        current = (current + 1) % QUERY_COUNT;
+        timing = !pending[current];
+        if(timing) glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+
+    void DynamicResolution::endFrame(){
+        if(!enabled || !timing) return;
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[current] = true;
+        timing = false;
+    }
+
+    void DynamicResolution::updateScale(){
+        if(framesSinceChange < cooldownFrames) return;
+        if(smoothedTime >= lowerThreshold * targetFrameTime && smoothedTime <= upperThreshold * targetFrameTime) return;
+        // Most of the GPU time is spent per pixel, so the time is roughly proportional to the area (the square of the scale)
+        // The scale that reaches the middle of the band is computed then limited to a few steps per change
+        float goal = targetFrameTime * 0.5f * (lowerThreshold + upperThreshold);
+        float wanted = scale * std::sqrt(goal / std::max(smoothedTime, 0.01f));
+        wanted = std::clamp(wanted, scale - 4 * scaleStep, scale + 4 * scaleStep);
+        wanted = std::clamp(std::round(wanted / scaleStep) * scaleStep, minScale, maxScale);
+        // The rounding can bring the scale back to its current value, then at least one step is taken in the wanted direction
+        if(wanted == scale) wanted = std::clamp(smoothedTime > goal ? scale - scaleStep : scale + scaleStep, minScale, maxScale);
+        if(wanted == scale) return;
+        scale = wanted;
+        framesSinceChange = 0;
+    }
+
+    glm::ivec2 DynamicResolution::getRenderSize(glm::ivec2 windowSize) const {
+        if(!enabled) return windowSize;
+        return glm::max(glm::ivec2(glm::vec2(windowSize) * scale + 0.5f), glm::ivec2(1));
+    }
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+
+namespace our {
+
+    // Dynamic resolution scales the size of the scene render targets to keep the GPU time of a frame under a target.
+    // The GPU time of every frame is measured with a timer query (GL_TIME_ELAPSED). The results are only read once they are available,
+    // so they arrive a few frames late but the CPU never waits for the GPU.
+    // The scene is drawn at "scale" times the window size and the first postprocess pass upscales it to the window (see PostprocessChain).
+    // To avoid oscillating between two sizes, the scale only changes when the smoothed GPU time leaves a band around the target
+    // (above "upperThreshold" or below "lowerThreshold" times the target) and then waits "cooldownFrames" frames before changing again.
+    class DynamicResolution {
+        // The number of timer queries in flight (one is issued per frame)
+        static constexpr int QUERY_COUNT = 4;
+
+        bool enabled = false;
+        // The GPU time (in milliseconds) that the frames should take
+        float targetFrameTime = 16.0f;
+        // The range of the scale (relative to the window size along each axis) and the size of its steps
+        // (the scale is rounded to a multiple of the step so the render graph doesn't allocate targets for every small change)
+        float minScale = 0.5f, maxScale = 1.0f, scaleStep = 0.05f;
+        // The band around the target (as fractions of the target) inside which the scale is kept
+        float lowerThreshold = 0.8f, upperThreshold = 1.0f;
+        // The number of frames to wait after a change before the scale can change again (so the new scale is measured first)
+        int cooldownFrames = 10;
+        // The weight of the newest measurement in the smoothed GPU time
+        float smoothing = 0.2f;
+
+        float scale = 1.0f;
+        float smoothedTime = 0.0f, lastTime = 0.0f;
+        bool measured = false;
+        int framesSinceChange = 0;
+
+        GLuint queries[QUERY_COUNT] = {};
+        bool pending[QUERY_COUNT] = {};
+        int current = 0;
+        // Whether a query was started this frame (it isn't when all the queries are still pending)
+        bool timing = false;
+
+        // Moves the scale toward the one that would make the smoothed time reach the target
+        void updateScale();
+    public:
+        // Creates the timer queries. The config may contain "enabled", "targetFrameTime" (ms), "minScale", "maxScale", "scaleStep",
+        // "lowerThreshold", "upperThreshold", "cooldownFrames" and "smoothing"
+        void initialize(const nlohmann::json& config);
+        // Deletes the timer queries
+        void destroy();
+
+        bool isEnabled() const { return enabled; }
+        // Should be called before the first draw of the frame: reads the available timings, updates the scale and starts timing the frame
+        void beginFrame();
+        // Should be called after the last draw of the frame
+        void endFrame();
+
+        // Returns the size of the scene render targets for the given window size
+        glm::ivec2 getRenderSize(glm::ivec2 windowSize) const;
+        float getScale() const { return scale; }
+        // Returns the last measured GPU time of a frame and its smoothed value (in milliseconds)
+        float getLastFrameTime() const { return lastTime; }
+        float getSmoothedFrameTime() const { return smoothedTime; }
+    };
+
+}
@@ -1,13 +1,75 @@
 #include "forward-renderer.hpp"
 #include "../mesh/mesh-utils.hpp"
 #include "../texture/texture-utils.hpp"
+#include "../job-system.hpp"
+#include "../render-thread.hpp"
+#include "../material/material-table.hpp"
 
 namespace our {
 
+    // The number of render commands culled (or prepared) by each chunk of a parallel loop
+    static constexpr size_t COMMAND_CHUNK_SIZE = 512;
+
+    // Rounds the size up to a multiple of the alignment
+    static size_t alignUp(size_t size, size_t alignment){
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    // The uniforms sent by the renderer are resolved once into handles, so the draw loop never looks them up by string
+    static const UniformHandle transformUniform("transform");
+    static const UniformHandle skyTopUniform("sky.top");
+    static const UniformHandle skyMiddleUniform("sky.middle");
+    static const UniformHandle skyBottomUniform("sky.bottom");
+    static const UniformHandle accumulationTexUniform("accumulation_tex");
+    static const UniformHandle weightTexUniform("weight_tex");
+
+    // The largest number of global lights for which the lit shaders are compiled with the exact count
+    static constexpr size_t MAX_SPECIALIZED_GLOBAL_LIGHTS = 4;
+
+    // Returns the defines that specialize the lit shaders for the given light types (a bit for each type) and number of global lights
+    // (a permutation is compiled for each combination, so a very large global count is left dynamic)
+    static std::vector<std::string> makeLightDefines(unsigned int types, size_t globalCount){
+        std::vector<std::string> defines;
+        if(types & (1u << 0)) defines.push_back("HAS_DIRECTIONAL_LIGHTS");
+        if(types & (1u << 1)) defines.push_back("HAS_POINT_LIGHTS");
+        if(types & (1u << 2)) defines.push_back("HAS_SPOT_LIGHTS");
+        if(globalCount <= MAX_SPECIALIZED_GLOBAL_LIGHTS) defines.push_back("GLOBAL_LIGHT_COUNT " + std::to_string(globalCount));
+        return defines;
+    }
+
+    // Returns true if the material can be drawn in the depth pre-pass:
+    // its shader (and its instanced variant) must have a depth variant and the material must test & write the depth
+    static bool usesDepthPrepass(const Material* material){
+        const ShaderProgram* shader = material->shader;
+        if(!shader->getDepthVariant()) return false;
+        if(shader->getInstancedVariant() && !shader->getInstancedVariant()->getDepthVariant()) return false;
+        return material->pipelineState.depthTesting.enabled && material->pipelineState.depthMask;
+    }
+
     void ForwardRenderer::initialize(glm::ivec2 windowSize, const nlohmann::json& config){
         // First, we store the window size for later use
         this->windowSize = windowSize;
 
+        // Create the buffers used to send the clustered lights to the lit shaders
+        lightClusters.initialize(config.value("clusters", nlohmann::json::object()));
+        // Create the buffer to which the instances and the uniform blocks are streamed every frame
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        uniformAlignment = (size_t)std::max(alignment, 16);
+        objectBlockStride = alignUp(sizeof(ObjectBlock), uniformAlignment);
+        frameData.initialize(1 << 20, uniformAlignment);
+        // Start the threads that cull & sort the commands ("workerThreads" is their number, -1 uses all the cores)
+        JobSystem::get().start(config.value("workerThreads", -1));
+        // Read the static batching options
+        staticBatching = config.value("staticBatching", staticBatching);
+        staticBatchCellSize = config.value("staticBatchCellSize", staticBatchCellSize);
+        // Read the depth pre-pass option and create the queries used to count the fragments it saves (if the driver can count them)
+        depthPrepass = config.value("depthPrepass", depthPrepass);
+        lodSelector.initialize(config);
+        occlusionCuller.initialize(config.value("occlusionCulling", nlohmann::json::object()));
+        if(depthPrepass && (GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_pipeline_statistics_query))
+            glGenQueries(4, &fragmentQueries[0][0]);
+
         // Then we check if there is a sky texture in the configuration
         if(config.contains("sky")){
             // First, we create a sphere which will be used to draw the sky
@@ -17,7 +79,8 @@ namespace our {
             ShaderProgram* skyShader = new ShaderProgram();
             skyShader->attach("assets/shaders/textured.vert", GL_VERTEX_SHADER);
             skyShader->attach("assets/shaders/textured.frag", GL_FRAGMENT_SHADER);
-            skyShader->link();
+            // The driver compiles the program while the sky texture is loaded (the link is finished at the end of "initialize")
+            skyShader->beginLink();
             
             //TODO: (Req 10) Pick the correct pipeline state to draw the sky
             // Hints: the sky will be draw after the opaque objects so we would need depth testing but which depth funtion should we pick?
@@ -54,121 +117,52 @@ namespace our {
             this->skyMaterial->transparent = false;
         }
 
-        // Then we check if there is a postprocessing shader in the configuration
-        if(config.contains("postprocess")){
-            //TODO: (Req 11) Create a framebuffer
-            /*
-            here we are performing the post process here we are drawing on the texture it self it is something like making mirror :)
-            ///////////////////////////////////////////////////////////////////////
-            Name
-              glGenFramebuffers — generate framebuffer object names
-
-           C Specification
-            void glGenFramebuffers(	GLsizei n,
-                GLuint *ids);
- 
-           Parameters
-            1-n : Specifies the number of framebuffer object names to generate.
-
-            2-ids : Specifies an array in which the generated framebuffer object names are stored.
-
-            /////////////////////////////////////////////////////////////////////////////////////
-            Name
-              glBindFramebuffer — bind a framebuffer to a framebuffer target
-
-            C Specification
-                void glBindFramebuffer(	GLenum target,
-                    GLuint framebuffer);
-                
-            Parameters
-                1-target : Specifies the framebuffer target of the binding operation.
-
-                2-framebuffer : Specifies the name of the framebuffer object to bind.
-            */
-           
-              glGenFramebuffers(1, &postprocessFrameBuffer); // Create a framebuffer
-              glBindFramebuffer(GL_DRAW_FRAMEBUFFER, postprocessFrameBuffer); // bind a framebuffer(texture that we will draw on ,buffer)
-            //TODO: (Req 11) Create a color and a depth texture and attach them to the framebuffer
-            // Hints: The color format can be (Red, Green, Blue and Alpha components with 8 bits for each channel).
-            // The depth format can be (Depth component with 24 bits).
-             colorTarget = texture_utils::empty(GL_RGBA8, windowSize);//color 
-
-            depthTarget = texture_utils::empty(GL_DEPTH_COMPONENT24, windowSize);//depth texture
-
-            /*
-Name
-     glFramebufferTexture2D — attach a texture image to a framebuffer object
-
-C Specification
-    void glFramebufferTexture2D(	GLenum target,
-        GLenum attachment,
-        GLenum textarget,
-        GLuint texture,
-        GLint level);
- 
-Parameters
-        1-target : Specifies the framebuffer target. The symbolic constant must be GL_FRAMEBUFFER.
-
-        2-attachment : Specifies the attachment point to which an image from texture should be attached. Must be one of the following symbolic constants: GL_COLOR_ATTACHMENT0, GL_DEPTH_ATTACHMENT, or GL_STENCIL_ATTACHMENT.
-
-        3-textarget : Specifies the texture target. Must be one of the following symbolic constants: GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_TEXTURE_CUBE_MAP_NEGATIVE_X, GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, GL_TEXTURE_CUBE_MAP_POSITIVE_Z, or GL_TEXTURE_CUBE_MAP_NEGATIVE_Z.
-
-        4-texture : Specifies the texture object whose image is to be attached.
-
-        5-level : Specifies the mipmap level of the texture image to be attached, which must be 0.
-            
-            */
-
-            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTarget->getOpenGLName(), 0);//attach depth
-
-            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTarget->getOpenGLName(), 0);//attach color
-            
-            //TODO: (Req 11) Unbind the framebuffer just to be safe
-            // pass to it zero to unvind the buffer
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); // unbind the frame buffer 
-            // Create a vertex array to use for drawing the texture
-            /*
-            
-         Name
-             glGenVertexArrays — generate vertex array object names
-
-         C Specification
-            void glGenVertexArrays(	GLsizei n,
-                GLuint *arrays);
- 
-         Parameters
-            1-n : Specifies the number of vertex array object names to generate.
+        // Read the dynamic resolution options (the scene is drawn at a lower resolution when the GPU can't keep up)
+        dynamicResolution.initialize(config.value("dynamicResolution", nlohmann::json::object()));
+
+        // Read the weighted blended transparency option. The transparent objects are then drawn in any order (grouped by state like the opaque ones)
+        // to accumulation targets that a composite pass blends over the scene
+        weightedOIT = config.value("weightedOIT", weightedOIT);
+        renderQueue.setOrderedTransparency(!weightedOIT);
+        if(weightedOIT){
+            oitCompositeProgram = new ShaderProgram();
+            oitCompositeProgram->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
+            oitCompositeProgram->attach("assets/shaders/weighted-oit-composite.frag", GL_FRAGMENT_SHADER);
+            oitCompositeProgram->beginLink();
+            glGenVertexArrays(1, &oitVertexArray);
+            // The average color of the transparent fragments is blended over the scene using the part of the scene they hide
+            oitCompositeState.blending.enabled = true;
+            oitCompositeState.blending.sourceFactor = GL_SRC_ALPHA;
+            oitCompositeState.blending.destinationFactor = GL_ONE_MINUS_SRC_ALPHA;
+            oitCompositeState.depthMask = false;
+        }
 
-            2-arrays : Specifies an array in which the generated vertex array object names are stored.
-            
-            */
-            glGenVertexArrays(1, &postProcessVertexArray);//postProcessVertexArray vertex array 
-
-            // Create a sampler to use for sampling the scene texture in the post processing shader
-            Sampler* postprocessSampler = new Sampler();
-            postprocessSampler->set(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            postprocessSampler->set(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            postprocessSampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            postprocessSampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-            // Create the post processing shader
-            ShaderProgram* postprocessShader = new ShaderProgram();
-            postprocessShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
-            postprocessShader->attach(config.value<std::string>("postprocess", ""), GL_FRAGMENT_SHADER);
-            postprocessShader->link();
-
-            // Create a post processing material
-            postprocessMaterial = new TexturedMaterial();
-            postprocessMaterial->shader = postprocessShader;
-            postprocessMaterial->texture = colorTarget;
-            postprocessMaterial->sampler = postprocessSampler;
-            // The default options are fine but we don't need to interact with the depth buffer
-            // so it is more performant to disable the depth mask
-            postprocessMaterial->pipelineState.depthMask = false;
+        // Then we check if there are postprocessing effects in the configuration
+        // With dynamic resolution, the weighted blended transparency or the deferred shading, the scene is drawn to render targets,
+        // so the chain always has a pass (it copies or upscales the scene to the window)
+        bool offscreenScene = dynamicResolution.isEnabled() || weightedOIT || deferredShading;
+        if(config.contains("postprocess") || offscreenScene){
+            // The effects are fused into as few fullscreen passes as possible (see PostprocessChain)
+            // The render targets of the passes are created by the render graph when the frame is drawn
+            // (see the "scene" and "postprocess" passes in "draw"), so their textures are shared with any other transient target
+            // The color grades of the chain are baked into color lookup tables unless "postprocessLUT" is false
+            postprocessChain.initialize(config.value("postprocess", nlohmann::json::array()), config.value("postprocessLUT", true), offscreenScene);
         }
+        // Finish the links of the sky and the postprocess programs
+        ShaderProgram::finishPendingLinks();
     }
 
     void ForwardRenderer::destroy(){
+        // Delete the light cluster buffers and the frame data buffer
+        lightClusters.destroy();
+        frameData.destroy();
+        // Delete the merged meshes of the static batches
+        staticBatcher.destroy();
+        // Delete the fragment statistics queries
+        if(fragmentQueries[0][0]) glDeleteQueries(4, &fragmentQueries[0][0]);
+        occlusionCuller.destroy();
+        // Delete the render targets pooled by the render graph
+        renderGraph.destroy();
         // Delete all objects related to the sky
         if(skyMaterial){
             delete skySphere;
@@ -178,51 +172,72 @@ Parameters
             delete skyMaterial;
         }
         // Delete all objects related to post processing
-        if(postprocessMaterial){
-            glDeleteFramebuffers(1, &postprocessFrameBuffer);
-            glDeleteVertexArrays(1, &postProcessVertexArray);
-            delete colorTarget;
-            delete depthTarget;
-            delete postprocessMaterial->sampler;
-            delete postprocessMaterial->shader;
-            delete postprocessMaterial;
+        postprocessChain.destroy();
+        delete oitCompositeProgram;
+        oitCompositeProgram = nullptr;
+        if(oitVertexArray){
+            glDeleteVertexArrays(1, &oitVertexArray);
+            GLStateCache::onVertexArrayDeleted(oitVertexArray);
+            oitVertexArray = 0;
         }
+        dynamicResolution.destroy();
     }
 
-    void ForwardRenderer::render(World* world){
-        // First of all, we search for a camera and for all the mesh renderers
-        CameraComponent* camera = nullptr;
-        opaqueCommands.clear();
-        transparentCommands.clear();
-        lightSources.clear();
+    void ForwardRenderer::buildStaticBatches(World* world){
+        if(staticBatching) staticBatcher.build(world, staticBatchCellSize);
+        // The batched objects must be removed from the render list (and added back if the batching is disabled)
+        renderList.reset();
+    }
+
+    void ForwardRenderer::warmShaders(World* world){
+        // The lights and the camera are read the same way as the render list does
+        std::vector<LightClusters::Light> lights;
+        bool perspective = true;
         for(auto entity : world->getEntities()){
-            // If we hadn't found a camera yet, we look for a camera in this entity
-            if(!camera) camera = entity->getComponent<CameraComponent>();
-            // If this entity has a mesh renderer component
-            if(auto meshRenderer = entity->getComponent<MeshRendererComponent>(); meshRenderer){
-                // We construct a command from it
-                RenderCommand command;
-                command.localToWorld = meshRenderer->getOwner()->getLocalToWorldMatrix();
-                command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
-                command.mesh = meshRenderer->mesh;
-                command.material = meshRenderer->material;
-                // if it is transparent, we add it to the transparent commands list
-                if(command.material->transparent){
-                    transparentCommands.push_back(command);
-                } else {
-                // Otherwise, we add it to the opaque command list
-                    opaqueCommands.push_back(command);
-                }
-            }
-            // if light component store it
-            if (auto lightComp = entity->getComponent<LightComponent>(); lightComp)
-            {
-                lightSources.push_back(lightComp);
-            }
+            if(auto light = entity->getComponent<LightComponent>()) lights.push_back(LightClusters::Light::fromComponent(light));
+            if(auto camera = entity->getComponent<CameraComponent>()) perspective = camera->cameraType == CameraType::PERSPECTIVE;
         }
+        unsigned int types = 0;
+        size_t globalCount = 0;
+        lightClusters.classify(lights, perspective, types, globalCount);
+        warmLightPermutations(makeLightDefines(types, globalCount));
+    }
 
-        // If there is no camera, we return (we cannot render without a camera)
-        if(camera == nullptr) return;
+    void ForwardRenderer::warmLightPermutations(const std::vector<std::string>& defines){
+        MaterialTable::warmLightPermutations(defines);
+    }
+
+    void ForwardRenderer::render(World* world){
+        FrameSnapshot& snapshot = capture(world);
+        RenderThread::get().enqueue([this, &snapshot](){ draw(snapshot); });
+    }
+
+    FrameSnapshot& ForwardRenderer::capture(World* world){
+        // The snapshot that is reused was drawn two frames ago: the render thread is done with it since only one frame can be in flight
+        FrameSnapshot& snapshot = snapshots[nextSnapshot];
+        nextSnapshot = (nextSnapshot + 1) % 2;
+        if(snapshot.drawn) completedStatistics = snapshot.statistics;
+        snapshot.drawn = false;
+
+        // First of all, we update the render list which holds the camera, the lights and a command for every mesh renderer
+        // (only the entities that were added, changed or removed since the last frame are read)
+        renderList.update(world);
+        snapshot.renderListUpdates = renderList.getUpdatedCount();
+        // The batches whose entities were deleted are updated here since the entities must not be read by the render thread
+        // (the render thread only uploads the merged geometry)
+        staticBatcher.update(renderList.getRemoved());
+        staticBatcher.capture(snapshot.staticBatches);
+        snapshot.staticObjects = staticBatcher.getObjectCount();
+        const auto& items = renderList.getItems();
+        snapshot.commands.resize(items.size());
+        for(size_t i = 0; i < items.size(); i++) snapshot.commands[i] = items[i].command;
+        snapshot.lights.clear();
+        for(auto light : renderList.getLights()) snapshot.lights.push_back(LightClusters::Light::fromComponent(light));
+
+        // If there is no camera, we can't draw anything
+        CameraComponent* camera = renderList.getCamera();
+        snapshot.hasCamera = camera != nullptr;
+        if(camera == nullptr) return snapshot;
 
         //TODO: (Req 9) Modify the following line such that "cameraForward" contains a vector pointing the camera forward direction
         // HINT: See how you wrote the CameraComponent::getViewMatrix, it should help you solve this one
@@ -233,198 +248,518 @@ Parameters
         // as we get a vector direction from two points by subtract them
         // the forward direction of the camera by subtractiong the eye and the center
         // also notice that "w" of the vector has to be 0 , which is already done in the subtraction
-        glm::vec3 cameraForward = glm::normalize(center - eye);
-
-        std::sort(transparentCommands.begin(), transparentCommands.end(), [cameraForward](const RenderCommand& first, const RenderCommand& second){
-            //TODO: (Req 9) Finish this function
-            // HINT: the following return should return true "first" should be drawn before "second". 
-            // dot returns the dot product of two vectors
-            // if (glm::dot(cameraForward,first.center) > glm::dot(cameraForward,second.center)  )
-            //     return true;
-            // else
-            //     return false;
-
-            // if the center of the first is far than the second it have to drwa at the first
-            return (glm::dot(cameraForward,first.center) > glm::dot(cameraForward,second.center)  );
-        });
+        snapshot.eye = eye;
+        snapshot.cameraForward = glm::normalize(center - eye);
 
         //TODO: (Req 9) Get the camera ViewProjection matrix and store it in VP
         //we use the define functions in "camera", sending the windowSize to calculate the aspect ratio 
-        glm::mat4 P = camera->getProjectionMatrix(windowSize);
-        glm::mat4 V = camera->getViewMatrix();
-        glm::mat4 VP =  P*V ;
-
-        //TODO: (Req 9) Set the OpenGL viewport using viewportStart and viewportSize
-        //Specify the lower left corner of the viewport rectangle, in pixels , we set it to be (0,0)
-        //then the width in my current width of the "windowSize" (windowSize.x)
-        //same thing for y
-        glViewport(0, 0, windowSize.x, windowSize.y);
-
-        //TODO: (Req 9) Set the clear color to black and the clear depth to 1
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClearDepth(1.0);
+        snapshot.P = camera->getProjectionMatrix(windowSize);
+        snapshot.V = camera->getViewMatrix();
+        snapshot.near = camera->near;
+        snapshot.far = camera->far;
+        snapshot.fovY = camera->fovY;
+        snapshot.perspective = camera->cameraType == CameraType::PERSPECTIVE;
+        return snapshot;
+    }
 
-        //TODO: (Req 9) Set the color mask to true and the depth mask to true (to ensure the glClear will affect the framebuffer)
-        glColorMask(true, true, true, true);
-        glDepthMask(true); 
+    void ForwardRenderer::draw(FrameSnapshot& snapshot){
+        // Start counting the uniform lookups of this frame
+        ShaderProgram::resetDriverLookupCount();
+        // Read the occlusion queries of the previous frames that are ready
+        occlusionCuller.beginFrame();
+        // Upload the batches that changed and delete the removed ones (even if nothing is drawn)
+        staticBatcher.upload(snapshot.staticBatches);
+        statistics.renderListUpdates = snapshot.renderListUpdates;
 
-        // If there is a postprocess material, bind the framebuffer
-        if(postprocessMaterial){
-            //TODO: (Req 11) bind the framebuffer
-              glBindFramebuffer(GL_DRAW_FRAMEBUFFER, postprocessFrameBuffer);
-            
+        // If there is no camera, we return (we cannot render without a camera)
+        if(!snapshot.hasCamera) return;
+        const glm::vec3& eye = snapshot.eye;
+        const glm::vec3& cameraForward = snapshot.cameraForward;
+        const glm::mat4& P = snapshot.P;
+        const glm::mat4& V = snapshot.V;
+        glm::mat4 VP =  P*V ;
+        // Start timing the GPU work of the frame and pick the size at which the scene is drawn this frame
+        // (the aspect ratio doesn't change, so the projection matrix computed from the window size is still valid)
+        dynamicResolution.beginFrame();
+        glm::ivec2 renderSize = dynamicResolution.getRenderSize(windowSize);
+
+        // Fill the render queue: the opaque commands are grouped by state then sorted front to back
+        // while the transparent commands are sorted back to front (their depth is the distance along the camera forward direction)
+        // The commands whose bounding boxes are outside the camera frustum are skipped
+        Frustum frustum = Frustum::fromMatrix(VP);
+        statistics.culledObjects = statistics.staticBatches = 0;
+        renderQueue.clear();
+        // This only reads the command & the shared settings, so it can be called from any thread
+        auto getPass = [&](const RenderCommand& command){
+            RenderPass pass = command.material->transparent ? RenderPass::TRANSPARENT_PASS : RenderPass::OPAQUE_PASS;
+            // With the deferred shading, the lit opaque objects are drawn to the G-buffer (before any other pass)
+            if(pass == RenderPass::OPAQUE_PASS && deferredShading && MaterialTable::get(command.material->getTableIndex()).lit) return RenderPass::DEFERRED_PASS;
+            if(pass == RenderPass::OPAQUE_PASS && occlusionCuller.shouldTest(command.mesh)) pass = RenderPass::OCCLUSION_TESTED_PASS;
+            if(pass == RenderPass::OPAQUE_PASS && depthPrepass && usesDepthPrepass(command.material)) pass = RenderPass::PREPASSED_OPAQUE_PASS;
+            return pass;
+        };
+        auto pushCommand = [&](const RenderCommand& command){
+            float depth = glm::dot(cameraForward, command.center - eye);
+            renderQueue.push(command, getPass(command), depth, snapshot.near, snapshot.far);
+        };
+
+        // Cull the commands of the render list in parallel (each chunk only writes its own results)
+        JobSystem& jobs = JobSystem::get();
+        const auto& commands = snapshot.commands;
+        size_t chunkCount = JobSystem::getChunkCount(commands.size(), COMMAND_CHUNK_SIZE);
+        visibleChunks.resize(chunkCount);
+        chunkCulledCounts.resize(chunkCount);
+        chunkSlots.resize(chunkCount);
+        jobs.parallelFor(commands.size(), COMMAND_CHUNK_SIZE, [&](size_t begin, size_t end){
+            size_t chunk = begin / COMMAND_CHUNK_SIZE;
+            auto& visible = visibleChunks[chunk];
+            visible.clear();
+            chunkCulledCounts[chunk] = 0;
+            for(size_t i = begin; i < end; i++){
+                const RenderCommand& command = commands[i];
+                BoundingBox bounds = command.mesh->getBounds().transformed(command.localToWorld);
+                if(!frustum.intersects(bounds)) chunkCulledCounts[chunk]++;
+                // The command is copied since its mesh may be replaced by a level of detail for this frame only
+                else visible.push_back({command, bounds});
+            }
+        });
+        // The visible objects are drawn using the level of detail that fits their size on the screen.
+        // The selector remembers the level of each object so this part runs on the drawing thread
+        // (only for the meshes that have simplified levels, the others keep their mesh anyway)
+        lodSelector.beginFrame(eye, snapshot.fovY, snapshot.perspective);
+        size_t visibleCount = 0;
+        for(size_t chunk = 0; chunk < chunkCount; chunk++){
+            statistics.culledObjects += chunkCulledCounts[chunk];
+            chunkSlots[chunk] = visibleCount;
+            visibleCount += visibleChunks[chunk].size();
+            for(auto& visible : visibleChunks[chunk]){
+                if(visible.command.mesh->getLodCount() > 1)
+                    visible.command.mesh = lodSelector.select(visible.command.id, visible.command.mesh, visible.bounds);
+            }
         }
-
-        //TODO: (Req 9) Clear the color and depth buffers
-        // by this we clear both color and depth 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        //TODO: (Req 9) Draw all the opaque commands
-        // Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
-        
-        
-
-         for (auto command : opaqueCommands)
-        {
-             command.material->setup();
-            // if the material of the object is lighted
-            if (auto light_material = dynamic_cast<LitMaterial *>(command.material); light_material)
-            {
-                // set sky lights to values
-            glm::vec3 sky_top = glm::vec3(0.01f, 0.01f, 0.01f);
-            glm::vec3 sky_middle = glm::vec3(0.01f, 0.01f, 0.01f);
-            glm::vec3 sky_bottom = glm::vec3(0.01f, 0.01f, 0.01f);
-                // set VP to VP matrix
-                light_material->shader->set("VP", VP);
-                // set M to command.localToWorld
-                light_material->shader->set("M", command.localToWorld);
-                // set eye to eye
-                light_material->shader->set("eye", eye);
-                // set M_IT to inverse(command.localToWorld)
-                light_material->shader->set("M_IT", glm::transpose(glm::inverse(command.localToWorld)));
-                // set light_count to size of lightSources
-                light_material->shader->set("light_count", (int)lightSources.size());
-                
-                // send sky lights to shader
-            light_material->shader->set("sky.top", sky_top);
-            light_material->shader->set("sky.middle", sky_middle);
-            light_material->shader->set("sky.bottom", sky_bottom);
-                
-                // for loop for all light sources
-                for (int i = 0; i < (int)lightSources.size(); i++)
+        statistics.lodReduced = lodSelector.getReducedCount();
+        // Then compute the sort keys of the visible commands in parallel, each chunk fills the queue slots that follow the chunks before it
+        size_t firstSlot = renderQueue.append(visibleCount);
+        jobs.parallelFor(chunkCount, 1, [&](size_t begin, size_t end){
+            for(size_t chunk = begin; chunk < end; chunk++){
+                size_t slot = firstSlot + chunkSlots[chunk];
+                for(const auto& visible : visibleChunks[chunk]){
+                    const RenderCommand& command = visible.command;
+                    float depth = glm::dot(cameraForward, command.center - eye);
+                    renderQueue.set(slot++, command, getPass(command), depth, snapshot.near, snapshot.far);
+                }
+            }
+        });
+        // The static batches are drawn like any other object (their vertices are already in the world space)
+        for(const auto& batch : snapshot.staticBatches){
+            if(!frustum.intersects(batch.bounds)){
+                statistics.culledObjects++;
+                continue;
+            }
+            RenderCommand command;
+            command.localToWorld = glm::mat4(1.0f);
+            command.center = batch.bounds.getCenter();
+            command.mesh = batch.mesh;
+            command.material = batch.material;
+            command.tint = glm::vec4(1.0f);
+            command.id = batch.mesh;
+            pushCommand(command);
+            statistics.staticBatches++;
+        }
+        statistics.staticObjects = snapshot.staticObjects;
+        renderQueue.sort();
+
+        // Assign the lights to the clusters of this camera and bind the cluster buffers once for the whole frame
+        lightClusters.update(snapshot.lights, V, P, snapshot.near, snapshot.far, snapshot.perspective, renderSize);
+        lightClusters.bind();
+        statistics.lightCount = lightClusters.getLightCount();
+        statistics.clusterLightReferences = lightClusters.getLightReferenceCount();
+        // The lit shaders are specialized for the types of the lights in the scene and the number of global lights
+        // (the combination of the scene is compiled at load by "warmShaders", a new one is linked while the generic shaders are used)
+        MaterialTable::setLightDefines(makeLightDefines(lightClusters.getLightTypes(), lightClusters.getGlobalLightCount()));
+
+        // Stream the data of the frame: the frame block, the instance data & the object block of every command (in the sorted order)
+        // The commands are written in parallel directly to the buffer (or to its copy in the RAM which is uploaded in one call)
+        size_t commandCount = renderQueue.size();
+        size_t instanceOffset = alignUp(sizeof(FrameBlock), uniformAlignment);
+        size_t objectOffset = alignUp(instanceOffset + commandCount * sizeof(InstanceData), uniformAlignment);
+        std::uint8_t* data = frameData.begin(objectOffset + commandCount * objectBlockStride);
+        *(FrameBlock*)data = FrameBlock{VP, glm::vec4(eye, 1.0f)};
+        jobs.parallelFor(commandCount, COMMAND_CHUNK_SIZE, [&](size_t begin, size_t end){
+            for(size_t i = begin; i < end; i++){
+                const RenderCommand& command = renderQueue[i];
+                *(InstanceData*)(data + instanceOffset + i * sizeof(InstanceData)) = InstanceData{
+                    command.localToWorld, command.tint, command.material->getTextureLayer()
+                };
+                *(ObjectBlock*)(data + objectOffset + i * objectBlockStride) = ObjectBlock{
+                    VP * command.localToWorld, command.localToWorld, glm::transpose(glm::inverse(command.localToWorld))
+                };
+            }
+        });
+        frameData.end();
+        statistics.streamedBytes = frameData.getFrameSize();
+        statistics.persistentMapping = frameData.isPersistent();
+        GLuint frameBuffer = frameData.getBuffer();
+        GLintptr frameOffset = frameData.getOffset();
+        // The frame block is the same for every draw, so it is bound once
+        glBindBufferRange(GL_UNIFORM_BUFFER, ShaderProgram::FRAME_BLOCK_BINDING, frameBuffer, frameOffset, sizeof(FrameBlock));
+
+        // The materials are drawn from their compiled copies in the material table (see MaterialTable), so the draw loop only reads plain data.
+        // The index of the material that was set up last (and whether it was set up for instancing) and the id of the last pipeline state.
+        // A command using the same material doesn't need to set it up again and a command using a different material
+        // only applies the pipeline state if it changed (the texture bindings that don't change are skipped by the GLStateCache)
+        std::uint32_t previousMaterial = MaterialTable::INVALID_INDEX;
+        std::uint32_t previousPipelineState = MaterialTable::INVALID_INDEX;
+        bool previousInstanced = false;
+        // The program that was used last. The uniforms that are the same for the whole frame only need to be sent when the program changes
+        ShaderProgram* previousProgram = nullptr;
+        auto setupMaterial = [&](std::uint32_t materialIndex, bool instanced){
+            if(materialIndex == previousMaterial && instanced == previousInstanced) return;
+            const CompiledMaterial& material = MaterialTable::get(materialIndex);
+            if(material.pipelineStateId != previousPipelineState){
+                MaterialTable::getPipelineState(material.pipelineStateId).setup();
+                previousPipelineState = material.pipelineStateId;
+            }
+            for(int unit = 0; unit < material.textureCount; unit++){
+                GLStateCache::bindTexture((GLuint)unit, material.textures[unit].target, material.textures[unit].texture);
+                GLStateCache::bindSampler((GLuint)unit, material.textures[unit].sampler);
+            }
+            // The uniforms of the material are already on the GPU, only the range of its block is bound
+            MaterialTable::bindBlock(materialIndex);
+            previousMaterial = materialIndex;
+            previousInstanced = instanced;
+            statistics.materialSetups++;
+        };
+        statistics.drawCalls = statistics.instancedDrawCalls = statistics.multiDrawCalls = statistics.materialSetups = 0;
+        statistics.prepassDrawCalls = 0;
+        // Draws the commands of the given pass starting from "index" (the commands of a pass are consecutive in the sorted queue)
+        // If "depthOnly" is true, the commands are drawn using the depth variants of their shaders without writing any color
+        size_t index = 0;
+        auto drawPass = [&](RenderPass pass, bool depthOnly){
+            while(index < renderQueue.size() && renderQueue.getPass(index) == pass){
+                const RenderCommand& command = renderQueue[index];
+                // If the shader has an instanced variant, all the following commands with the same mesh and material batch
+                // (which are next to each other after sorting) can be drawn using a single instanced draw call
+                // (the materials of a batch only differ by the layer of their textures which is sent with each instance)
+                bool hasInstancedVariant = command.material->shader->getInstancedVariant() != nullptr;
+                size_t instancedCount = 1;
+                if(hasInstancedVariant){
+                    while(index + instancedCount < renderQueue.size() && renderQueue.getPass(index + instancedCount) == pass &&
+                        renderQueue[index + instancedCount].mesh == command.mesh &&
+                        renderQueue[index + instancedCount].material->getBatchId() == command.material->getBatchId())
+                        instancedCount++;
+                }
+                // The following commands with the same material and the same model matrix need the same uniforms,
+                // so their meshes (which all live in the mesh arena) can be drawn using a single multi-draw call
+                // (this is the case of the static batches which all use the identity matrix)
+                size_t multiDrawCount = 1;
+                while(index + multiDrawCount < renderQueue.size() && renderQueue.getPass(index + multiDrawCount) == pass &&
+                    renderQueue[index + multiDrawCount].material == command.material && renderQueue[index + multiDrawCount].localToWorld == command.localToWorld)
+                    multiDrawCount++;
+                // Instancing is preferred unless the commands can only be merged using a multi-draw
+                bool instanced = hasInstancedVariant && (instancedCount > 1 || multiDrawCount == 1);
+                size_t count = instanced ? instancedCount : multiDrawCount;
+                // The objects tested for occlusion are drawn one by one since each of them has its own query
+                bool occlusionTested = pass == RenderPass::OCCLUSION_TESTED_PASS;
+                if(occlusionTested){
+                    count = 1;
+                    // If the object was occluded, its bounding box is drawn first (which changes the program and the pipeline state)
+                    if(occlusionCuller.prepare(command.id, command.mesh->getBounds().transformed(command.localToWorld), VP, eye)){
+                        previousMaterial = previousPipelineState = MaterialTable::INVALID_INDEX;
+                        previousProgram = nullptr;
+                    }
+                }
+                std::uint32_t materialIndex = command.material->getTableIndex();
+                const CompiledMaterial& material = MaterialTable::get(materialIndex);
+                // With the weighted blended transparency, the transparent objects use the permutation that writes to the accumulation targets
+                // and the objects of the deferred pass use the permutation that writes to the G-buffer
+                bool oit = weightedOIT && pass == RenderPass::TRANSPARENT_PASS;
+                ProgramVariant variant = oit ? ProgramVariant::WEIGHTED_OIT :
+                    pass == RenderPass::DEFERRED_PASS ? ProgramVariant::GBUFFER : ProgramVariant::FORWARD;
+                ShaderProgram* program = MaterialTable::getProgram(materialIndex, instanced, variant);
+                if(depthOnly){
+                    // Only the pipeline state of the material is needed (the depth variant doesn't read the textures nor the tint)
+                    // The depth variants belong to the shader of the material since the permutations don't change the positions
+                    ShaderProgram* shader = command.material->shader;
+                    program = (instanced ? shader->getInstancedVariant() : shader)->getDepthVariant();
+                    MaterialTable::getPipelineState(material.pipelineStateId).setup();
+                    GLStateCache::colorMask(glm::bvec4(false));
+                    statistics.prepassDrawCalls++;
+                } else {
+                    setupMaterial(materialIndex, instanced);
+                    // The depth of the pre-passed objects is already in the depth buffer, so only the visible fragments pass
+                    if(pass == RenderPass::PREPASSED_OPAQUE_PASS){
+                        GLStateCache::depthFunc(GL_EQUAL);
+                        GLStateCache::depthMask(false);
+                    }
+                    // The accumulation needs additive blending for the colors & weights and multiplicative blending for the revealage
+                    // (whatever the blending of the material is), and the transparent objects must not hide each other
+                    if(oit){
+                        GLStateCache::setEnabled(GL_BLEND, true);
+                        GLStateCache::blendEquation(GL_FUNC_ADD);
+                        GLStateCache::blendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+                        GLStateCache::depthMask(false);
+                    }
+                }
+                bool programChanged = program != previousProgram;
+                previousProgram = program;
+                if(programChanged){
+                    program->use();
+                    // Each texture of a material is always bound to the same unit, so the units are only sent when the program changes
+                    if(!depthOnly){
+                        for(int unit = 0; unit < material.textureCount; unit++) program->set(*material.textures[unit].uniform, unit);
+                    }
+                }
+                // if the material of the object is lighted
+                if (material.lit)
                 {
-                    if(lightSources[i]->type >=0){
-
-                    // calculate position and direction of the light source based on the object
-                    glm::vec3 position = lightSources[i]->getOwner()->getLocalToWorldMatrix()*glm::vec4(0,0,0,1);
-                    glm::vec3 direction = lightSources[i]->getOwner()->getLocalToWorldMatrix()*glm::vec4(0,-1,0,0);
-                    
-                    // set light material
-                    // set direction
-                    light_material->shader->set("lights[" + std::to_string(i) + "].direction",direction);
-                    // set color
-                    light_material->shader->set("lights[" + std::to_string(i) + "].color",lightSources[i]->color);
-                    // set type
-                    light_material->shader->set("lights[" + std::to_string(i) + "].type", lightSources[i]->type);
-                    // set position
-                    light_material->shader->set("lights[" + std::to_string(i) + "].position", position); 
-                    // set diffuse
-                    light_material->shader->set("lights[" + std::to_string(i) + "].diffuse", lightSources[i]->diffuse);
-                    // set specular
-                    light_material->shader->set("lights[" + std::to_string(i) + "].specular", lightSources[i]->specular);
-                    // set attenuation
-                    light_material->shader->set("lights[" + std::to_string(i) + "].attenuation", lightSources[i]->attenuation);
-                    // set cone angles
-                    light_material->shader->set("lights[" + std::to_string(i) + "].coneAngles", lightSources[i]->coneAngles);
-                    
-                }}
+                    if(programChanged){
+                        // VP and eye are read from the frame block
+                        // send the light clusters (the lights are read from the cluster buffers in the shader)
+                        lightClusters.setUniforms(program);
+                        // send sky lights to shader
+                        program->set(skyTopUniform, skyLight.top);
+                        program->set(skyMiddleUniform, skyLight.middle);
+                        program->set(skyBottomUniform, skyLight.bottom);
+                    }
+                    // the instanced variant reads the model matrix from the instance data
+                    // while the other draws read M and M_IT from the object block of the command
+                    if(!instanced){
+                        glBindBufferRange(GL_UNIFORM_BUFFER, ShaderProgram::OBJECT_BLOCK_BINDING, frameBuffer,
+                            frameOffset + (GLintptr)(objectOffset + index * objectBlockStride), sizeof(ObjectBlock));
+                    }
+                }
+                // if the material of the isn't lighted, the instanced variant multiplies the model matrix of the instance
+                // by VP (read from the frame block)
+                else if(!instanced)
+                    //set the "transform" uniform to be equal the model-view-projection matrix
+                    program->set(transformUniform, VP * command.localToWorld);
+
+                if(occlusionTested) occlusionCuller.beginDraw(command.id);
+                if(instanced){
+                    command.mesh->drawInstanced(frameBuffer, frameOffset + (GLintptr)(instanceOffset + index * sizeof(InstanceData)), (GLsizei)count);
+                    statistics.instancedDrawCalls++;
+                } else if(count > 1){
+                    for(size_t i = index; i < index + count; i++) multiDraw.add(renderQueue[i].mesh->getAllocation());
+                    multiDraw.submit();
+                    statistics.multiDrawCalls++;
+                } else {
+                    command.mesh->draw();
+                }
+                if(occlusionTested) occlusionCuller.endDraw(command.id);
+                statistics.drawCalls++;
+                index += count;
             }
-            
-            // if the material of the isn't lighted
-            else
-                //set the "transform" uniform to be equal the model-view-projection matrix
-                command.material->shader->set("transform", VP * command.localToWorld);
-                        
-            command.mesh->draw();
+        };
+
+        // The passes of the frame are declared in the render graph which assigns their targets and runs them in order.
+        // Without postprocess effects, the scene is drawn directly to the back buffer. Otherwise, it is drawn to transient
+        // color & depth targets (taken from the pool of the render graph) then the postprocess passes read the color target
+        renderGraph.reset();
+        RenderGraph::Resource backbuffer = renderGraph.importBackbuffer(windowSize);
+        std::vector<RenderGraph::Resource> sceneTargets = {backbuffer};
+        RenderGraph::Resource sceneColor = backbuffer, sceneDepth = RenderGraph::INVALID_RESOURCE;
+        if(postprocessChain.isEnabled()){
+            //TODO: (Req 11) Create a color and a depth texture and attach them to the framebuffer
+            // Hints: The color format can be (Red, Green, Blue and Alpha components with 8 bits for each channel).
+            // The depth format can be (Depth component with 24 bits).
+            // With dynamic resolution, they are smaller than the window and the first postprocess pass upscales the scene color
+            sceneColor = renderGraph.createTarget("scene color", {GL_RGBA8, renderSize});
+            sceneDepth = renderGraph.createTarget("scene depth", {GL_DEPTH_COMPONENT24, renderSize});
+            sceneTargets = {sceneColor, sceneDepth};
         }
+        // The deferred renderer declares the passes that draw the lit opaque objects to its G-buffer and shade them to the scene targets
+        if(deferredShading && sceneDepth != RenderGraph::INVALID_RESOURCE){
+            addDeferredPasses(renderGraph, {sceneColor, sceneDepth, renderSize, VP, &lightClusters, [&](){
+                previousMaterial = previousPipelineState = MaterialTable::INVALID_INDEX;
+                previousProgram = nullptr;
+                index = 0;
+                drawPass(RenderPass::DEFERRED_PASS, false);
+            }});
+        }
+        renderGraph.addPass("scene", {}, sceneTargets, [&](const RenderGraph::PassContext&){
+            //TODO: (Req 9) Set the OpenGL viewport using viewportStart and viewportSize
+            //Specify the lower left corner of the viewport rectangle, in pixels , we set it to be (0,0)
+            //then the width in my current width of the "windowSize" (windowSize.x)
+            //same thing for y
+            // (with dynamic resolution, the scene is drawn at "renderSize" which is smaller than the window)
+            glViewport(0, 0, renderSize.x, renderSize.y);
+
+            //TODO: (Req 9) Set the clear color to black and the clear depth to 1
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClearDepth(1.0);
+
+            //TODO: (Req 9) Set the color mask to true and the depth mask to true (to ensure the glClear will affect the framebuffer)
+            GLStateCache::colorMask(glm::bvec4(true));
+            GLStateCache::depthMask(true);
+
+            // The framebuffer of the pass (the postprocess color & depth targets or the back buffer) was bound by the render graph
+
+            //TODO: (Req 9) Clear the color and depth buffers
+            // by this we clear both color and depth 
+            // (with the deferred shading, they already hold the lit objects, so the other objects are drawn over them)
+            if(!deferredShading) glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            //TODO: (Req 9) Draw all the opaque commands
+            // Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
+            // The queries of this frame use the set that was requested two frames ago, so its results are read first (without waiting for them)
+            bool countFragments = fragmentQueries[0][0] != 0;
+            GLuint* queries = fragmentQueries[frameIndex % 2];
+            if(countFragments && fragmentQueriesPending[frameIndex % 2]){
+                GLuint available = 0;
+                glGetQueryObjectuiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+                if(available){
+                    GLuint64 prepass = 0, prepassed = 0;
+                    glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &prepass);
+                    glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &prepassed);
+                    statistics.fragmentStatisticsAvailable = true;
+                    statistics.prepassFragmentInvocations = prepass;
+                    statistics.prepassedFragmentInvocations = prepassed;
+                    statistics.savedFragmentInvocations = prepass > prepassed ? prepass - prepassed : 0;
+                }
+            }
 
+            // The commands of the deferred pass are the first ones in the queue and they were already drawn to the G-buffer
+            size_t opaqueStart = 0;
+            while(opaqueStart < renderQueue.size() && renderQueue.getPass(opaqueStart) == RenderPass::DEFERRED_PASS) opaqueStart++;
+            // First, the depth pre-pass writes the depth of the pre-passed objects (they are the last opaque commands in the queue)
+            size_t prepassStart = opaqueStart;
+            while(prepassStart < renderQueue.size() && renderQueue.getPass(prepassStart) == RenderPass::OPAQUE_PASS) prepassStart++;
+            if(countFragments) glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, queries[0]);
+            index = prepassStart;
+            drawPass(RenderPass::PREPASSED_OPAQUE_PASS, true);
+            if(countFragments) glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+            // The next material setup must apply its whole pipeline state (to restore the color mask)
+            previousMaterial = previousPipelineState = MaterialTable::INVALID_INDEX;
+            previousProgram = nullptr;
+            index = opaqueStart;
+
+            drawPass(RenderPass::OPAQUE_PASS, false);
+            // Then the pre-passed objects are shaded (the fragments hidden by any opaque object fail the GL_EQUAL test)
+            if(countFragments) glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, queries[1]);
+            drawPass(RenderPass::PREPASSED_OPAQUE_PASS, false);
+            if(countFragments){
+                glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+                fragmentQueriesPending[frameIndex % 2] = true;
+            }
+            frameIndex++;
+            // The depth function and mask were changed without the material knowing, so the next material must apply its whole pipeline state
+            previousMaterial = previousPipelineState = MaterialTable::INVALID_INDEX;
+            // Finally, the expensive objects are tested for occlusion against all the other opaque objects
+            drawPass(RenderPass::OCCLUSION_TESTED_PASS, false);
+            statistics.occlusionTested = occlusionCuller.getTestedCount();
+            statistics.occlusionConditional = occlusionCuller.getConditionalCount();
+
+            // If there is a sky material, draw the sky
+            if(this->skyMaterial){
+                //TODO: (Req 10) setup the sky material
+                // The sky material is not in the material table, so it is set up directly and the next material must apply its whole state
+                this->skyMaterial->setup();
+                previousMaterial = previousPipelineState = MaterialTable::INVALID_INDEX;
+                previousProgram = this->skyMaterial->shader;
+
+                //TODO: (Req 10) Get the camera position
+                // we already have got it above in variable called eye
+                glm::vec3 camPosition = eye;
+
+                //TODO: (Req 10) Create a model matrix for the sy such that it always follows the camera (sky sphere center = camera position)
+                our::Transform skyTransform;
+                skyTransform.position = camPosition;
+                glm::mat4 skyModel = skyTransform.toMat4();
+
+                //TODO: (Req 10) We want the sky to be drawn behind everything (in NDC space, z=1)
+                // We can acheive the is by multiplying by an extra matrix after the projection but what values should we put in it?
+                glm::mat4 alwaysBehindTransform = glm::mat4(
+                    // row 1
+                    1.0f, 0.0f, 0.0f, 0.0f, // column 1
+                    0.0f, 1.0f, 0.0f, 0.0f,
+                    0.0f, 0.0f, 0.0f, 0.0f,
+                    0.0f, 0.0f, 1.0f, 1.0f
+                );
+               //col1
+        //row1  // 1   0   0   0   x        x     x/w
+                // 0   1   0   0   y        y     y/w
+                // 0   0   0   1   z    =   w  =   1     <= z=1 
+                // 0   0   0   1   w        w      1
+
+                //TODO: (Req 10) set the "transform" uniform
+                //we use alwaysBehindTransform above to ensure that the sky is behind everything  (have the largest normalized depth)
+                //we multiply it at the last stage after multiplying it with V & P & M
+                skyMaterial->shader->set(transformUniform, alwaysBehindTransform * VP * skyModel);
+
+                //TODO: (Req 10) draw the sky sphere
+                skySphere->draw();
+            }
+            //TODO: (Req 9) Draw all the transparent commands
+            // Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
+            // They use the same render queue, so they are already sorted from back to front
+            // (with the weighted blended transparency, they are drawn by the "transparent accumulation" pass instead)
+            if(!weightedOIT) drawPass(RenderPass::TRANSPARENT_PASS, false);
+        });
 
-        // If there is a sky material, draw the sky
-        if(this->skyMaterial){
-            //TODO: (Req 10) setup the sky material
-            this->skyMaterial->setup();
-
-            //TODO: (Req 10) Get the camera position
-            // we already have got it above in variable called eye
-            glm::vec3 camPosition = eye;
-
-            //TODO: (Req 10) Create a model matrix for the sy such that it always follows the camera (sky sphere center = camera position)
-            our::Transform skyTransform;
-            skyTransform.position = camPosition;
-            glm::mat4 skyModel = skyTransform.toMat4();
-
-            //TODO: (Req 10) We want the sky to be drawn behind everything (in NDC space, z=1)
-            // We can acheive the is by multiplying by an extra matrix after the projection but what values should we put in it?
-            glm::mat4 alwaysBehindTransform = glm::mat4(
-                // row 1
-                1.0f, 0.0f, 0.0f, 0.0f, // column 1
-                0.0f, 1.0f, 0.0f, 0.0f,
-                0.0f, 0.0f, 0.0f, 0.0f,
-                0.0f, 0.0f, 1.0f, 1.0f
-            );
-           //col1
-    //row1  // 1   0   0   0   x        x     x/w
-            // 0   1   0   0   y        y     y/w
-            // 0   0   0   1   z    =   w  =   1     <= z=1 
-            // 0   0   0   1   w        w      1
-
-            //TODO: (Req 10) set the "transform" uniform
-            //we use alwaysBehindTransform above to ensure that the sky is behind everything  (have the largest normalized depth)
-            //we multiply it at the last stage after multiplying it with V & P & M
-            skyMaterial->shader->set("transform", alwaysBehindTransform * VP * skyModel);
-
-            //TODO: (Req 10) draw the sky sphere
-            skySphere->draw();
-        }
-        //TODO: (Req 9) Draw all the transparent commands
-        // Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
-        for (auto command : transparentCommands)
-        {
-            command.material->setup();
-            //same concept as opaqueCommands loop
-            command.material->shader->set("transform", VP * command.localToWorld);
-            command.mesh->draw();
+        // The transparent commands are the last ones in the queue, so there are some if the last command is transparent
+        bool hasTransparent = renderQueue.size() > 0 && renderQueue.getPass(renderQueue.size() - 1) == RenderPass::TRANSPARENT_PASS;
+        if(weightedOIT && hasTransparent && sceneDepth != RenderGraph::INVALID_RESOURCE){
+            // The transparent objects are tested against the depth of the scene (without writing it) and accumulated in two targets:
+            // the weighted colors with the revealage in the alpha and the weights (see "weighted-oit.glsl")
+            RenderGraph::Resource accumulation = renderGraph.createTarget("transparent accumulation", {GL_RGBA16F, renderSize});
+            RenderGraph::Resource weight = renderGraph.createTarget("transparent weight", {GL_R16F, renderSize});
+            renderGraph.addPass("transparent accumulation", {}, {accumulation, weight, sceneDepth}, [&](const RenderGraph::PassContext&){
+                // No transparent fragment yet: the sums are zero and the whole scene is revealed
+                GLStateCache::colorMask(glm::bvec4(true));
+                const GLfloat clearAccumulation[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+                const GLfloat clearWeight[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+                glClearBufferfv(GL_COLOR, 1, clearWeight);
+                previousMaterial = previousPipelineState = MaterialTable::INVALID_INDEX;
+                drawPass(RenderPass::TRANSPARENT_PASS, false);
+            });
+            renderGraph.addPass("transparent composite", {accumulation, weight}, {sceneColor}, [&, accumulation, weight](const RenderGraph::PassContext& pass){
+                oitCompositeState.setup();
+                oitCompositeProgram->use();
+                GLStateCache::bindTexture(0, GL_TEXTURE_2D, pass.getTexture(accumulation)->getOpenGLName());
+                GLStateCache::bindSampler(0, 0);
+                GLStateCache::bindTexture(1, GL_TEXTURE_2D, pass.getTexture(weight)->getOpenGLName());
+                GLStateCache::bindSampler(1, 0);
+                oitCompositeProgram->set(accumulationTexUniform, 0);
+                oitCompositeProgram->set(weightTexUniform, 1);
+                GLStateCache::bindVertexArray(oitVertexArray);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            });
         }
 
-        // If there is a postprocess material, apply postprocessing
-        if(postprocessMaterial){
-            //TODO: (Req 11) Return to the default framebuffer
-             glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-            //TODO: (Req 11) Setup the postprocess material and draw the fullscreen triangle
-            postprocessMaterial->setup();
-            glBindVertexArray(this->postProcessVertexArray);
-            /*
-Name
-  glDrawArrays — render primitives from array data
-
-C Specification
-    void glDrawArrays(	GLenum mode,
-        GLint first,
-        GLsizei count);
- 
-Parameters
-        1-mode : Specifies what kind of primitives to render. Symbolic constants GL_POINTS, GL_LINE_STRIP, GL_LINE_LOOP, GL_LINES, GL_LINE_STRIP_ADJACENCY, GL_LINES_ADJACENCY, GL_TRIANGLE_STRIP, GL_TRIANGLE_FAN, GL_TRIANGLES, GL_TRIANGLE_STRIP_ADJACENCY, GL_TRIANGLES_ADJACENCY and GL_PATCHES are accepted.
-
-        2-first : Specifies the starting index in the enabled arrays.
-
-        3-count : Specifies the number of indices to be rendered.
-            */
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-            
-        }
+        // If there are postprocess effects, apply postprocessing
+        //TODO: (Req 11) Return to the default framebuffer
+        // (the render graph binds the default framebuffer for the last pass of the chain since it writes to the back buffer)
+        //TODO: (Req 11) Setup the postprocess material and draw the fullscreen triangle
+        // Each pass of the chain reads the scene color (or the result of the previous pass) from the texture that the render graph assigned to it
+        if(postprocessChain.isEnabled()) postprocessChain.addPasses(renderGraph, sceneColor, backbuffer, windowSize);
+        renderGraph.execute();
+        dynamicResolution.endFrame();
+        statistics.renderScale = dynamicResolution.isEnabled() ? dynamicResolution.getScale() : 1.0f;
+        statistics.gpuFrameTime = dynamicResolution.getSmoothedFrameTime();
+        statistics.deferredShading = deferredShading;
+        statistics.renderGraphPasses = renderGraph.getExecutedPassCount();
+        statistics.culledRenderGraphPasses = renderGraph.getCulledPassCount();
+        statistics.pooledRenderTargets = renderGraph.getPooledTargetCount();
+        statistics.aliasedRenderTargets = renderGraph.getAliasedTargetCount();
+        statistics.postprocessEffects = postprocessChain.getEffectCount();
+        statistics.postprocessPasses = postprocessChain.getStages().size();
+        statistics.postprocessLUTs = postprocessChain.getLUTCount();
         // if  there is a light material apply it
         if (lightMaterial)
             lightMaterial->setup();
+
+        // Any lookup that still reached the driver this frame is reported in the statistics
+        statistics.uniformDriverLookups = ShaderProgram::getDriverLookupCount();
+        // Protect the region of the frame data until the GPU is done with the draws of this frame
+        frameData.fence();
+        // The GL calls sent to the driver and the ones skipped by the state cache during this frame
+        statistics.glCallsIssued = GLStateCache::getCounters().issued;
+        statistics.glCallsElided = GLStateCache::getCounters().elided;
+        // The statistics are published once the main thread reuses the snapshot (it is done with the frame by then)
+        snapshot.statistics = statistics;
+        snapshot.drawn = true;
     }
 
 }
\ No newline at end of file
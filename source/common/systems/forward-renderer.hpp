@@ -5,21 +5,99 @@
 #include "../components/mesh-renderer.hpp"
 #include "../asset-loader.hpp"
 #include "../components/light.hpp"
+#include "light-clusters.hpp"
+#include "render-queue.hpp"
+#include "render-list.hpp"
+#include "static-batcher.hpp"
+#include "frustum.hpp"
+#include "occlusion-culler.hpp"
+#include "lod-selector.hpp"
+#include "../stream-buffer.hpp"
+#include "render-graph.hpp"
+#include "postprocess-chain.hpp"
+#include "dynamic-resolution.hpp"
 #include <glad/gl.h>
 #include <vector>
 #include <algorithm>
+#include <functional>
 
 namespace our
 {
     
-    // The render command stores command that tells the renderer that it should draw
-    // the given mesh at the given localToWorld matrix using the given material
-    // The renderer will fill this struct using the mesh renderer components
-    struct RenderCommand {
-        glm::mat4 localToWorld;
-        glm::vec3 center;
-        Mesh* mesh;
-        Material* material;
+    // Counters collected while rendering the last frame
+    // The play state can display them in a small overlay (enable it using "statistics": true in the renderer config)
+    struct RenderStatistics {
+        // The number of uniform locations that still had to be queried from the driver by name
+        std::size_t uniformDriverLookups = 0;
+        // The number of lights sent to the lit shaders and the number of light indices stored in all the clusters
+        std::size_t lightCount = 0;
+        std::size_t clusterLightReferences = 0;
+        // The number of draw calls (and how many of them are instanced or multi-draws) and the number of times a material had to be set up
+        std::size_t drawCalls = 0;
+        std::size_t instancedDrawCalls = 0;
+        std::size_t multiDrawCalls = 0;
+        std::size_t materialSetups = 0;
+        // The number of static batches drawn, the number of objects merged into all the batches
+        // and the number of objects & batches skipped since they were outside the camera frustum
+        std::size_t staticBatches = 0;
+        std::size_t staticObjects = 0;
+        std::size_t culledObjects = 0;
+        // The number of render commands created or recomputed since the last frame (the others were kept from the previous frames)
+        std::size_t renderListUpdates = 0;
+        // The number of objects drawn using a simplified level of detail
+        std::size_t lodReduced = 0;
+        // The number of expensive objects tested for occlusion and the number of them drawn conditionally (since they were occluded)
+        std::size_t occlusionTested = 0;
+        std::size_t occlusionConditional = 0;
+        // The fragment shader invocations of the depth pre-pass and of the main pass of the pre-passed objects
+        // Without the pre-pass, the main pass would have run the lighting for as many fragments as the pre-pass (same draws, same order),
+        // so the difference is the number of invocations saved by the pre-pass.
+        // They are read from pipeline statistics queries (with a delay of two frames) if the driver supports them.
+        bool fragmentStatisticsAvailable = false;
+        std::size_t prepassDrawCalls = 0;
+        std::uint64_t prepassFragmentInvocations = 0;
+        std::uint64_t prepassedFragmentInvocations = 0;
+        std::uint64_t savedFragmentInvocations = 0;
+        // The number of state changes sent to the driver and the number of redundant ones skipped by the GLStateCache
+        std::size_t glCallsIssued = 0;
+        std::size_t glCallsElided = 0;
+        // The number of bytes streamed for the frame data (instances & uniform blocks) and whether it was written to a persistent mapping
+        std::size_t streamedBytes = 0;
+        bool persistentMapping = false;
+        // The passes run and culled by the render graph, the textures in its pool and the targets that reused the texture of another target
+        std::size_t renderGraphPasses = 0;
+        std::size_t culledRenderGraphPasses = 0;
+        std::size_t pooledRenderTargets = 0;
+        std::size_t aliasedRenderTargets = 0;
+        // The number of postprocess effects, the number of fullscreen passes they were fused into and the color lookup tables they read
+        std::size_t postprocessEffects = 0;
+        std::size_t postprocessPasses = 0;
+        std::size_t postprocessLUTs = 0;
+        // The scale of the scene render targets chosen by the dynamic resolution and the smoothed GPU time of the frames (ms)
+        float renderScale = 1.0f;
+        float gpuFrameTime = 0.0f;
+        // Whether the lit opaque objects were drawn to a G-buffer and shaded by a fullscreen pass (see DeferredRenderer)
+        bool deferredShading = false;
+    };
+
+    // Everything the renderer needs to draw a frame, captured from the world on the thread that runs the systems.
+    // Drawing only reads the snapshot, so the world can be changed by the next frame while this frame is drawn on the render thread.
+    struct FrameSnapshot {
+        bool hasCamera = false;
+        glm::mat4 V, P;
+        glm::vec3 eye, cameraForward;
+        float near, far, fovY;
+        bool perspective;
+        // The commands of all the mesh renderers that are not in a static batch
+        std::vector<RenderCommand> commands;
+        std::vector<LightClusters::Light> lights;
+        // The static batches (their geometry is shared with the static batcher, the render thread uploads it if it changed)
+        std::vector<StaticBatcher::DrawBatch> staticBatches;
+        size_t staticObjects = 0;
+        size_t renderListUpdates = 0;
+        // The statistics collected while drawing this snapshot (and whether it was drawn)
+        RenderStatistics statistics;
+        bool drawn = false;
     };
 
     // A forward renderer is a renderer that draw the object final color directly to the framebuffer
@@ -29,29 +107,133 @@ namespace our
     class ForwardRenderer {
         // These window size will be used on multiple occasions (setting the viewport, computing the aspect ratio, etc.)
         glm::ivec2 windowSize;
-        // These are two vectors in which we will store the opaque and the transparent commands.
-        // We define them here (instead of being local to the "render" function) as an optimization to prevent reallocating them every frame
-        std::vector<RenderCommand> opaqueCommands;
-        std::vector<RenderCommand> transparentCommands;
+        // The commands of the mesh renderers are kept between frames and only updated when their entities change.
+        // Each frame, they are copied to a snapshot which is drawn later. There are two snapshots so one can be captured
+        // while the other is drawn on the render thread.
+        // The render queue sorts the visible commands (by pass, state and depth).
+        // We define it here (instead of being local to the "render" function) as an optimization to prevent reallocating it every frame
+        RenderList renderList;
+        FrameSnapshot snapshots[2];
+        size_t nextSnapshot = 0;
+        RenderQueue renderQueue;
+        // A command that passed the frustum culling and its bounding box in the world space
+        struct VisibleCommand {
+            RenderCommand command;
+            BoundingBox bounds;
+        };
+        // The commands are culled in chunks on the threads of the job system, each chunk stores its visible commands and its culled count
+        // then the chunks are merged in order (so the result is the same as a serial loop)
+        std::vector<std::vector<VisibleCommand>> visibleChunks;
+        std::vector<size_t> chunkCulledCounts, chunkSlots;
+        // The data that changes every frame is streamed to a single buffer (one region per frame):
+        // the frame block, then the instance data of every command then the object block of every command (in the sorted order).
+        // An instanced draw starting at the i-th command reads its instances starting from the i-th instance
+        // and a draw that isn't instanced binds the i-th object block, so no matrix is sent using a glUniform call.
+        // The layout of the blocks must match the "Frame" and "Object" blocks in the shaders (std140)
+        struct FrameBlock {
+            glm::mat4 VP;
+            glm::vec4 eye; // A vec3 takes the space of a vec4 in std140
+        };
+        struct ObjectBlock {
+            glm::mat4 transform; // VP * M
+            glm::mat4 M;
+            glm::mat4 M_IT; // The inverse transpose of M (to transform the normals)
+        };
+        StreamBuffer frameData;
+        // The alignment of the uniform block offsets (GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT) and the space taken by each object block
+        size_t uniformAlignment = 256, objectBlockStride = 256;
+        // Used to draw the meshes of the commands that share the same material and uniforms using a single call
+        MeshArena::MultiDraw multiDraw;
+        // The static objects are merged into batches when the scene is loaded (enabled using "staticBatching" in the renderer config)
+        StaticBatcher staticBatcher;
+        bool staticBatching = false;
+        float staticBatchCellSize = 32.0f;
+        // Picks the level of detail of the meshes that have simplified levels (using "lodScreenSize", "lodBias" and "lodHysteresis")
+        LodSelector lodSelector;
+        // The expensive objects are tested for occlusion (enabled using "occlusionCulling" in the renderer config)
+        OcclusionCuller occlusionCuller;
+        // If the depth pre-pass is enabled (using "depthPrepass" in the renderer config), the opaque objects whose shader has a depth variant
+        // write their depth first then are shaded using GL_EQUAL without writing the depth, so every pixel is lit at most once
+        bool depthPrepass = false;
+        // The pipeline statistics queries counting the fragment shader invocations of the pre-pass and the pre-passed draws.
+        // There are two sets that are used in alternate frames, so the results are read one frame after they were requested
+        GLuint fragmentQueries[2][2] = {};
+        bool fragmentQueriesPending[2] = {};
+        size_t frameIndex = 0;
         // Objects used for rendering a skybox
         Mesh* skySphere;
         TexturedMaterial* skyMaterial;
-        // Objects used for Postprocessing
-        GLuint postprocessFrameBuffer, postProcessVertexArray;
-        Texture2D *colorTarget, *depthTarget;
-        TexturedMaterial* postprocessMaterial;
+        // The effects used for Postprocessing (the render targets of the scene and of the effects are transient targets of the render graph)
+        PostprocessChain postprocessChain;
+        // Scales the scene render targets to keep the GPU time of the frames under a target (enabled using "dynamicResolution")
+        DynamicResolution dynamicResolution;
+        // If the weighted blended transparency is enabled (using "weightedOIT" in the renderer config), the transparent objects
+        // are not sorted but accumulated in two targets which the composite program blends over the scene
+        bool weightedOIT = false;
+        ShaderProgram* oitCompositeProgram = nullptr;
+        PipelineState oitCompositeState;
+        GLuint oitVertexArray = 0;
+        // The passes of each frame are declared in the render graph which allocates (and reuses) their render targets
+        RenderGraph renderGraph;
 
-        // Objects to support lighting
-        std::vector<LightComponent*> lightSources;
+        // Objects to support lighting (the light sources are found by the render list)
         LitMaterial* lightMaterial;
+        // The lights are assigned to the clusters of the camera frustum so each fragment only loops over the lights near it
+        LightClusters lightClusters;
+
+        // The statistics of the frame being drawn and the statistics of the last frame whose snapshot was drawn
+        RenderStatistics statistics, completedStatistics;
+
+        // Copies what is needed to draw the world to the next snapshot (it only reads the world and doesn't call OpenGL)
+        FrameSnapshot& capture(World* world);
+        // Draws a snapshot (it only calls OpenGL, so it can run on the render thread)
+        void draw(FrameSnapshot& snapshot);
+
+    protected:
+        // If true (set by the DeferredRenderer), the lit opaque objects are put in the deferred pass which is drawn by "addDeferredPasses"
+        // before the scene pass, then the scene pass draws the other objects over the lit result
+        bool deferredShading = false;
+        // The ambient light of the sky received by the lit objects (the same for the forward shaders and the deferred lighting pass)
+        struct SkyLight {
+            glm::vec3 top = glm::vec3(0.01f, 0.01f, 0.01f);
+            glm::vec3 middle = glm::vec3(0.01f, 0.01f, 0.01f);
+            glm::vec3 bottom = glm::vec3(0.01f, 0.01f, 0.01f);
+        } skyLight;
+        // What the deferred passes need to know about the frame being drawn
+        struct DeferredFrame {
+            // The targets of the scene: the lit objects are shaded to the color and their depth is kept for the forward objects
+            RenderGraph::Resource sceneColor, sceneDepth;
+            glm::ivec2 size;
+            glm::mat4 VP;
+            // The lights of the frame (already assigned to the clusters and bound to their texture units)
+            const LightClusters* lightClusters;
+            // Draws the commands of the deferred pass using the G-buffer variants of their programs
+            std::function<void()> drawGeometry;
+        };
+        // Declares the passes that draw the deferred objects and shade them to "frame.sceneColor" (the forward renderer has none)
+        virtual void addDeferredPasses(RenderGraph&, const DeferredFrame&) {}
+        // Compiles the permutations of the lit shaders for the given light defines and waits for them (see "warmShaders")
+        virtual void warmLightPermutations(const std::vector<std::string>& defines);
+
     public:
+        virtual ~ForwardRenderer() = default;
         // Initialize the renderer including the sky and the Postprocessing objects.
         // windowSize is the width & height of the window (in pixels).
-        void initialize(glm::ivec2 windowSize, const nlohmann::json& config);
+        virtual void initialize(glm::ivec2 windowSize, const nlohmann::json& config);
         // Clean up the renderer
-        void destroy();
+        virtual void destroy();
         // This function should be called every frame to draw the given world
+        // The world is captured right away but the drawing is recorded on the render thread (see RenderThread),
+        // so it happens immediately unless the render thread is running
         void render(World* world);
+        // Merges the static objects of the world into batches. It should be called once the world is loaded
+        // (the objects that are not batched are still drawn one by one)
+        void buildStaticBatches(World* world);
+        // Compiles the lit shaders for the lights of the world while it is loading, so the first frame doesn't wait for the driver
+        // (if other lights appear later, their permutations are linked in the background while the generic shaders are used)
+        void warmShaders(World* world);
+        // Returns the statistics collected while rendering the last frame that was completely drawn
+        const RenderStatistics& getStatistics() const { return completedStatistics; }
        
 
 
@@ -186,6 +186,8 @@ namespace our
                 if(app->getKeyboard().isPressed(GLFW_KEY_A)) position -= right * (deltaTime * current_sensitivity.x);
                 if (app->getKeyboard().isPressed(GLFW_KEY_LEFT)) position -= right * (deltaTime * current_sensitivity.x);
             }
+            // The camera (and the objects attached to it) moved, so the cached transforms must be updated
+            entity->markChanged();
            }
 
         // When the state exits, it should call this function to ensure the mouse is unlocked
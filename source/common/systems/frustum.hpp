@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../mesh/bounding-box.hpp"
+
+#include <glm/glm.hpp>
+
+namespace our {
+
+    // The 6 planes of a camera frustum in the world space, used to skip the objects that can't be seen by the camera
+    // Each plane is stored as (normal, distance) where the normal points to the inside of the frustum
+    struct Frustum {
+        glm::vec4 planes[6];
+
+        // Extracts the planes from a view projection matrix (the Gribb-Hartmann method):
+        // a point p is inside the clip volume if -w <= x, y, z <= w where (x, y, z, w) = VP * p,
+        // so each plane is the sum or the difference of the last row and one of the other rows of VP
+        static Frustum fromMatrix(const glm::mat4& VP){
+            // glm matrices are column major so the i-th row is made of the i-th component of each column
+            auto row = [&](int i){ return glm::vec4(VP[0][i], VP[1][i], VP[2][i], VP[3][i]); };
+            Frustum frustum;
+            frustum.planes[0] = row(3) + row(0); // Left
+            frustum.planes[1] = row(3) - row(0); // Right
+            frustum.planes[2] = row(3) + row(1); // Bottom
+            frustum.planes[3] = row(3) - row(1); // Top
+            frustum.planes[4] = row(3) + row(2); // Near
+            frustum.planes[5] = row(3) - row(2); // Far
+            return frustum;
+        }
+
+        // Returns false if the box is completely outside one of the planes
+        // (this is conservative: some boxes near the corners of the frustum are reported as visible even if they are not)
+        bool intersects(const BoundingBox& box) const {
+            if(box.isEmpty()) return false;
+            for(const glm::vec4& plane : planes){
+                // Pick the corner of the box that is the farthest along the plane normal,
+                // if it is behind the plane then the whole box is behind it
+                glm::vec3 corner(
+                    plane.x >= 0 ? box.max.x : box.min.x,
+                    plane.y >= 0 ? box.max.y : box.min.y,
+                    plane.z >= 0 ? box.max.z : box.min.z
+                );
+                if(glm::dot(glm::vec3(plane), corner) + plane.w < 0) return false;
+            }
+            return true;
+        }
+    };
+
+}
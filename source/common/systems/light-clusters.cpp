@@ -0,0 +1,228 @@
+#include "light-clusters.hpp"
+#include "../ecs/entity.hpp"
+#include "../deserialize-utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace our {
+
+    // The uniforms used by the clustered lighting in "assets/shaders/lighted.frag"
+    static const UniformHandle lightDataUniform("light_data");
+    static const UniformHandle clusterGridUniform("cluster_grid");
+    static const UniformHandle lightIndicesUniform("light_indices");
+    static const UniformHandle globalLightCountUniform("global_light_count");
+    static const UniformHandle clusterCountUniform("cluster_count");
+    static const UniformHandle clusterTileSizeUniform("cluster_tile_size");
+    static const UniformHandle clusterDepthParamsUniform("cluster_depth_params");
+    static const UniformHandle cameraForwardUniform("camera_forward");
+
+    // Returns the distance after which the light intensity drops below the cutoff
+    // The attenuation is "x*d^2 + y*d + z", so we solve "x*d^2 + y*d + z = intensity / cutoff" for d
+    // A negative range means that the light never fades out (so it must be treated as a global light)
+    static float computeLightRange(const LightClusters::Light* light, float cutoff){
+        float intensity = std::max(glm::max(light->diffuse.r, glm::max(light->diffuse.g, light->diffuse.b)),
+                                   glm::max(light->specular.r, glm::max(light->specular.g, light->specular.b)));
+        if(intensity <= 0.0f) return 0.0f;
+        float target = intensity / cutoff;
+        const glm::vec3& attenuation = light->attenuation;
+        if(attenuation.x > 0.0f){
+            float discriminant = attenuation.y * attenuation.y - 4.0f * attenuation.x * (attenuation.z - target);
+            return std::max(0.0f, (-attenuation.y + std::sqrt(std::max(discriminant, 0.0f))) / (2.0f * attenuation.x));
+        } else if(attenuation.y > 0.0f){
+            return std::max(0.0f, (target - attenuation.z) / attenuation.y);
+        }
+        return -1.0f;
+    }
+
+    // Uploads the given array to the given buffer (an empty array is replaced by a single zeroed element since buffer textures can't be empty)
+    template<typename T>
+    static void uploadBuffer(GLuint buffer, const std::vector<T>& data){
+        static const T zero{};
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        if(data.empty()) glBufferData(GL_TEXTURE_BUFFER, sizeof(T), &zero, GL_STREAM_DRAW);
+        else glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(T), data.data(), GL_STREAM_DRAW);
+    }
+
+    void LightClusters::initialize(const nlohmann::json& config){
+        if(config.is_object()){
+            gridSize = glm::max(config.value("grid", gridSize), glm::ivec3(1));
+            lightCutoff = std::max(config.value("lightCutoff", lightCutoff), 1e-6f);
+        }
+
+        // Create the buffers and a buffer texture to read each of them in the shader
+        GLuint* buffers[] = {&lightBuffer, &clusterBuffer, &indexBuffer};
+        GLuint* textures[] = {&lightTexture, &clusterTexture, &indexTexture};
+        GLenum formats[] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+        for(int i = 0; i < 3; i++){
+            glGenBuffers(1, buffers[i]);
+            glBindBuffer(GL_TEXTURE_BUFFER, *buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glGenTextures(1, textures[i]);
+            GLStateCache::bindTexture(GL_TEXTURE_BUFFER, *textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], *buffers[i]);
+        }
+        GLStateCache::bindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void LightClusters::destroy(){
+        GLuint buffers[] = {lightBuffer, clusterBuffer, indexBuffer};
+        GLuint textures[] = {lightTexture, clusterTexture, indexTexture};
+        glDeleteTextures(3, textures);
+        for(GLuint texture : textures) GLStateCache::onTextureDeleted(texture);
+        glDeleteBuffers(3, buffers);
+        lightBuffer = clusterBuffer = indexBuffer = 0;
+        lightTexture = clusterTexture = indexTexture = 0;
+    }
+
+    void LightClusters::classify(const std::vector<Light>& lights, bool perspective, unsigned int& types, size_t& globalCount) const {
+        // The same rules as "update" without packing the lights
+        types = 0;
+        globalCount = 0;
+        for(const Light& light : lights){
+            if(light.type < 0) continue;
+            float range = light.type == 0 ? -1.0f : computeLightRange(&light, lightCutoff);
+            if(range == 0.0f) continue;
+            types |= 1u << light.type;
+            if(range < 0.0f || !perspective) globalCount++;
+        }
+    }
+
+    void LightClusters::update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection,
+        float near, float far, bool perspective, glm::ivec2 viewportSize){
+
+        // A light that was kept for cluster assignment (its index in the light data, its view space center and its range)
+        struct LocalLight {
+            GLuint index;
+            glm::vec3 center;
+            float range;
+        };
+        std::vector<LocalLight> localLights;
+        lightData.clear();
+        lightTypes = 0;
+        clusters.assign((size_t)gridSize.x * gridSize.y * gridSize.z, glm::uvec2(0));
+        lightIndices.clear();
+
+        // Packs a light into LIGHT_TEXELS texels:
+        // [position, type], [direction, 0], [diffuse, inner cone angle], [specular, outer cone angle], [attenuation, 0]
+        auto packLight = [this](const Light* light, const glm::vec3& position, const glm::vec3& direction){
+            lightTypes |= 1u << light->type;
+            lightData.emplace_back(position, (float)light->type);
+            lightData.emplace_back(direction, 0.0f);
+            lightData.emplace_back(light->diffuse, light->coneAngles.x);
+            lightData.emplace_back(light->specular, light->coneAngles.y);
+            lightData.emplace_back(light->type == 0 ? glm::vec3(0, 0, 1) : light->attenuation, 0.0f);
+        };
+
+        // First, we pack the global lights and collect the local ones
+        struct Candidate { const Light* light; glm::vec3 position, direction; float range; };
+        std::vector<Candidate> candidates;
+        for(const Light& source : lights){
+            const Light* light = &source;
+            if(light->type < 0) continue;
+            const glm::mat4& M = light->localToWorld;
+            glm::vec3 position = M * glm::vec4(0, 0, 0, 1);
+            glm::vec3 direction = M * glm::vec4(0, -1, 0, 0);
+            float range = light->type == 0 ? -1.0f : computeLightRange(light, lightCutoff);
+            // A light whose intensity is below the cutoff everywhere can't affect anything
+            if(range == 0.0f) continue;
+            if(range < 0.0f || !perspective) packLight(light, position, direction);
+            else candidates.push_back({light, position, direction, range});
+        }
+        globalLightCount = (GLuint)(lightData.size() / LIGHT_TEXELS);
+        for(auto& candidate : candidates){
+            GLuint index = (GLuint)(lightData.size() / LIGHT_TEXELS);
+            packLight(candidate.light, candidate.position, candidate.direction);
+            localLights.push_back({index, glm::vec3(view * glm::vec4(candidate.position, 1.0f)), candidate.range});
+        }
+
+        // The shader computes the view depth of a fragment as its distance along the camera forward direction
+        cameraForward = -glm::vec3(view[0][2], view[1][2], view[2][2]);
+        // The tiles cover the whole viewport and the depth slices are distributed exponentially between the near and far planes
+        // so that slice = log(depth) * depthScale - depthBias
+        tileSize = glm::vec2(viewportSize) / glm::vec2(gridSize.x, gridSize.y);
+        float logDepthRatio = std::log(far / near);
+        depthScale = gridSize.z / logDepthRatio;
+        depthBias = gridSize.z * std::log(near) / logDepthRatio;
+        auto sliceOf = [&](float depth){
+            return glm::clamp((int)std::floor(std::log(depth) * depthScale - depthBias), 0, gridSize.z - 1);
+        };
+
+        // For each local light, we find the range of clusters that its influence sphere overlaps
+        struct ClusterRange { GLuint light; glm::ivec3 from, to; };
+        std::vector<ClusterRange> ranges;
+        for(auto& light : localLights){
+            float depth = -light.center.z;
+            if(depth + light.range < near || depth - light.range > far) continue;
+            ClusterRange range{light.index, {0, 0, sliceOf(std::max(depth - light.range, near))}, {gridSize.x - 1, gridSize.y - 1, sliceOf(std::min(depth + light.range, far))}};
+            // If the sphere is completely in front of the near plane, we project the corners of its bounding box to find the tiles it covers
+            // Otherwise, it may cover any tile so we keep the whole screen
+            if(depth - light.range > near){
+                glm::vec2 ndcMin(1.0f), ndcMax(-1.0f);
+                for(int corner = 0; corner < 8; corner++){
+                    glm::vec3 offset((corner & 1) ? light.range : -light.range, (corner & 2) ? light.range : -light.range, (corner & 4) ? light.range : -light.range);
+                    glm::vec4 clip = projection * glm::vec4(light.center + offset, 1.0f);
+                    glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                    ndcMin = glm::min(ndcMin, ndc);
+                    ndcMax = glm::max(ndcMax, ndc);
+                }
+                if(ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f) continue;
+                glm::vec2 pixelMin = (glm::clamp(ndcMin, -1.0f, 1.0f) * 0.5f + 0.5f) * glm::vec2(viewportSize);
+                glm::vec2 pixelMax = (glm::clamp(ndcMax, -1.0f, 1.0f) * 0.5f + 0.5f) * glm::vec2(viewportSize);
+                range.from.x = glm::clamp((int)(pixelMin.x / tileSize.x), 0, gridSize.x - 1);
+                range.from.y = glm::clamp((int)(pixelMin.y / tileSize.y), 0, gridSize.y - 1);
+                range.to.x = glm::clamp((int)(pixelMax.x / tileSize.x), 0, gridSize.x - 1);
+                range.to.y = glm::clamp((int)(pixelMax.y / tileSize.y), 0, gridSize.y - 1);
+            }
+            ranges.push_back(range);
+        }
+
+        // Then we fill the clusters in 2 passes: first count the lights of each cluster to compute the offsets, then write the indices
+        auto clusterIndex = [this](int x, int y, int z){ return (size_t)x + gridSize.x * ((size_t)y + (size_t)gridSize.y * z); };
+        for(auto& range : ranges)
+            for(int z = range.from.z; z <= range.to.z; z++)
+                for(int y = range.from.y; y <= range.to.y; y++)
+                    for(int x = range.from.x; x <= range.to.x; x++)
+                        clusters[clusterIndex(x, y, z)].y++;
+        GLuint offset = 0;
+        for(auto& cluster : clusters){
+            cluster.x = offset;
+            offset += cluster.y;
+            cluster.y = 0;
+        }
+        lightIndices.resize(offset);
+        for(auto& range : ranges)
+            for(int z = range.from.z; z <= range.to.z; z++)
+                for(int y = range.from.y; y <= range.to.y; y++)
+                    for(int x = range.from.x; x <= range.to.x; x++){
+                        auto& cluster = clusters[clusterIndex(x, y, z)];
+                        lightIndices[cluster.x + cluster.y++] = range.light;
+                    }
+
+        // Finally, we upload everything
+        uploadBuffer(lightBuffer, lightData);
+        uploadBuffer(clusterBuffer, clusters);
+        uploadBuffer(indexBuffer, lightIndices);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void LightClusters::bind() const {
+        GLStateCache::bindTexture(LIGHT_DATA_UNIT, GL_TEXTURE_BUFFER, lightTexture);
+        GLStateCache::bindTexture(CLUSTER_GRID_UNIT, GL_TEXTURE_BUFFER, clusterTexture);
+        GLStateCache::bindTexture(LIGHT_INDICES_UNIT, GL_TEXTURE_BUFFER, indexTexture);
+        GLStateCache::activeTexture(0);
+    }
+
+    void LightClusters::setUniforms(ShaderProgram* shader) const {
+        shader->set(lightDataUniform, (GLint)LIGHT_DATA_UNIT);
+        shader->set(clusterGridUniform, (GLint)CLUSTER_GRID_UNIT);
+        shader->set(lightIndicesUniform, (GLint)LIGHT_INDICES_UNIT);
+        shader->set(globalLightCountUniform, (GLint)globalLightCount);
+        shader->set(clusterCountUniform, gridSize);
+        shader->set(clusterTileSizeUniform, tileSize);
+        shader->set(clusterDepthParamsUniform, glm::vec2(depthScale, depthBias));
+        shader->set(cameraForwardUniform, cameraForward);
+    }
+
+}
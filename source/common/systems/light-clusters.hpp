@@ -0,0 +1,98 @@
+#pragma once
+
+#include "../components/light.hpp"
+#include "../ecs/entity.hpp"
+#include "../shader/shader.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <vector>
+
+namespace our
+{
+
+    // Clustered forward lighting
+    // The view frustum is divided into a grid of clusters (froxels): screen tiles on x & y and exponential depth slices on z.
+    // Every frame, each light is assigned (on the CPU) to the clusters that its influence sphere touches,
+    // then the lights, the cluster grid and the light index lists are uploaded as texture buffers.
+    // The fragment shader finds its cluster and only loops over the lights listed for it,
+    // so the cost of a fragment depends on the number of lights around it instead of the number of lights in the scene.
+    class LightClusters {
+        // The number of clusters on each axis (x & y are screen tiles, z is the depth slices)
+        glm::ivec3 gridSize = {16, 9, 24};
+        // A light stops affecting a cluster once its attenuated intensity drops below this value
+        float lightCutoff = 1.0f / 256.0f;
+
+        // The packed data of all the lights (LIGHT_TEXELS RGBA32F texels per light)
+        // The "global" lights (directional lights, lights without a finite range) come first since they affect every fragment
+        std::vector<glm::vec4> lightData;
+        GLuint globalLightCount = 0;
+        // A bit for each type of the uploaded lights (1 << type)
+        unsigned int lightTypes = 0;
+        // For each cluster: the offset of its first light index in "lightIndices" and the number of its lights
+        std::vector<glm::uvec2> clusters;
+        // The light indices of all the clusters stored one after the other
+        std::vector<GLuint> lightIndices;
+
+        // The screen size of a tile in pixels and the constants used to find the depth slice of a view depth
+        glm::vec2 tileSize = {1, 1};
+        float depthScale = 0, depthBias = 0;
+        glm::vec3 cameraForward = {0, 0, -1};
+
+        // Each array above is stored in a buffer that is read in the shader through a buffer texture
+        GLuint lightBuffer = 0, clusterBuffer = 0, indexBuffer = 0;
+        GLuint lightTexture = 0, clusterTexture = 0, indexTexture = 0;
+
+    public:
+        // The parameters of a light and its transform copied from its component,
+        // so the lights can be clustered after the world changed (e.g. on the render thread)
+        struct Light {
+            int type;
+            glm::vec3 diffuse, specular, attenuation;
+            glm::vec2 coneAngles;
+            glm::mat4 localToWorld;
+
+            static Light fromComponent(const LightComponent* light){
+                return {light->type, light->diffuse, light->specular, light->attenuation, light->coneAngles, light->getOwner()->getLocalToWorldMatrix()};
+            }
+        };
+
+        // The number of RGBA32F texels used to store each light (must match "fetch_light" in "assets/shaders/lighted.frag")
+        static constexpr int LIGHT_TEXELS = 5;
+        // The texture units to which the buffer textures are bound (the lit material uses the units before them)
+        static constexpr GLuint LIGHT_DATA_UNIT = 5;
+        static constexpr GLuint CLUSTER_GRID_UNIT = 6;
+        static constexpr GLuint LIGHT_INDICES_UNIT = 7;
+
+        // Creates the buffers. The config may contain "grid" ([x, y, z] cluster counts) and "lightCutoff"
+        void initialize(const nlohmann::json& config);
+        // Deletes the buffers
+        void destroy();
+
+        // Assigns the lights to the clusters of the given camera and uploads the result to the GPU
+        // If the projection is not a perspective projection, every light is treated as a global light
+        void update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection,
+            float near, float far, bool perspective, glm::ivec2 viewportSize);
+
+        // Finds the types of the lights that "update" would upload (a bit for each type) and the number of the global ones
+        // without uploading anything (e.g. to compile the shaders for the lights of a scene while it is loading)
+        void classify(const std::vector<Light>& lights, bool perspective, unsigned int& types, size_t& globalCount) const;
+
+        // Binds the buffer textures to their texture units (only needs to be done once per frame)
+        void bind() const;
+        // Sends the cluster uniforms to the given (lit) shader. The shader must be in use.
+        void setUniforms(ShaderProgram* shader) const;
+
+        // Returns the number of uploaded lights and the total number of light references stored in the clusters
+        size_t getLightCount() const { return lightData.size() / LIGHT_TEXELS; }
+        size_t getLightReferenceCount() const { return lightIndices.size(); }
+        // Returns the number of global lights (the lights at the start of the light data that affect every fragment)
+        size_t getGlobalLightCount() const { return globalLightCount; }
+        // Returns true if at least one uploaded light has the given type (0: directional, 1: point, 2: spot)
+        bool hasLightType(int type) const { return (lightTypes & (1u << type)) != 0; }
+        // Returns a bit for each type of the uploaded lights (1 << type)
+        unsigned int getLightTypes() const { return lightTypes; }
+    };
+
+}
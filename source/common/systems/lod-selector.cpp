@@ -0,0 +1,70 @@
+#include "lod-selector.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace our {
+
+    // The levels of the objects that were not drawn for this number of frames are forgotten
+    static constexpr size_t UNUSED_FRAMES_BEFORE_FORGET = 120;
+
+    void LodSelector::initialize(const nlohmann::json& config){
+        screenSize = std::max(config.value("lodScreenSize", screenSize), 1e-4f);
+        bias = config.value("lodBias", bias);
+        hysteresis = std::max(config.value("lodHysteresis", hysteresis), 0.0f);
+    }
+
+    void LodSelector::beginFrame(const glm::vec3& eye, float fovY, bool perspective){
+        this->eye = eye;
+        this->tanHalfFovY = std::tan(fovY * 0.5f);
+        this->perspective = perspective;
+        frame++;
+        reducedCount = 0;
+        // Forget the objects that are gone (checked once in a while since it needs a pass over all the entries)
+        if(frame % UNUSED_FRAMES_BEFORE_FORGET == 0){
+            for(auto it = entries.begin(); it != entries.end();){
+                if(it->second.lastFrame + UNUSED_FRAMES_BEFORE_FORGET < frame) it = entries.erase(it);
+                else ++it;
+            }
+        }
+    }
+
+    Mesh* LodSelector::select(const void* id, Mesh* mesh, const BoundingBox& bounds){
+        size_t levelCount = mesh->getLodCount();
+        // The size of an object doesn't change with its distance in an orthographic projection
+        if(levelCount == 1 || !perspective) return mesh;
+
+        float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+        float distance = glm::length(bounds.getCenter() - eye);
+        if(distance <= radius) return mesh;
+        float size = radius / (distance * tanHalfFovY);
+        // A degenerate box (or field of view) has no size on the screen, so its level can't be computed
+        if(!(size > 0.0f)) return mesh;
+
+        // The continuous level: 0 at "screenSize", 1 at half of it, 2 at a quarter and so on
+        float continuousLevel = std::log2(screenSize / size) + bias;
+        if(!std::isfinite(continuousLevel)) return mesh;
+        size_t maxLevel = levelCount - 1;
+        // The level of the continuous level (clamped before the conversion since a float too large for size_t can't be converted)
+        auto levelOf = [maxLevel](float continuousLevel){
+            float level = std::floor(continuousLevel);
+            return level <= 0.0f ? (size_t)0 : (size_t)std::min(level, (float)maxLevel);
+        };
+
+        auto [it, created] = entries.try_emplace(id);
+        Entry& entry = it->second;
+        entry.lastFrame = frame;
+        if(created){
+            // A new object starts directly at its level (the hysteresis only applies to the changes of level)
+            entry.level = levelOf(continuousLevel);
+        } else {
+            // The current level is kept while the continuous level stays within [level - hysteresis, level + 1 + hysteresis]
+            float low = (float)entry.level - hysteresis, high = (float)entry.level + 1.0f + hysteresis;
+            if(continuousLevel < low || continuousLevel > high) entry.level = levelOf(continuousLevel);
+        }
+        entry.level = std::min(entry.level, maxLevel);
+        if(entry.level > 0) reducedCount++;
+        return mesh->getLod(entry.level);
+    }
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../mesh/mesh.hpp"
+#include "../mesh/bounding-box.hpp"
+
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <unordered_map>
+
+namespace our {
+
+    // Picks the level of detail of each object from its projected size on the screen
+    // The size is the radius of the bounding sphere of the object divided by the half height of the view at its distance,
+    // so it is 1 when the object fills the screen vertically. The level 0 is used while the size is above "screenSize",
+    // then each level is used for half the size of the previous one (since each level has about half the triangles).
+    // To avoid popping back and forth at the distance where two levels meet, an object only changes its level
+    // once its size goes past the threshold by a margin (hysteresis).
+    class LodSelector {
+        struct Entry {
+            size_t level = 0;
+            size_t lastFrame = 0;
+        };
+
+        // The projected size below which the level 1 is used
+        float screenSize = 0.25f;
+        // A positive bias selects less detailed levels (each unit of bias halves the sizes at which the levels change)
+        float bias = 0.0f;
+        // The margin (in levels) by which the size must go past a threshold to change the level
+        float hysteresis = 0.2f;
+
+        // The level picked for each object in the last frames (indexed by the object id)
+        std::unordered_map<const void*, Entry> entries;
+        size_t frame = 0;
+        // The camera data of the current frame
+        glm::vec3 eye = {0, 0, 0};
+        float tanHalfFovY = 1.0f;
+        bool perspective = true;
+
+        size_t reducedCount = 0;
+
+    public:
+        // Reads "lodScreenSize", "lodBias" and "lodHysteresis" from the renderer config
+        void initialize(const nlohmann::json& config);
+
+        // Should be called at the start of every frame with the camera parameters
+        void beginFrame(const glm::vec3& eye, float fovY, bool perspective);
+        // Returns the level of detail of the mesh that should be drawn for the given object (its bounding box is in the world space)
+        Mesh* select(const void* id, Mesh* mesh, const BoundingBox& bounds);
+
+        // The number of objects drawn using a simplified level in the current frame
+        size_t getReducedCount() const { return reducedCount; }
+    };
+
+}
@@ -28,6 +28,8 @@ namespace our
                     // Change the position and rotation based on the linear & angular velocity and delta time.
                     entity->localTransform.position += deltaTime * movement->linearVelocity;
                     entity->localTransform.rotation += deltaTime * movement->angularVelocity;
+                    // Let the systems that cache the transform know that it changed
+                    entity->markChanged();
                 }
             }
         }
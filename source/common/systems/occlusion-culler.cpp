@@ -0,0 +1,133 @@
+#include "occlusion-culler.hpp"
+#include "../gl-state-cache.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace our {
+
+    static const UniformHandle transformUniform("transform");
+
+    // The queries of the objects that were not drawn for this number of frames are deleted
+    static constexpr size_t UNUSED_FRAMES_BEFORE_DELETE = 120;
+
+    void OcclusionCuller::initialize(const nlohmann::json& config){
+        if(!config.is_object()) return;
+        // Like the depth pre-pass, the occlusion queries are only used when the config asks for them
+        enabled = config.value("enabled", enabled);
+        minTriangles = config.value("minTriangles", minTriangles);
+        nearMargin = config.value("nearMargin", nearMargin);
+        if(!enabled) return;
+
+        // A unit cube from (0, 0, 0) to (1, 1, 1). Face culling is disabled while drawing it so the winding doesn't matter
+        std::vector<Vertex> vertices;
+        for(int corner = 0; corner < 8; corner++){
+            Vertex vertex{};
+            vertex.position = glm::vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+            vertices.push_back(vertex);
+        }
+        std::vector<unsigned int> elements = {
+            0, 1, 3, 0, 3, 2,   4, 6, 7, 4, 7, 5, // -Z & +Z
+            0, 4, 5, 0, 5, 1,   2, 3, 7, 2, 7, 6, // -Y & +Y
+            0, 2, 6, 0, 6, 4,   1, 5, 7, 1, 7, 3  // -X & +X
+        };
+        boxMesh = new Mesh(vertices, elements);
+
+        boxProgram = new ShaderProgram();
+        boxProgram->attach("assets/shaders/occlusion-box.vert", GL_VERTEX_SHADER);
+        boxProgram->attach("assets/shaders/depth-only.frag", GL_FRAGMENT_SHADER);
+        boxProgram->link();
+    }
+
+    void OcclusionCuller::destroy(){
+        for(auto& [id, entry] : entries) glDeleteQueries(1, &entry.query);
+        entries.clear();
+        delete boxMesh;
+        delete boxProgram;
+        boxMesh = nullptr;
+        boxProgram = nullptr;
+    }
+
+    void OcclusionCuller::beginFrame(){
+        frame++;
+        testedCount = conditionalCount = 0;
+        for(auto it = entries.begin(); it != entries.end();){
+            Entry& entry = it->second;
+            if(entry.lastFrame + UNUSED_FRAMES_BEFORE_DELETE < frame){
+                glDeleteQueries(1, &entry.query);
+                it = entries.erase(it);
+                continue;
+            }
+            // Read the result of the last query only if the GPU already finished it
+            if(entry.pending){
+                GLuint available = 0;
+                glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT_AVAILABLE, &available);
+                if(available){
+                    GLuint anySamplesPassed = 0;
+                    glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT, &anySamplesPassed);
+                    entry.visible = anySamplesPassed != 0;
+                    entry.pending = false;
+                }
+            }
+            ++it;
+        }
+    }
+
+    bool OcclusionCuller::prepare(const void* id, const BoundingBox& bounds, const glm::mat4& VP, const glm::vec3& eye){
+        Entry& entry = entries[id];
+        if(!entry.query) glGenQueries(1, &entry.query);
+        entry.lastFrame = frame;
+        testedCount++;
+
+        // If the camera is (almost) inside the box, the object is surely visible
+        if(glm::all(glm::greaterThanEqual(eye, bounds.min - nearMargin)) && glm::all(glm::lessThanEqual(eye, bounds.max + nearMargin)))
+            entry.visible = true;
+
+        if(entry.visible){
+            // Draw it normally and check if it is still visible (unless the last check is not done yet)
+            entry.mode = entry.pending ? Mode::NORMAL : Mode::QUERIED;
+            return false;
+        }
+
+        conditionalCount++;
+        entry.mode = Mode::CONDITIONAL;
+        // If the query of the box of the last frame is still pending, the conditional render uses its result
+        if(entry.pending) return false;
+
+        // Draw the box with the depth test but without writing the color nor the depth
+        GLStateCache::setEnabled(GL_DEPTH_TEST, true);
+        GLStateCache::depthFunc(GL_LEQUAL);
+        GLStateCache::depthMask(false);
+        GLStateCache::colorMask(glm::bvec4(false));
+        GLStateCache::setEnabled(GL_CULL_FACE, false);
+        GLStateCache::setEnabled(GL_BLEND, false);
+        boxProgram->use();
+        glm::mat4 boxTransform = glm::translate(glm::mat4(1.0f), bounds.min) * glm::scale(glm::mat4(1.0f), bounds.max - bounds.min);
+        boxProgram->set(transformUniform, VP * boxTransform);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, entry.query);
+        boxMesh->draw();
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        entry.pending = true;
+        return true;
+    }
+
+    void OcclusionCuller::beginDraw(const void* id){
+        Entry& entry = entries[id];
+        if(entry.mode == Mode::QUERIED){
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, entry.query);
+        } else if(entry.mode == Mode::CONDITIONAL){
+            // The GPU waits for the query (which was issued right before) instead of the CPU
+            glBeginConditionalRender(entry.query, GL_QUERY_WAIT);
+        }
+    }
+
+    void OcclusionCuller::endDraw(const void* id){
+        Entry& entry = entries[id];
+        if(entry.mode == Mode::QUERIED){
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            entry.pending = true;
+        } else if(entry.mode == Mode::CONDITIONAL){
+            glEndConditionalRender();
+        }
+    }
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../mesh/mesh.hpp"
+#include "../mesh/bounding-box.hpp"
+#include "../shader/shader.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <unordered_map>
+
+namespace our {
+
+    // Hardware occlusion culling for the expensive objects (the meshes with many triangles)
+    // These objects are drawn after all the other opaque objects so the depth buffer already contains their potential occluders.
+    // Each object keeps an occlusion query (GL_ANY_SAMPLES_PASSED) and the result of its last test (temporal coherence):
+    // - If it was visible, it is drawn normally and the draw itself is wrapped in the query to check if it is still visible.
+    // - If it was occluded, its bounding box is drawn in the query (without writing anything)
+    //   and the real draw is wrapped in a conditional render, so the GPU skips it if no sample of the box passed the depth test.
+    // The results are only read once they are available, so the CPU never waits for the GPU.
+    class OcclusionCuller {
+    public:
+        // How the current object is drawn this frame (decided by "prepare")
+        enum class Mode {
+            NORMAL,         // Drawn normally (its last query is still pending)
+            QUERIED,        // Drawn normally inside a new query
+            CONDITIONAL     // Drawn using a conditional render on the query of its bounding box
+        };
+
+    private:
+        struct Entry {
+            GLuint query = 0;
+            bool pending = false;   // Whether the query was issued and its result was not read yet
+            bool visible = true;    // The result of the last test (an object is assumed visible until a query says otherwise)
+            size_t lastFrame = 0;   // The last frame in which the object was drawn (to delete the queries of the objects that are gone)
+            Mode mode = Mode::NORMAL;
+        };
+
+        bool enabled = false;
+        // Only the meshes with at least this number of triangles are tested
+        size_t minTriangles = 5000;
+        // If the camera is closer than this distance to the box of an object, the object is drawn without testing it
+        // (since the near plane could clip the front faces of the box)
+        float nearMargin = 1.0f;
+        // The queries of the tested objects indexed by the id of the objects
+        std::unordered_map<const void*, Entry> entries;
+        size_t frame = 0;
+        // A unit cube and the program used to draw the bounding boxes
+        Mesh* boxMesh = nullptr;
+        ShaderProgram* boxProgram = nullptr;
+
+        size_t testedCount = 0, conditionalCount = 0;
+
+    public:
+        // Creates the box mesh & program. The config may contain "enabled", "minTriangles" and "nearMargin"
+        void initialize(const nlohmann::json& config);
+        // Deletes the queries, the box mesh & program
+        void destroy();
+
+        bool isEnabled() const { return enabled; }
+        // Returns true if the mesh is expensive enough to be worth an occlusion test
+        bool shouldTest(const Mesh* mesh) const { return enabled && mesh->getTriangleCount() >= minTriangles; }
+
+        // Should be called at the start of every frame: reads the results that are available and forgets the objects that are gone
+        void beginFrame();
+        // Decides how the object with the given id is drawn this frame. Must be called before the material of the object is set up.
+        // If the object was occluded, its bounding box (in the world space) is drawn in a query, which changes the program & the pipeline state.
+        // Returns true in that case (the material must then be set up again)
+        bool prepare(const void* id, const BoundingBox& bounds, const glm::mat4& VP, const glm::vec3& eye);
+        // Must be called right before and right after the draw call of the prepared object
+        void beginDraw(const void* id);
+        void endDraw(const void* id);
+
+        // The number of objects tested in the current frame and the number that were drawn conditionally (predicted to be occluded)
+        size_t getTestedCount() const { return testedCount; }
+        size_t getConditionalCount() const { return conditionalCount; }
+    };
+
+}
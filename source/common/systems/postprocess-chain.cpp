@@ -0,0 +1,262 @@
+#include "postprocess-chain.hpp"
+#include "color-lut.hpp"
+#include "../gl-state-cache.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+namespace our {
+
+    namespace {
+        // How an effect reads the input of its pass
+        enum class EffectKind {
+            GRADE,       // Only depends on the color of the pixel, so it can be baked into a color lookup table
+            COLOR,       // Only changes the color of the pixel (but depends on its position), so it can be applied after any other effect of the pass
+            SAMPLE,      // Reads a few texels around the pixel, so it can only be the first effect of a pass
+            NEIGHBORHOOD // Reads many texels around the pixel, so it gets its own pass at a reduced resolution
+        };
+
+        // The effects that can be used in a chain: their name in the config, the function that applies them and how they read the input
+        // (the function of an effect is defined in the file with the same name in "effectsFolder")
+        struct EffectInfo {
+            const char* name;
+            const char* function;
+            EffectKind kind;
+        };
+        const EffectInfo effects[] = {
+            {"chromatic-aberration", "chromatic_aberration", EffectKind::SAMPLE},
+            {"damage", "damage", EffectKind::SAMPLE},
+            {"radial-blur", "radial_blur", EffectKind::NEIGHBORHOOD},
+            {"grayscale", "grayscale", EffectKind::GRADE},
+            {"sepia-tone", "sepia_tone", EffectKind::GRADE},
+            {"two-tone", "two_tone", EffectKind::GRADE},
+            {"vignette", "vignette", EffectKind::COLOR},
+        };
+        const std::string effectsFolder = "assets/shaders/postprocess/effects/";
+
+        const EffectInfo* findEffect(const std::string& name){
+            for(const EffectInfo& effect : effects) if(name == effect.name) return &effect;
+            return nullptr;
+        }
+
+        // Returns the GLSL code defining the function of the effect
+        std::string readEffect(const EffectInfo* effect){
+            std::ifstream file(effectsFolder + effect->name + ".glsl");
+            if(!file){
+                std::cerr << "ERROR: Couldn't open postprocess effect file: " << effectsFolder << effect->name << ".glsl" << std::endl;
+                return "";
+            }
+            std::stringstream buffer;
+            buffer << file.rdbuf();
+            return buffer.str() + "\n";
+        }
+
+        // The effects of a pass before they are turned into a shader: an optional sampling effect then the color effects (and grades)
+        struct StageDesc {
+            const EffectInfo* head = nullptr;
+            std::vector<const EffectInfo*> colorEffects;
+            float scale = 1.0f;
+        };
+
+        // Writes the fragment shader of a pass. The functions of the effects are pasted in the shader then called one after the other,
+        // so the color stays in a register between the effects instead of being written to a texture and read again.
+        // If "vertexArray" isn't 0, each run of consecutive grades is baked into a color lookup table which is added to "luts"
+        // and the shader reads the table instead of calling the grades
+        std::string generateSource(const StageDesc& stage, GLuint vertexArray, std::vector<Texture3D*>& luts){
+            std::string functions, body;
+            // Each file is pasted once even if its effect is used more than once in the pass
+            std::set<std::string> pasted;
+            auto paste = [&](const EffectInfo* effect){
+                if(pasted.insert(effect->name).second) functions += readEffect(effect);
+            };
+            if(stage.head){
+                paste(stage.head);
+                body += std::string("    vec4 color = ") + stage.head->function + "(tex, tex_coord);\n";
+            } else {
+                body += "    vec4 color = texture(tex, tex_coord);\n";
+            }
+            for(size_t index = 0; index < stage.colorEffects.size();){
+                // Find the run of grades starting at this effect (a pass can't read more than MAX_LUTS tables)
+                size_t end = index;
+                if(vertexArray && luts.size() < PostprocessChain::MAX_LUTS)
+                    while(end < stage.colorEffects.size() && stage.colorEffects[end]->kind == EffectKind::GRADE) end++;
+                if(end > index){
+                    std::string grades;
+                    std::set<std::string> baked;
+                    std::vector<std::string> calls;
+                    for(size_t grade = index; grade < end; grade++){
+                        if(baked.insert(stage.colorEffects[grade]->name).second) grades += readEffect(stage.colorEffects[grade]);
+                        calls.push_back(stage.colorEffects[grade]->function);
+                    }
+                    if(Texture3D* lut = bakeColorLUT(grades, calls, vertexArray)){
+                        body += "    color = apply_color_lut(color_lut" + std::to_string(luts.size()) + ", color);\n";
+                        luts.push_back(lut);
+                        index = end;
+                        continue;
+                    }
+                }
+                // Otherwise, the effect is called directly
+                paste(stage.colorEffects[index]);
+                body += std::string("    color = ") + stage.colorEffects[index]->function + "(color, tex_coord);\n";
+                index++;
+            }
+
+            std::string source =
+                "#version 330\n"
+                "\n"
+                "// Generated by PostprocessChain from the effects in \"" + effectsFolder + "\"\n"
+                "uniform sampler2D tex;\n"
+                "in vec2 tex_coord;\n"
+                "out vec4 frag_color;\n"
+                "\n";
+            if(!luts.empty()){
+                source += "#define COLOR_LUT_SIZE " + std::to_string(COLOR_LUT_SIZE) + ".0\n";
+                for(size_t index = 0; index < luts.size(); index++) source += "uniform sampler3D color_lut" + std::to_string(index) + ";\n";
+                std::ifstream file("assets/shaders/postprocess/color-lut.glsl");
+                std::stringstream buffer;
+                buffer << file.rdbuf();
+                source += buffer.str() + "\n";
+            }
+            source += functions + "\nvoid main(){\n" + body + "    frag_color = color;\n}\n";
+            return source;
+        }
+    }
+
+    static const UniformHandle texUniform("tex");
+    static const UniformHandle lutUniforms[PostprocessChain::MAX_LUTS] = {
+        UniformHandle("color_lut0"), UniformHandle("color_lut1"), UniformHandle("color_lut2"), UniformHandle("color_lut3")
+    };
+
+    void PostprocessChain::initialize(const nlohmann::json& config, bool bakeColorLUTs, bool alwaysDraw){
+        // All the passes draw a fullscreen triangle whose vertices are generated by the vertex shader, so the vertex array is empty
+        glGenVertexArrays(1, &vertexArray);
+
+        // The passes read their input with linear filtering, so a pass drawn at a reduced resolution is smoothly upscaled by the next one
+        sampler = new Sampler();
+        sampler->set(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        sampler->set(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        sampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        sampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // We don't need to interact with the depth buffer, so it is more performant to disable the depth mask
+        pipelineState.depthMask = false;
+
+        // A path to a fragment shader is drawn as it is (this is how the postprocess was configured before the chains)
+        if(config.is_string()){
+            std::string value = config.get<std::string>();
+            if(value.size() > 5 && value.compare(value.size() - 5, 5, ".frag") == 0){
+                ShaderProgram* program = new ShaderProgram();
+                program->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
+                program->attach(value, GL_FRAGMENT_SHADER);
+                program->beginLink();
+                stages.push_back({program, 1.0f, {value}, {}});
+                effectCount = 1;
+                return;
+            }
+        }
+
+        // Otherwise, we read the list of effects (a single effect can be given without an array)
+        nlohmann::json list = config.is_array() ? config : nlohmann::json::array({config});
+        if(config.is_null()) list = nlohmann::json::array();
+        std::vector<StageDesc> descs;
+        // Whether the last pass can still receive color effects
+        bool open = false;
+        for(const auto& item : list){
+            std::string name = item.is_object() ? item.value("effect", "") : item.is_string() ? item.get<std::string>() : "";
+            const EffectInfo* effect = findEffect(name);
+            if(!effect){
+                std::cerr << "ERROR: Unknown postprocess effect: " << name << std::endl;
+                continue;
+            }
+            effectCount++;
+            if(effect->kind == EffectKind::COLOR || effect->kind == EffectKind::GRADE){
+                // A color effect is fused into the current pass (a new full resolution pass is started if there is none)
+                if(!open) descs.push_back({});
+                descs.back().colorEffects.push_back(effect);
+                open = true;
+            } else {
+                // A sampling effect must read the result of the effects before it from a texture, so it starts a new pass.
+                // The color effects after a sampling effect are fused into its pass, but a neighborhood effect is kept alone
+                // so that the effects after it are applied at the full resolution
+                bool neighborhood = effect->kind == EffectKind::NEIGHBORHOOD;
+                float scale = item.is_object() ? item.value("scale", neighborhood ? 0.5f : 1.0f) : (neighborhood ? 0.5f : 1.0f);
+                descs.push_back({effect, {}, std::clamp(scale, 0.05f, 1.0f)});
+                open = !neighborhood;
+            }
+        }
+        // The last pass draws to the back buffer at the full resolution, so a chain ending with a reduced pass needs one more pass to upscale it
+        // (the same pass copies the input when the chain has no effect but must be drawn)
+        if((descs.empty() && alwaysDraw) || (!descs.empty() && descs.back().scale < 1.0f)) descs.push_back({});
+
+        for(const StageDesc& desc : descs){
+            Stage stage;
+            stage.scale = desc.scale;
+            if(desc.head) stage.effects.push_back(desc.head->name);
+            for(const EffectInfo* effect : desc.colorEffects) stage.effects.push_back(effect->name);
+            // The name of the program (used in the error messages) lists its effects
+            std::string name = "postprocess chain (";
+            for(size_t index = 0; index < stage.effects.size(); index++) name += (index ? " + " : "") + stage.effects[index];
+            name += ")";
+            stage.program = new ShaderProgram();
+            stage.program->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
+            stage.program->attachSource(generateSource(desc, bakeColorLUTs ? vertexArray : 0, stage.luts), GL_FRAGMENT_SHADER, name);
+            stage.program->beginLink();
+            stages.push_back(stage);
+        }
+    }
+
+    void PostprocessChain::addPasses(RenderGraph& graph, RenderGraph::Resource input, RenderGraph::Resource output, glm::ivec2 size, GLenum format){
+        RenderGraph::Resource current = input;
+        for(size_t index = 0; index < stages.size(); index++){
+            const Stage& stage = stages[index];
+            RenderGraph::Resource target = output;
+            if(index + 1 < stages.size()){
+                glm::ivec2 stageSize = glm::max(glm::ivec2(glm::vec2(size) * stage.scale), glm::ivec2(1));
+                target = graph.createTarget("postprocess " + std::to_string(index), {format, stageSize});
+            }
+            graph.addPass("postprocess " + std::to_string(index), {current}, {target}, [this, index, current](const RenderGraph::PassContext& pass){
+                ShaderProgram* program = stages[index].program;
+                pipelineState.setup();
+                program->use();
+                // The input is the scene color or the target written by the previous pass (assigned by the render graph this frame)
+                Texture2D* texture = pass.getTexture(current);
+                GLStateCache::activeTexture(0);
+                texture->bind();
+                sampler->bind(0);
+                program->set(texUniform, 0);
+                // The color lookup tables are read from the next units (their filtering is set on the textures, so no sampler is bound)
+                const std::vector<Texture3D*>& luts = stages[index].luts;
+                for(size_t lut = 0; lut < luts.size(); lut++){
+                    GLuint unit = (GLuint)lut + 1;
+                    GLStateCache::activeTexture(unit);
+                    luts[lut]->bind();
+                    Sampler::unbind(unit);
+                    program->set(lutUniforms[lut], (GLint)unit);
+                }
+                GLStateCache::bindVertexArray(vertexArray);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            });
+            current = target;
+        }
+    }
+
+    void PostprocessChain::destroy(){
+        for(Stage& stage : stages){
+            delete stage.program;
+            for(Texture3D* lut : stage.luts) delete lut;
+        }
+        stages.clear();
+        effectCount = 0;
+        delete sampler;
+        sampler = nullptr;
+        if(vertexArray){
+            glDeleteVertexArrays(1, &vertexArray);
+            GLStateCache::onVertexArrayDeleted(vertexArray);
+            vertexArray = 0;
+        }
+    }
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "render-graph.hpp"
+#include "../shader/shader.hpp"
+#include "../texture/sampler.hpp"
+#include "../texture/texture3d.hpp"
+#include "../material/pipeline-state.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // The postprocess chain applies an ordered list of effects to the scene color before it is shown.
+    // The renderer config can give it as:
+    //  - the path of a fragment shader (e.g. "assets/shaders/postprocess/vignette.frag") which is drawn as a single pass,
+    //  - the name of an effect (e.g. "vignette"),
+    //  - or an array of effects where each one is a name or an object {"effect": name, "scale": s}.
+    // The effects are functions defined in "assets/shaders/postprocess/effects". There are two kinds of effects:
+    //  - per-pixel effects (sepia-tone, grayscale, two-tone, vignette) only change the color of the pixel,
+    //    the ones that don't depend on the position of the pixel either (all but vignette) are color grades,
+    //  - sampling effects (chromatic-aberration, damage, radial-blur) read the input texture around the pixel.
+    // The consecutive effects are fused into one generated shader, so the chain costs one fullscreen pass instead of one per effect:
+    // a pass starts with a sampling effect (or a plain read of the input) then applies all the following per-pixel effects.
+    // A neighborhood effect (radial-blur) reads many texels, so it gets its own pass drawn at "scale" times the window size
+    // (0.5 by default) and the following effects are fused into a new pass that reads its result.
+    // Each run of consecutive color grades in a pass is baked into a color lookup table when the chain is created (see "bakeColorLUT"),
+    // so the pass reads the table once per pixel instead of running the grades.
+    class PostprocessChain {
+    public:
+        // A fullscreen pass of the chain: its generated program and the scale of its target relative to the window
+        struct Stage {
+            ShaderProgram* program = nullptr;
+            float scale = 1.0f;
+            // The effects fused into this stage (for the statistics & debugging)
+            std::vector<std::string> effects;
+            // The color lookup tables read by the program (owned by the chain)
+            std::vector<Texture3D*> luts;
+        };
+
+    private:
+        std::vector<Stage> stages;
+        // The number of effects in the config (the chain draws "stages.size()" passes for them)
+        size_t effectCount = 0;
+        Sampler* sampler = nullptr;
+        GLuint vertexArray = 0;
+        // The passes don't need the depth buffer, so the depth test and the depth writes are disabled
+        PipelineState pipelineState;
+
+    public:
+        // The maximum number of color lookup tables read by a pass (the other grades of the pass are called directly)
+        static constexpr size_t MAX_LUTS = 4;
+
+        // Reads the effects from the "postprocess" value of the renderer config and creates the programs of the chain
+        // (their links are started but not finished, see ShaderProgram::beginLink). If "bakeColorLUTs" is false, the grades are never baked.
+        // If "alwaysDraw" is true, a chain without effects still has a pass that copies (and scales) the input to the output
+        void initialize(const nlohmann::json& config, bool bakeColorLUTs = true, bool alwaysDraw = false);
+        void destroy();
+
+        // Returns true if the chain has at least one pass
+        bool isEnabled() const { return !stages.empty(); }
+        // Declares the passes of the chain in the render graph: the first one reads "input" and the last one writes to "output",
+        // the passes in between write to transient targets of the given format (scaled from "size")
+        void addPasses(RenderGraph& graph, RenderGraph::Resource input, RenderGraph::Resource output, glm::ivec2 size, GLenum format = GL_RGBA8);
+
+        const std::vector<Stage>& getStages() const { return stages; }
+        size_t getEffectCount() const { return effectCount; }
+        // Returns the number of color lookup tables read by the passes
+        size_t getLUTCount() const {
+            size_t count = 0;
+            for(const Stage& stage : stages) count += stage.luts.size();
+            return count;
+        }
+    };
+
+}
@@ -0,0 +1,182 @@
+#include "render-graph.hpp"
+#include "../texture/texture-utils.hpp"
+#include "../gl-state-cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace our {
+
+    Texture2D* RenderGraph::PassContext::getTexture(Resource resource) const {
+        const ResourceNode& node = graph->resources[resource];
+        if(node.imported) return nullptr;
+        return graph->pool[node.target].texture;
+    }
+
+    void RenderGraph::reset(){
+        resources.clear();
+        passes.clear();
+    }
+
+    RenderGraph::Resource RenderGraph::importBackbuffer(glm::ivec2 size){
+        ResourceNode node;
+        node.name = "backbuffer";
+        node.desc.size = size;
+        node.imported = true;
+        resources.push_back(node);
+        return (Resource)resources.size() - 1;
+    }
+
+    RenderGraph::Resource RenderGraph::createTarget(const std::string& name, const RenderTargetDesc& desc){
+        ResourceNode node;
+        node.name = name;
+        node.desc = desc;
+        resources.push_back(node);
+        return (Resource)resources.size() - 1;
+    }
+
+    void RenderGraph::addPass(const std::string& name, const std::vector<Resource>& reads, const std::vector<Resource>& writes, PassFunction function){
+        // A pass can only read the targets written by the passes declared before it
+        for(Resource read : reads) assert(std::find(writes.begin(), writes.end(), read) == writes.end());
+        passes.push_back({name, reads, writes, std::move(function)});
+    }
+
+    void RenderGraph::compile(){
+        // First, the passes are culled from the last to the first: a pass is needed if it writes to the back buffer
+        // or to a target read by a needed pass (the passes after it were already visited, so their reads are known)
+        std::vector<bool> needed(resources.size(), false);
+        executedPasses = culledPasses = 0;
+        for(int index = (int)passes.size() - 1; index >= 0; index--){
+            PassNode& pass = passes[index];
+            pass.culled = std::none_of(pass.writes.begin(), pass.writes.end(), [&](Resource write){
+                return resources[write].imported || needed[write];
+            });
+            if(pass.culled){
+                culledPasses++;
+                continue;
+            }
+            executedPasses++;
+            for(Resource read : pass.reads) needed[read] = true;
+        }
+
+        // Then we find the first and the last pass that use each resource
+        for(int index = 0; index < (int)passes.size(); index++){
+            if(passes[index].culled) continue;
+            auto use = [&](Resource resource){
+                ResourceNode& node = resources[resource];
+                if(node.firstPass < 0) node.firstPass = index;
+                node.lastPass = index;
+            };
+            for(Resource read : passes[index].reads) use(read);
+            for(Resource write : passes[index].writes) use(write);
+        }
+
+        // The pooled textures that were not used for a few frames are released
+        // (this is done before assigning the targets since it changes the indices of the pool)
+        bool released = false;
+        for(size_t index = 0; index < pool.size();){
+            PooledTarget& target = pool[index];
+            target.idleFrames = target.usedThisFrame ? 0 : target.idleFrames + 1;
+            target.usedThisFrame = false;
+            target.busyUntil = -1;
+            if(target.idleFrames > maxIdleFrames){
+                if(!released) deleteFramebuffers();
+                released = true;
+                delete target.texture;
+                pool.erase(pool.begin() + index);
+            } else {
+                index++;
+            }
+        }
+
+        // Finally, the transient targets are assigned to pooled textures in the order of their first use.
+        // A texture is free once the last pass using its current target is done, so a later target with the same format & size can alias it
+        std::vector<Resource> order(resources.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](Resource a, Resource b){ return resources[a].firstPass < resources[b].firstPass; });
+        aliasedTargets = 0;
+        for(Resource resource : order){
+            ResourceNode& node = resources[resource];
+            if(node.imported || node.firstPass < 0) continue;
+            auto free = std::find_if(pool.begin(), pool.end(), [&](const PooledTarget& target){
+                return target.desc == node.desc && target.busyUntil < node.firstPass;
+            });
+            if(free == pool.end()){
+                // Render targets are never sampled with mipmaps, so they only have a single level
+                PooledTarget target;
+                target.desc = node.desc;
+                target.texture = texture_utils::empty(node.desc.format, node.desc.size);
+                pool.push_back(target);
+                free = pool.end() - 1;
+            } else if(free->usedThisFrame){
+                aliasedTargets++;
+            }
+            free->busyUntil = node.lastPass;
+            free->usedThisFrame = true;
+            node.target = (size_t)(free - pool.begin());
+        }
+    }
+
+    GLuint RenderGraph::getFramebuffer(const std::vector<Resource>& outputs){
+        std::vector<GLuint> key;
+        for(Resource output : outputs){
+            // A pass drawing to the back buffer uses the default framebuffer
+            if(resources[output].imported) return 0;
+            key.push_back(pool[resources[output].target].texture->getOpenGLName());
+        }
+        auto it = framebuffers.find(key);
+        if(it != framebuffers.end()) return it->second;
+
+        GLuint framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        GLStateCache::bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        std::vector<GLenum> drawBuffers;
+        for(size_t index = 0; index < outputs.size(); index++){
+            const RenderTargetDesc& desc = resources[outputs[index]].desc;
+            if(desc.isDepth()){
+                GLenum attachment = (desc.format == GL_DEPTH24_STENCIL8 || desc.format == GL_DEPTH32F_STENCIL8) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+                glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, attachment, GL_TEXTURE_2D, key[index], 0);
+            } else {
+                GLenum attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+                glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, attachment, GL_TEXTURE_2D, key[index], 0);
+                drawBuffers.push_back(attachment);
+            }
+        }
+        // A depth only pass has no color attachment so it must not draw to any color buffer
+        if(drawBuffers.empty()) glDrawBuffer(GL_NONE);
+        else glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+        framebuffers[key] = framebuffer;
+        return framebuffer;
+    }
+
+    void RenderGraph::execute(){
+        compile();
+        PassContext context(this);
+        for(PassNode& pass : passes){
+            if(pass.culled) continue;
+            GLStateCache::bindFramebuffer(GL_DRAW_FRAMEBUFFER, getFramebuffer(pass.writes));
+            if(!pass.writes.empty()){
+                glm::ivec2 size = resources[pass.writes.front()].desc.size;
+                glViewport(0, 0, size.x, size.y);
+            }
+            pass.function(context);
+        }
+    }
+
+    void RenderGraph::deleteFramebuffers(){
+        for(auto& [key, framebuffer] : framebuffers){
+            glDeleteFramebuffers(1, &framebuffer);
+            GLStateCache::onFramebufferDeleted(framebuffer);
+        }
+        framebuffers.clear();
+    }
+
+    void RenderGraph::destroy(){
+        deleteFramebuffers();
+        for(PooledTarget& target : pool) delete target.texture;
+        pool.clear();
+        reset();
+    }
+
+}
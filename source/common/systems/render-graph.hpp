@@ -0,0 +1,114 @@
+#pragma once
+
+#include "../texture/texture2d.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // The format and the size of a render target
+    struct RenderTargetDesc {
+        GLenum format = GL_RGBA8;
+        glm::ivec2 size = {1, 1};
+
+        bool operator==(const RenderTargetDesc& other) const { return format == other.format && size == other.size; }
+        bool isDepth() const {
+            return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F ||
+                format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+        }
+    };
+
+    // A render graph describes the passes of a frame and the render targets they read and write.
+    // The passes and the targets are declared again every frame (declaring them is cheap), then "execute":
+    // 1- culls the passes whose outputs are never read (a pass writing to the back buffer is always kept),
+    // 2- finds the first and last pass using each transient target and assigns the targets to textures taken from a pool,
+    //    two targets whose lifetimes don't overlap share the same texture if they have the same format and size,
+    // 3- runs the passes in the order they were declared (a pass can only read targets written by the passes before it)
+    //    after binding a framebuffer with its outputs and setting the viewport to their size.
+    // OpenGL makes the writes of a framebuffer visible to the texture reads of the next draws by itself, so ordering the passes
+    // (and never reading a target in the pass that writes it) is all that is needed between them.
+    // The textures of the pool and the framebuffers are kept between frames, so a frame that declares the same graph allocates nothing.
+    class RenderGraph {
+    public:
+        // A handle to a render target declared in the current frame
+        using Resource = int;
+        static constexpr Resource INVALID_RESOURCE = -1;
+
+        // Passed to the function of a pass when it runs
+        class PassContext {
+            friend class RenderGraph;
+            const RenderGraph* graph;
+            PassContext(const RenderGraph* graph) : graph(graph) {}
+        public:
+            // Returns the texture assigned to a target read by the pass
+            Texture2D* getTexture(Resource resource) const;
+        };
+        using PassFunction = std::function<void(const PassContext&)>;
+
+    private:
+        struct ResourceNode {
+            std::string name;
+            RenderTargetDesc desc;
+            bool imported = false; // The back buffer is imported (it is not a texture and it is never aliased)
+            int firstPass = -1, lastPass = -1;
+            size_t target = 0; // The index of the pooled texture assigned to this resource
+        };
+        struct PassNode {
+            std::string name;
+            std::vector<Resource> reads, writes;
+            PassFunction function;
+            bool culled = false;
+        };
+        // A texture of the pool. "busyUntil" is the last pass (of the current frame) that uses the resource it is assigned to
+        struct PooledTarget {
+            RenderTargetDesc desc;
+            Texture2D* texture = nullptr;
+            int busyUntil = -1;
+            bool usedThisFrame = false;
+            int idleFrames = 0;
+        };
+
+        std::vector<ResourceNode> resources;
+        std::vector<PassNode> passes;
+        std::vector<PooledTarget> pool;
+        // The framebuffers created for each combination of attachments (the key is the list of texture names)
+        std::map<std::vector<GLuint>, GLuint> framebuffers;
+        // The pooled textures that were not used for this number of frames are deleted
+        int maxIdleFrames = 3;
+        // The number of executed and culled passes, and the number of transient targets that reused the texture of another target
+        size_t executedPasses = 0, culledPasses = 0, aliasedTargets = 0;
+
+        // Culls the passes, computes the lifetimes of the resources and assigns them to pooled textures
+        void compile();
+        // Returns the framebuffer whose attachments are the given outputs
+        GLuint getFramebuffer(const std::vector<Resource>& outputs);
+        // Deletes the framebuffers (the framebuffers using a texture must be deleted before the texture)
+        void deleteFramebuffers();
+
+    public:
+        // Starts declaring the passes of a new frame (the resources and the passes of the last frame are forgotten)
+        void reset();
+        // Declares the back buffer (the default framebuffer) with the given size. It is never culled
+        Resource importBackbuffer(glm::ivec2 size);
+        // Declares a transient render target that only lives during the frame
+        Resource createTarget(const std::string& name, const RenderTargetDesc& desc);
+        // Declares a pass. "reads" are the targets it samples and "writes" are the targets it draws to
+        // (all of them are attached to its framebuffer, so a pass writes either to the back buffer or to textures)
+        void addPass(const std::string& name, const std::vector<Resource>& reads, const std::vector<Resource>& writes, PassFunction function);
+        // Compiles the graph then runs its passes
+        void execute();
+        // Deletes all the pooled textures and the framebuffers
+        void destroy();
+
+        size_t getExecutedPassCount() const { return executedPasses; }
+        size_t getCulledPassCount() const { return culledPasses; }
+        size_t getPooledTargetCount() const { return pool.size(); }
+        size_t getAliasedTargetCount() const { return aliasedTargets; }
+    };
+
+}
@@ -0,0 +1,129 @@
+#include "render-list.hpp"
+
+#include <algorithm>
+
+namespace our {
+
+    // Removes the pair whose entity is the given one (the order of the others is kept so the first camera stays the same)
+    template<typename T>
+    static void erasePair(std::vector<std::pair<Entity*, T*>>& pairs, Entity* entity){
+        pairs.erase(std::remove_if(pairs.begin(), pairs.end(), [&](const auto& pair){ return pair.first == entity; }), pairs.end());
+    }
+
+    // Adds, replaces or removes the pair of the given entity so it holds the given component (or nothing if it is null)
+    template<typename T>
+    static void syncPair(std::vector<std::pair<Entity*, T*>>& pairs, Entity* entity, T* component){
+        auto it = std::find_if(pairs.begin(), pairs.end(), [&](const auto& pair){ return pair.first == entity; });
+        if(it != pairs.end()){
+            if(component) it->second = component;
+            else pairs.erase(it);
+        } else if(component) {
+            pairs.emplace_back(entity, component);
+        }
+    }
+
+    void RenderList::refresh(Item& item){
+        RenderCommand& command = item.command;
+        command.localToWorld = item.entity->getLocalToWorldMatrix();
+        command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
+        command.mesh = item.meshRenderer->mesh;
+        command.material = item.meshRenderer->material;
+        command.tint = item.meshRenderer->tint;
+        command.id = item.meshRenderer;
+        updatedCount++;
+    }
+
+    void RenderList::addItem(Entity* entity, MeshRendererComponent* meshRenderer){
+        Item item;
+        item.entity = entity;
+        item.meshRenderer = meshRenderer;
+        for(Entity* ancestor = entity->parent; ancestor; ancestor = ancestor->parent){
+            item.ancestors.push_back(ancestor);
+            dependents[ancestor].push_back(entity);
+        }
+        refresh(item);
+        itemIndices[entity] = items.size();
+        items.push_back(std::move(item));
+    }
+
+    void RenderList::removeItem(Entity* entity){
+        auto it = itemIndices.find(entity);
+        if(it == itemIndices.end()) return;
+        size_t index = it->second;
+        itemIndices.erase(it);
+        for(Entity* ancestor : items[index].ancestors){
+            auto found = dependents.find(ancestor);
+            if(found == dependents.end()) continue;
+            auto& list = found->second;
+            list.erase(std::remove(list.begin(), list.end(), entity), list.end());
+            if(list.empty()) dependents.erase(found);
+        }
+        // The last item takes the place of the removed one so the removal doesn't shift the whole list
+        if(index != items.size() - 1){
+            items[index] = std::move(items.back());
+            itemIndices[items[index].entity] = index;
+        }
+        items.pop_back();
+    }
+
+    void RenderList::sync(Entity* entity){
+        // The objects merged into a static batch are drawn with their batch instead
+        auto meshRenderer = entity->getComponent<MeshRendererComponent>();
+        if(meshRenderer && (meshRenderer->staticBatched || !meshRenderer->mesh || !meshRenderer->material)) meshRenderer = nullptr;
+        auto it = itemIndices.find(entity);
+        if(it != itemIndices.end()){
+            Item& item = items[it->second];
+            // If the entity was moved to another parent, the item is recreated to update its ancestors
+            bool sameParent = item.ancestors.empty() ? entity->parent == nullptr : item.ancestors.front() == entity->parent;
+            if(meshRenderer == item.meshRenderer && sameParent) refresh(item);
+            else {
+                removeItem(entity);
+                if(meshRenderer) addItem(entity, meshRenderer);
+            }
+        } else if(meshRenderer) {
+            addItem(entity, meshRenderer);
+        }
+        syncPair(cameras, entity, entity->getComponent<CameraComponent>());
+        syncPair(lightEntries, entity, entity->getComponent<LightComponent>());
+    }
+
+    void RenderList::forget(Entity* entity){
+        removeItem(entity);
+        dependents.erase(entity);
+        erasePair(cameras, entity);
+        erasePair(lightEntries, entity);
+    }
+
+    void RenderList::rebuild(){
+        items.clear();
+        itemIndices.clear();
+        dependents.clear();
+        cameras.clear();
+        lightEntries.clear();
+        for(auto entity : world->getEntities()) sync(entity);
+    }
+
+    void RenderList::update(World* world){
+        updatedCount = 0;
+        // The changes are always taken so the world doesn't keep them after a rebuild
+        world->takeChanges(added, changed, removed);
+        if(dirty || world != this->world){
+            this->world = world;
+            dirty = false;
+            rebuild();
+        } else {
+            for(Entity* entity : removed) forget(entity);
+            for(Entity* entity : added) sync(entity);
+            for(Entity* entity : changed){
+                sync(entity);
+                // The entities below a changed entity moved with it
+                if(auto it = dependents.find(entity); it != dependents.end()){
+                    for(Entity* dependent : it->second) refresh(items[itemIndices[dependent]]);
+                }
+            }
+        }
+        lights.clear();
+        for(auto& [entity, light] : lightEntries) lights.push_back(light);
+    }
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../ecs/world.hpp"
+#include "../components/camera.hpp"
+#include "../components/mesh-renderer.hpp"
+#include "../components/light.hpp"
+#include "render-queue.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace our {
+
+    // The render list keeps a render command for every mesh renderer of the world between frames.
+    // Instead of scanning all the entities and recomputing their matrices every frame, it reads the changes recorded by the world:
+    // a command is created when its entity is added, recomputed when its entity (or one of its ancestors) is marked as changed
+    // and removed when its entity is deleted. So the work done every frame depends on what changed, not on the size of the scene.
+    // The cameras and the lights are tracked the same way (their matrices are still read every frame since they are few).
+    class RenderList {
+    public:
+        struct Item {
+            Entity* entity = nullptr;
+            MeshRendererComponent* meshRenderer = nullptr;
+            RenderCommand command;
+            // The ancestors of the entity when the item was created (their changes move the entity too)
+            std::vector<Entity*> ancestors;
+        };
+
+    private:
+        World* world = nullptr;
+        bool dirty = true; // If true, the list is rebuilt from all the entities of the world on the next update
+        std::vector<Item> items;
+        std::unordered_map<Entity*, size_t> itemIndices; // The index of the item of each entity in "items"
+        // For each entity, the entities below it in the hierarchy that have an item
+        std::unordered_map<Entity*, std::vector<Entity*>> dependents;
+        std::vector<std::pair<Entity*, CameraComponent*>> cameras;
+        std::vector<std::pair<Entity*, LightComponent*>> lightEntries;
+        std::vector<LightComponent*> lights;
+        // The changes taken from the world (kept here to avoid reallocating them every frame)
+        std::vector<Entity*> added, changed, removed;
+        size_t updatedCount = 0;
+
+        // Makes the items, cameras and lights of the entity match its current components
+        void sync(Entity* entity);
+        // Forgets everything stored about a deleted entity (the pointer is only compared, never used)
+        void forget(Entity* entity);
+        void addItem(Entity* entity, MeshRendererComponent* meshRenderer);
+        void removeItem(Entity* entity);
+        // Recomputes the command of the item from its mesh renderer and the current transform of its entity
+        void refresh(Item& item);
+        void rebuild();
+
+    public:
+        // Applies the changes of the world since the last update (the first update or a new world rebuilds the whole list)
+        void update(World* world);
+        // Forces a full rebuild on the next update (e.g. after the static batches are built since some objects are no longer drawn alone)
+        void reset() { dirty = true; }
+
+        const std::vector<Item>& getItems() const { return items; }
+        // Returns the first camera found in the world (or null if there is none)
+        CameraComponent* getCamera() const { return cameras.empty() ? nullptr : cameras.front().second; }
+        const std::vector<LightComponent*>& getLights() const { return lights; }
+        // The entities removed from the world before the last update (they are deleted so the pointers must only be compared)
+        const std::vector<Entity*>& getRemoved() const { return removed; }
+        // The number of commands created or recomputed by the last update
+        size_t getUpdatedCount() const { return updatedCount; }
+    };
+
+}
@@ -0,0 +1,157 @@
+#include "render-queue.hpp"
+#include "../job-system.hpp"
+#include "../material/material-table.hpp"
+
+#include <algorithm>
+
+namespace our {
+
+    // The queues with fewer entries are sorted on the calling thread (the parallel sort synchronizes 16 times, which isn't free)
+    static constexpr size_t PARALLEL_SORT_MIN_SIZE = 16384;
+    // The number of entries counted and scattered by each chunk of the parallel sort
+    static constexpr size_t SORT_CHUNK_SIZE = 4096;
+
+    // Keeps the lowest "bits" bits of the given value and shifts them to the given position
+    static std::uint64_t field(std::uint64_t value, int bits, int shift){
+        return (value & ((std::uint64_t(1) << bits) - 1)) << shift;
+    }
+
+    std::uint64_t RenderQueue::makeKey(const RenderCommand& command, RenderPass pass, float depth01) const {
+        depth01 = glm::clamp(depth01, 0.0f, 1.0f);
+        std::uint64_t key = field((std::uint64_t)pass, 3, 61);
+        // The id shared by the equal pipeline states is assigned when the material is added to the table (on the main thread while loading),
+        // so the keys can be computed by the workers without touching any shared registry
+        std::uint64_t pipelineState = MaterialTable::get(command.material->getTableIndex()).pipelineStateId;
+        std::uint64_t shader = command.material->shader->getSortId();
+        // The materials that can share draws have the same batch id so their commands are sorted by mesh together
+        std::uint64_t material = command.material->getBatchId();
+        if(pass != RenderPass::TRANSPARENT_PASS || !orderedTransparency){
+            // Near objects get smaller keys so the opaque objects are drawn front to back
+            std::uint64_t depth = (std::uint64_t)(depth01 * 65535.0f);
+            key |= field(pipelineState, 8, 53) | field(shader, 12, 41) | field(material, 13, 28);
+            key |= field(command.mesh->getSortId(), 12, 16) | field(depth, 16, 0);
+        } else {
+            // Far objects get smaller keys so the transparent objects are drawn back to front
+            std::uint64_t depth = 0xFFFFFFFFull - (std::uint64_t)((double)depth01 * 4294967295.0);
+            key |= field(depth, 32, 29) | field(pipelineState, 8, 21) | field(shader, 9, 12) | field(material, 12, 0);
+        }
+        return key;
+    }
+
+    void RenderQueue::clear(){
+        commands.clear();
+        entries.clear();
+        sorted = true;
+    }
+
+    void RenderQueue::push(const RenderCommand& command, RenderPass pass, float depth, float near, float far){
+        float depth01 = far > near ? (depth - near) / (far - near) : 0.0f;
+        entries.push_back({makeKey(command, pass, depth01), (std::uint32_t)commands.size()});
+        commands.push_back(command);
+        sorted = false;
+    }
+
+    size_t RenderQueue::append(size_t count){
+        size_t first = entries.size();
+        entries.resize(first + count);
+        commands.resize(first + count);
+        if(count > 0) sorted = false;
+        return first;
+    }
+
+    void RenderQueue::set(size_t slot, const RenderCommand& command, RenderPass pass, float depth, float near, float far){
+        float depth01 = far > near ? (depth - near) / (far - near) : 0.0f;
+        entries[slot] = {makeKey(command, pass, depth01), (std::uint32_t)slot};
+        commands[slot] = command;
+    }
+
+    void RenderQueue::sort(){
+        if(sorted) return;
+        sorted = true;
+        if(entries.size() >= PARALLEL_SORT_MIN_SIZE && JobSystem::get().getThreadCount() > 1){
+            parallelSort();
+            return;
+        }
+        // Small queues are faster to sort using a comparison sort
+        if(entries.size() < 64){
+            std::sort(entries.begin(), entries.end(), [](const Entry& first, const Entry& second){ return first.key < second.key; });
+            return;
+        }
+
+        // A least significant digit radix sort that processes the keys 8 bits at a time
+        // The histograms of all the 8 digits are computed in a single pass over the keys
+        std::uint32_t histograms[8][256] = {};
+        for(const Entry& entry : entries)
+            for(int digit = 0; digit < 8; digit++)
+                histograms[digit][(entry.key >> (digit * 8)) & 0xFF]++;
+
+        scratch.resize(entries.size());
+        for(int digit = 0; digit < 8; digit++){
+            std::uint32_t* histogram = histograms[digit];
+            // If all the keys have the same value for this digit, this pass wouldn't change the order so we skip it
+            // (this is common since most of the ids are small and only use the lower bits of their fields)
+            if(histogram[(entries[0].key >> (digit * 8)) & 0xFF] == entries.size()) continue;
+            // Turn the counts into the offsets at which each bucket starts
+            std::uint32_t offset = 0;
+            for(int bucket = 0; bucket < 256; bucket++){
+                std::uint32_t count = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += count;
+            }
+            // Then scatter the entries into their buckets (keeping their relative order so the sort stays stable)
+            for(const Entry& entry : entries)
+                scratch[histogram[(entry.key >> (digit * 8)) & 0xFF]++] = entry;
+            entries.swap(scratch);
+        }
+    }
+
+    void RenderQueue::parallelSort(){
+        // The same least significant digit radix sort as "sort" where each pass is split into chunks:
+        // every chunk counts its digits, then the chunks scatter their entries at the offsets that the chunks before them leave free.
+        // The chunks are scattered in order and each chunk keeps the order of its entries, so the sort stays stable.
+        JobSystem& jobs = JobSystem::get();
+        size_t count = entries.size();
+        size_t chunkCount = JobSystem::getChunkCount(count, SORT_CHUNK_SIZE);
+        chunkCounts.resize(chunkCount);
+        scratch.resize(count);
+
+        // Find the digits whose value differs between the keys (the others are skipped like in "sort"):
+        // a digit is needed if some key has a different value for it than the first key
+        std::vector<std::uint64_t> chunkDifferences(chunkCount, 0);
+        std::uint64_t firstKey = entries[0].key;
+        jobs.parallelFor(count, SORT_CHUNK_SIZE, [&](size_t begin, size_t end){
+            std::uint64_t difference = 0;
+            for(size_t i = begin; i < end; i++) difference |= entries[i].key ^ firstKey;
+            chunkDifferences[begin / SORT_CHUNK_SIZE] = difference;
+        });
+        std::uint64_t difference = 0;
+        for(std::uint64_t chunkDifference : chunkDifferences) difference |= chunkDifference;
+
+        for(int digit = 0; digit < 8; digit++){
+            int shift = digit * 8;
+            if(((difference >> shift) & 0xFF) == 0) continue;
+            // Count the digits of each chunk
+            jobs.parallelFor(count, SORT_CHUNK_SIZE, [&](size_t begin, size_t end){
+                auto& counts = chunkCounts[begin / SORT_CHUNK_SIZE];
+                counts.fill(0);
+                for(size_t i = begin; i < end; i++) counts[(entries[i].key >> shift) & 0xFF]++;
+            });
+            // Turn the counts into the offsets at which each chunk writes each bucket (bucket by bucket, then chunk by chunk)
+            std::uint32_t offset = 0;
+            for(int bucket = 0; bucket < 256; bucket++){
+                for(auto& counts : chunkCounts){
+                    std::uint32_t bucketCount = counts[bucket];
+                    counts[bucket] = offset;
+                    offset += bucketCount;
+                }
+            }
+            // Then scatter the entries of each chunk
+            jobs.parallelFor(count, SORT_CHUNK_SIZE, [&](size_t begin, size_t end){
+                auto& offsets = chunkCounts[begin / SORT_CHUNK_SIZE];
+                for(size_t i = begin; i < end; i++) scratch[offsets[(entries[i].key >> shift) & 0xFF]++] = entries[i];
+            });
+            entries.swap(scratch);
+        }
+    }
+
+}
\ No newline at end of file
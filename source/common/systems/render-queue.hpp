@@ -0,0 +1,94 @@
+#pragma once
+
+#include "../mesh/mesh.hpp"
+#include "../material/material.hpp"
+
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace our
+{
+
+    // The render command stores command that tells the renderer that it should draw
+    // the given mesh at the given localToWorld matrix using the given material
+    // The renderer will fill this struct using the mesh renderer components
+    struct RenderCommand {
+        glm::mat4 localToWorld;
+        glm::vec3 center;
+        Mesh* mesh;
+        Material* material;
+        glm::vec4 tint;
+        const void* id; // Identifies the drawn object across frames (its mesh renderer or its static batch)
+    };
+
+    // The passes of the render queue in the order in which they are drawn
+    // The lit opaque objects drawn to the G-buffer by the deferred renderer come first (the forward renderer doesn't use this pass).
+    // The opaque objects whose depth was written by the depth pre-pass are drawn after the other opaque objects
+    // and the opaque objects tested for occlusion are drawn after all of them (so all their potential occluders are already drawn)
+    enum class RenderPass : std::uint8_t {
+        DEFERRED_PASS = 0,
+        OPAQUE_PASS = 1,
+        PREPASSED_OPAQUE_PASS = 2,
+        OCCLUSION_TESTED_PASS = 3,
+        TRANSPARENT_PASS = 4
+    };
+
+    // A render queue collects the render commands of a frame with a 64-bit sort key each, then sorts them using a radix sort.
+    // The key of an opaque command (of both opaque passes) is (from the most significant bits):
+    //  [pass: 3][pipeline state: 8][shader: 12][material: 13][mesh: 12][depth: 16]
+    // so the opaque draws are grouped by state (to minimize the state changes) then drawn front to back (to help the early depth test).
+    // The key of a transparent command is:
+    //  [pass: 3][inverted depth: 32][pipeline state: 8][shader: 9][material: 12]
+    // since transparent draws must stay ordered from back to front, the state only breaks the ties.
+    // If the transparency doesn't depend on the order (see "setOrderedTransparency"), the transparent commands use the key of the opaque ones.
+    // Ids that don't fit in their field wrap around, which can only make the grouping less perfect (never the pass or depth order wrong).
+    class RenderQueue {
+        // A key and the index of its command in "commands"
+        struct Entry {
+            std::uint64_t key;
+            std::uint32_t index;
+        };
+        std::vector<RenderCommand> commands;
+        // The entries are sorted in place, "scratch" is the second buffer needed by the radix sort
+        // Both are kept between frames to avoid reallocating them
+        std::vector<Entry> entries, scratch;
+        // The digit counts of each chunk of entries used by the parallel sort
+        std::vector<std::array<std::uint32_t, 256>> chunkCounts;
+        bool sorted = true;
+        // Whether the transparent commands must be drawn from back to front
+        bool orderedTransparency = true;
+
+        // Sorts the entries using the job system (each pass counts and scatters the chunks of entries in parallel)
+        void parallelSort();
+
+    public:
+        // Removes all the commands (should be called at the start of every frame)
+        void clear();
+        // Adds a command with the given pass. "depth" is the distance from the camera along its forward direction
+        // and "near" & "far" are the range of depths that the key can distinguish
+        void push(const RenderCommand& command, RenderPass pass, float depth, float near, float far);
+        // Adds "count" empty slots at the end of the queue and returns the index of the first one.
+        // The slots must then be filled using "set", which can be called from several threads as long as they fill different slots
+        size_t append(size_t count);
+        // Fills a slot returned by "append" (the arguments are the same as "push")
+        void set(size_t slot, const RenderCommand& command, RenderPass pass, float depth, float near, float far);
+        // Sorts the commands by their keys (large queues are sorted using the job system)
+        void sort();
+        // If false, the transparent commands are grouped by state like the opaque ones instead of being sorted from back to front
+        // (used with the weighted blended transparency whose result doesn't depend on the order of the draws)
+        void setOrderedTransparency(bool ordered){ orderedTransparency = ordered; }
+
+        // The number of commands in the queue
+        size_t size() const { return entries.size(); }
+        // Returns the i-th command in the sorted order (the queue must be sorted first)
+        const RenderCommand& operator[](size_t i) const { return commands[entries[i].index]; }
+        // Returns the pass of the i-th command in the sorted order
+        RenderPass getPass(size_t i) const { return (RenderPass)(entries[i].key >> 61); }
+
+        // Builds the sort key of a command. "depth01" is the depth of the command mapped to [0, 1]
+        std::uint64_t makeKey(const RenderCommand& command, RenderPass pass, float depth01) const;
+    };
+
+}
@@ -0,0 +1,192 @@
+#include "static-batcher.hpp"
+#include "../components/movement.hpp"
+#include "../components/camera.hpp"
+#include "../components/free-camera-controller.hpp"
+
+#include <map>
+#include <unordered_set>
+#include <tuple>
+
+namespace our {
+
+    bool StaticBatcher::isStatic(Entity* entity){
+        // The transform of an entity is relative to its parent, so it moves if any of its ancestors moves
+        for(Entity* current = entity; current; current = current->parent){
+            if(current->getComponent<MovementComponent>()) return false;
+            if(current->getComponent<CameraComponent>()) return false;
+            if(current->getComponent<FreeCameraControllerComponent>()) return false;
+        }
+        return true;
+    }
+
+    const StaticBatcher::Geometry& StaticBatcher::getGeometry(Mesh* mesh){
+        auto it = geometries.find(mesh);
+        if(it != geometries.end()) return it->second;
+        Geometry& geometry = geometries[mesh];
+        mesh->read(geometry.vertices, geometry.elements);
+        return geometry;
+    }
+
+    void StaticBatcher::merge(Batch& batch){
+        auto merged = std::make_shared<Geometry>();
+        batch.bounds = BoundingBox();
+        for(Object& object : batch.objects){
+            // The vertices are moved to the world space (the normals are transformed using the inverse transpose)
+            glm::mat3 M_IT = glm::transpose(glm::inverse(glm::mat3(object.M)));
+            unsigned int firstVertex = (unsigned int)merged->vertices.size();
+            for(Vertex vertex : object.geometry->vertices){
+                vertex.position = glm::vec3(object.M * glm::vec4(vertex.position, 1.0f));
+                vertex.normal = glm::normalize(M_IT * vertex.normal);
+                // The tint of the object is baked into the vertex colors since the whole batch is drawn with a white tint
+                vertex.color = Color(glm::clamp(glm::vec4(vertex.color) * object.tint, 0.0f, 255.0f));
+                batch.bounds.expand(vertex.position);
+                merged->vertices.push_back(vertex);
+            }
+            // The range of the elements of the object is kept so they can be cleared if it is removed
+            object.firstElement = (GLsizei)merged->elements.size();
+            object.elementCount = (GLsizei)object.geometry->elements.size();
+            for(unsigned int element : object.geometry->elements)
+                merged->elements.push_back(firstVertex + element);
+        }
+        // The snapshots that still point to the previous geometry keep it alive until they are drawn
+        batch.merged = merged;
+        batch.hidden = std::make_shared<std::vector<ElementRange>>();
+        batch.hiddenElements = 0;
+        batch.revision++;
+    }
+
+    void StaticBatcher::build(World* world, float cellSize){
+        destroy();
+
+        // Group the static objects by material then by cell (a map is used so the batches are always created in the same order)
+        std::map<std::tuple<Material*, int, int, int>, size_t> batchIndices;
+        for(auto entity : world->getEntities()){
+            auto meshRenderer = entity->getComponent<MeshRendererComponent>();
+            if(!meshRenderer) continue;
+            meshRenderer->staticBatched = false;
+            if(!meshRenderer->mesh || !meshRenderer->material) continue;
+            // Transparent objects must be sorted from back to front one by one, so they can't be merged
+            if(meshRenderer->material->transparent || !isStatic(entity)) continue;
+
+            glm::mat4 M = entity->getLocalToWorldMatrix();
+            glm::vec3 center = meshRenderer->mesh->getBounds().transformed(M).getCenter();
+            glm::ivec3 cell = glm::ivec3(glm::floor(center / cellSize));
+            auto key = std::make_tuple(meshRenderer->material, cell.x, cell.y, cell.z);
+            auto it = batchIndices.find(key);
+            if(it == batchIndices.end()){
+                it = batchIndices.emplace(key, batches.size()).first;
+                Batch batch;
+                batch.id = nextBatchId++;
+                batch.material = meshRenderer->material;
+                batch.cell = cell;
+                batches.push_back(batch);
+            }
+            Batch& batch = batches[it->second];
+            Object object;
+            object.entity = entity;
+            object.geometry = &getGeometry(meshRenderer->mesh);
+            object.M = M;
+            object.tint = meshRenderer->tint;
+            batch.objects.push_back(object);
+            meshRenderer->staticBatched = true;
+            objectCount++;
+        }
+
+        for(Batch& batch : batches) merge(batch);
+        // The source geometry is kept since it is needed to merge the batches again when their entities are deleted
+    }
+
+    void StaticBatcher::update(const std::vector<Entity*>& removed){
+        // Nothing to do unless some entities were deleted since the last check
+        if(removed.empty() || batches.empty()) return;
+
+        std::unordered_set<Entity*> removedSet(removed.begin(), removed.end());
+        for(size_t index = 0; index < batches.size();){
+            Batch& batch = batches[index];
+            // Remove the objects whose entities are no longer in the world (the pointers are only compared, never used).
+            // Their ranges are added to the hidden ranges, so the render thread only clears them instead of uploading the whole cell again
+            std::vector<ElementRange> hidden;
+            size_t kept = 0;
+            for(size_t i = 0; i < batch.objects.size(); i++){
+                const Object& object = batch.objects[i];
+                if(removedSet.find(object.entity) != removedSet.end()){
+                    hidden.push_back({object.firstElement, object.elementCount});
+                    batch.hiddenElements += object.elementCount;
+                    continue;
+                }
+                batch.objects[kept++] = object;
+            }
+            if(kept != batch.objects.size()){
+                objectCount -= batch.objects.size() - kept;
+                batch.objects.resize(kept);
+                // The degenerate triangles still cost vertex work, so the batch is merged again once they are the majority
+                if(kept > 0 && batch.hiddenElements * 2 > (GLsizei)batch.merged->elements.size()){
+                    merge(batch);
+                } else {
+                    // The hidden ranges of a snapshot never change, so a new list is made
+                    auto ranges = std::make_shared<std::vector<ElementRange>>(*batch.hidden);
+                    ranges->insert(ranges->end(), hidden.begin(), hidden.end());
+                    batch.hidden = ranges;
+                }
+            }
+            // Empty batches are removed (their meshes are deleted by the next upload)
+            if(batch.objects.empty()){
+                batches.erase(batches.begin() + index);
+            } else {
+                index++;
+            }
+        }
+    }
+
+    void StaticBatcher::capture(std::vector<DrawBatch>& drawBatches) const {
+        drawBatches.resize(batches.size());
+        for(size_t index = 0; index < batches.size(); index++){
+            const Batch& batch = batches[index];
+            DrawBatch& drawBatch = drawBatches[index];
+            drawBatch.id = batch.id;
+            drawBatch.revision = batch.revision;
+            drawBatch.material = batch.material;
+            drawBatch.bounds = batch.bounds;
+            drawBatch.geometry = batch.merged;
+            drawBatch.hidden = batch.hidden;
+            drawBatch.mesh = nullptr;
+        }
+    }
+
+    void StaticBatcher::upload(std::vector<DrawBatch>& drawBatches){
+        uploadCount++;
+        for(DrawBatch& drawBatch : drawBatches){
+            UploadedBatch& batch = uploaded[drawBatch.id];
+            if(!batch.mesh || batch.revision != drawBatch.revision){
+                delete batch.mesh;
+                batch.mesh = new Mesh(drawBatch.geometry->vertices, drawBatch.geometry->elements);
+                batch.revision = drawBatch.revision;
+                batch.clearedRanges = 0;
+            }
+            // Only the ranges hidden since the last upload are cleared (the list only grows until the batch is merged again)
+            const std::vector<ElementRange>& hidden = *drawBatch.hidden;
+            for(; batch.clearedRanges < hidden.size(); batch.clearedRanges++)
+                MeshArena::get().clearElements(batch.mesh->getAllocation(), hidden[batch.clearedRanges].first, hidden[batch.clearedRanges].count);
+            batch.lastUpload = uploadCount;
+            drawBatch.mesh = batch.mesh;
+        }
+        // The batches that are not in the snapshot were removed
+        for(auto it = uploaded.begin(); it != uploaded.end();){
+            if(it->second.lastUpload != uploadCount){
+                delete it->second.mesh;
+                it = uploaded.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void StaticBatcher::destroy(){
+        for(auto& [id, batch] : uploaded) delete batch.mesh;
+        uploaded.clear();
+        batches.clear();
+        geometries.clear();
+        objectCount = 0;
+    }
+
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "../ecs/world.hpp"
+#include "../components/mesh-renderer.hpp"
+#include "../mesh/bounding-box.hpp"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace our {
+
+    // The static batcher merges the objects that never move into a few large meshes when the scene is loaded.
+    // An object is static if neither its entity nor any of its ancestors has a component that moves it
+    // (Movement, Camera or Free Camera Controller) and its material is opaque.
+    // The static objects are grouped by material and by the cell of a 3D grid that contains their center.
+    // The vertices of each group are transformed to the world space and merged into one mesh,
+    // so a cell is drawn using a single draw call and can still be culled on its own.
+    // If a batched entity is deleted (e.g. an obstacle hit by the player), its elements in the merged mesh are cleared
+    // so its triangles become degenerate. The batch is only merged again once most of its triangles are hidden this way.
+    // The batches are merged on the main thread (from the data copied from the objects when the scene was loaded, so the entities
+    // are never read again) and copied to the frame snapshot. The render thread only uploads the merged geometry (see "upload").
+    class StaticBatcher {
+    public:
+        // The vertices & elements of a mesh
+        struct Geometry {
+            std::vector<Vertex> vertices;
+            std::vector<unsigned int> elements;
+        };
+        // A range of elements in a merged mesh
+        struct ElementRange {
+            GLsizei first = 0, count = 0;
+        };
+        // A batch as it is drawn in a frame (a part of the frame snapshot).
+        // The geometry and the hidden ranges are shared with the batcher and never changed once they are in a snapshot
+        struct DrawBatch {
+            size_t id = 0;
+            // Incremented every time the batch is merged again (the render thread then uploads the new geometry)
+            std::uint32_t revision = 0;
+            Material* material = nullptr;
+            BoundingBox bounds; // In the world space
+            std::shared_ptr<const Geometry> geometry;
+            // The elements of the removed objects that must be cleared in the uploaded mesh
+            std::shared_ptr<const std::vector<ElementRange>> hidden;
+            // The uploaded mesh of the batch (set by "upload" on the render thread)
+            Mesh* mesh = nullptr;
+        };
+
+    private:
+        // An object merged into a batch. Its transform and tint are copied when the scene is loaded
+        // (the objects never move) and its entity is only compared with the removed entities
+        struct Object {
+            Entity* entity = nullptr;
+            const Geometry* geometry = nullptr;
+            glm::mat4 M;
+            glm::vec4 tint;
+            // The range of its elements in the merged geometry
+            GLsizei firstElement = 0, elementCount = 0;
+        };
+        // A merged mesh containing the static objects of one material in one cell
+        struct Batch {
+            size_t id = 0;
+            std::uint32_t revision = 0;
+            Material* material = nullptr;
+            glm::ivec3 cell;
+            std::vector<Object> objects;
+            BoundingBox bounds;
+            std::shared_ptr<const Geometry> merged;
+            std::shared_ptr<const std::vector<ElementRange>> hidden;
+            // The number of elements in the hidden ranges
+            GLsizei hiddenElements = 0;
+        };
+        // The mesh uploaded for a batch on the render thread, the revision it was created from and the hidden ranges already cleared
+        struct UploadedBatch {
+            Mesh* mesh = nullptr;
+            std::uint32_t revision = 0;
+            size_t clearedRanges = 0;
+            std::uint64_t lastUpload = 0;
+        };
+
+        // Used by the main thread
+        std::vector<Batch> batches;
+        // The geometry of the source meshes copied back from the VRAM when the scene is loaded
+        // (the objects point to them, the elements of an unordered_map never move)
+        std::unordered_map<Mesh*, Geometry> geometries;
+        size_t objectCount = 0;
+        size_t nextBatchId = 0;
+
+        // Used by the render thread
+        std::unordered_map<size_t, UploadedBatch> uploaded;
+        std::uint64_t uploadCount = 0;
+
+        // Returns the geometry of the mesh (reading it from the VRAM the first time)
+        const Geometry& getGeometry(Mesh* mesh);
+        // Merges the geometry of the objects of the batch again (only reads the batch, so it doesn't need the OpenGL context)
+        void merge(Batch& batch);
+
+    public:
+        // Returns true if the entity (and its ancestors) has no component that could move it
+        static bool isStatic(Entity* entity);
+
+        // Merges the static objects of the world into batches (it reads the meshes from the VRAM, so it needs the OpenGL context).
+        // "cellSize" is the size of a grid cell in the world space (a larger cell means fewer draws but coarser culling)
+        void build(World* world, float cellSize);
+        // Should be called by the main thread every frame with the entities removed from the world since the last call
+        // (see World::takeChanges): hides their triangles in the batches that contained them. The pointers are only compared, never used.
+        void update(const std::vector<Entity*>& removed);
+        // Copies the batches to a frame snapshot (only the pointers to the geometry are copied)
+        void capture(std::vector<DrawBatch>& drawBatches) const;
+        // Called by the thread that draws the snapshot: uploads the batches that were merged again since the last upload,
+        // clears the newly hidden ranges, deletes the meshes of the removed batches and sets the mesh of every batch
+        void upload(std::vector<DrawBatch>& drawBatches);
+        // Deletes the batches and their meshes (should be called before the world is cleared or when the batches are no longer needed)
+        void destroy();
+
+        // The number of objects that are currently drawn as a part of a batch
+        size_t getObjectCount() const { return objectCount; }
+    };
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glad/gl.h>
+#include "../gl-state-cache.hpp"
 #include <json/json.hpp>
 #include <glm/vec4.hpp>
 
@@ -25,6 +26,12 @@ namespace our {
             //Delete sampler
             //glDeleteSamplers(number of sampler objects to be deleted, pointer to sampler array)
             glDeleteSamplers(1, &name);
+            GLStateCache::onSamplerDeleted(name);
+        }
+
+        // Get the internal OpenGL name of the sampler (used by the material table to bind it without going through the material)
+        GLuint getOpenGLName() const {
+            return name;
         }
 
         // This method binds this sampler to the given texture unit
@@ -33,7 +40,7 @@ namespace our {
             //We use texture units to be able to use multiple textures in shaders 
             //so we need to bind sampler to texture unit
             //glBindSampler(texture unit index, sampler name)
-            glBindSampler(textureUnit, name);
+            GLStateCache::bindSampler(textureUnit, name);
         }
 
         // This static method ensures that no sampler is bound to the given texture unit
@@ -41,7 +48,7 @@ namespace our {
             //TODO: (Req 6) Complete this function
             //Unind sampler
             //glBindSampler(texture index, 0 for unbinding)
-            glBindSampler(textureUnit, 0);
+            GLStateCache::bindSampler(textureUnit, 0);
         }
 
         // This function sets a sampler paramter where the value is of type "GLint"
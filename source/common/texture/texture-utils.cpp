@@ -8,7 +8,7 @@
 #include <glm/glm.hpp>
 
 
-our::Texture2D* our::texture_utils::empty(GLenum format, glm::ivec2 size){
+our::Texture2D* our::texture_utils::empty(GLenum format, glm::ivec2 size, bool mipmaps){
 
     //Generate an object from Texture2D class
     our::Texture2D* texture = new our::Texture2D();
@@ -19,10 +19,10 @@ our::Texture2D* our::texture_utils::empty(GLenum format, glm::ivec2 size){
     texture->bind();
     
     //Specify texture parameters without storing data in texture just allocate memory for it
-    //for depth buffer we need only 1 mip level
+    //for depth buffer and render targets we need only 1 mip level
     //else we need to calculate how many mips to allocate 
     GLsizei levels=1;
-    if(format != GL_DEPTH_COMPONENT24){
+    if(mipmaps && format != GL_DEPTH_COMPONENT24){
         levels = (GLsizei)glm::floor(glm::log2((float)glm::max(size[0], size[1]))) + 1;
     }
 
@@ -8,7 +8,8 @@
 
 namespace our::texture_utils {
     // This function create an empty texture with a specific format (useful for framebuffers)
-    Texture2D* empty(GLenum format, glm::ivec2 size);
+    // Render targets are only sampled at their full size, so the mip levels are only allocated if "mipmaps" is true
+    Texture2D* empty(GLenum format, glm::ivec2 size, bool mipmaps = false);
     // This function loads an image and sends its data to the given Texture2D 
     Texture2D* loadImage(const std::string& filename, bool generate_mipmap = true);
 }
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/gl.h>
+#include "../gl-state-cache.hpp"
+
+namespace our {
+
+    // This class defines an OpenGL texture which will be used as a GL_TEXTURE_2D_ARRAY
+    // An array holds many images (layers) of the same size and format which are bound together to one texture unit,
+    // so objects that read different images can be drawn without binding another texture (the shader picks the layer)
+    class Texture2DArray {
+        // The OpenGL object name of this texture
+        GLuint name = 0;
+    public:
+        // This constructor creates an OpenGL texture and saves its object name in the member variable "name"
+        Texture2DArray() {
+            glGenTextures(1, &name);
+        };
+
+        // This deconstructor deletes the underlying OpenGL texture
+        ~Texture2DArray() {
+            glDeleteTextures(1, &name);
+            GLStateCache::onTextureDeleted(name);
+        }
+
+        // Get the internal OpenGL name of the texture which is useful for use with framebuffers
+        GLuint getOpenGLName() {
+            return name;
+        }
+
+        // This method binds this texture to GL_TEXTURE_2D_ARRAY
+        void bind() const {
+            GLStateCache::bindTexture(GL_TEXTURE_2D_ARRAY, name);
+        }
+
+        // This static method ensures that no texture is bound to GL_TEXTURE_2D_ARRAY
+        static void unbind(){
+            GLStateCache::bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        }
+
+        Texture2DArray(const Texture2DArray&) = delete;
+        Texture2DArray& operator=(const Texture2DArray&) = delete;
+    };
+
+}
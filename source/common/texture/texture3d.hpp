@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/gl.h>
+#include "../gl-state-cache.hpp"
+
+namespace our {
+
+    // This class defines an OpenGL texture which will be used as a GL_TEXTURE_3D
+    // A 3D texture is sampled with 3 coordinates and filtered between its slices too,
+    // so it can store a function of 3 variables such as a color lookup table (see "bakeColorLUT")
+    class Texture3D {
+        // The OpenGL object name of this texture
+        GLuint name = 0;
+    public:
+        // This constructor creates an OpenGL texture and saves its object name in the member variable "name"
+        Texture3D() {
+            glGenTextures(1, &name);
+        };
+
+        // This deconstructor deletes the underlying OpenGL texture
+        ~Texture3D() {
+            glDeleteTextures(1, &name);
+            GLStateCache::onTextureDeleted(name);
+        }
+
+        // Get the internal OpenGL name of the texture which is useful for use with framebuffers
+        GLuint getOpenGLName() {
+            return name;
+        }
+
+        // This method binds this texture to GL_TEXTURE_3D
+        void bind() const {
+            GLStateCache::bindTexture(GL_TEXTURE_3D, name);
+        }
+
+        // This static method ensures that no texture is bound to GL_TEXTURE_3D
+        static void unbind(){
+            GLStateCache::bindTexture(GL_TEXTURE_3D, 0);
+        }
+
+        Texture3D(const Texture3D&) = delete;
+        Texture3D& operator=(const Texture3D&) = delete;
+    };
+
+}
@@ -4,6 +4,7 @@
 
 #include <ecs/world.hpp>
 #include <systems/forward-renderer.hpp>
+#include <systems/deferred-renderer.hpp>
 #include <systems/free-camera-controller.hpp>
 #include <systems/movement.hpp>
 #include <asset-loader.hpp>
@@ -12,9 +13,12 @@
 class Playstate: public our::State {
 
     our::World world;
-    our::ForwardRenderer renderer;
+    // The renderer is picked by the "type" of the renderer config ("forward" or "deferred")
+    our::ForwardRenderer* renderer = nullptr;
     our::FreeCameraControllerSystem cameraController;
     our::MovementSystem movementSystem;
+    // Whether to show the renderer statistics overlay (enabled using "statistics": true in the renderer config)
+    bool showStatistics = false;
 
     void onInitialize() override {
         
@@ -43,16 +47,58 @@ class Playstate: public our::State {
         cameraController.enter(getApp());
         // Then we initialize the renderer
         auto size = getApp()->getFrameBufferSize();
-        renderer.initialize(size, config["renderer"]);
+        if(config["renderer"].value("type", "forward") == "deferred") renderer = new our::DeferredRenderer();
+        else renderer = new our::ForwardRenderer();
+        renderer->initialize(size, config["renderer"]);
+        // Now that the world is loaded, merge its static objects
+        renderer->buildStaticBatches(&world);
+        renderer->warmShaders(&world);
+        showStatistics = config["renderer"].value("statistics", false);
     }
 
+    void onImmediateGui() override {
+        if(!showStatistics) return;
+        // Show the counters collected by the renderer while drawing the last frame
+        const our::RenderStatistics& statistics = renderer->getStatistics();
+        ImGui::Begin("Renderer Statistics");
+        ImGui::Text("Uniform driver lookups: %zu", statistics.uniformDriverLookups);
+        ImGui::Text("Lights: %zu (cluster references: %zu)", statistics.lightCount, statistics.clusterLightReferences);
+        ImGui::Text("Draw calls: %zu (instanced: %zu, multi-draw: %zu, material setups: %zu)",
+            statistics.drawCalls, statistics.instancedDrawCalls, statistics.multiDrawCalls, statistics.materialSetups);
+        ImGui::Text("Static batches: %zu (objects: %zu), culled: %zu", statistics.staticBatches, statistics.staticObjects, statistics.culledObjects);
+        ImGui::Text("Render list updates: %zu", statistics.renderListUpdates);
+        ImGui::Text("Simplified levels of detail: %zu", statistics.lodReduced);
+        if(statistics.occlusionTested > 0)
+            ImGui::Text("Occlusion tested: %zu (drawn conditionally: %zu)", statistics.occlusionTested, statistics.occlusionConditional);
+        if(statistics.prepassDrawCalls > 0){
+            ImGui::Text("Depth pre-pass draw calls: %zu", statistics.prepassDrawCalls);
+            if(statistics.fragmentStatisticsAvailable)
+                ImGui::Text("Fragment invocations: pre-pass %llu, shaded %llu, saved %llu",
+                    (unsigned long long)statistics.prepassFragmentInvocations, (unsigned long long)statistics.prepassedFragmentInvocations,
+                    (unsigned long long)statistics.savedFragmentInvocations);
+        }
+        ImGui::Text("GL state calls: %zu issued, %zu elided", statistics.glCallsIssued, statistics.glCallsElided);
+        ImGui::Text("Streamed frame data: %zu KB (%s)", statistics.streamedBytes / 1024,
+            statistics.persistentMapping ? "persistent mapping" : "orphaned upload");
+        ImGui::Text("Render graph: %zu passes (%zu culled), %zu pooled targets (%zu aliased)", statistics.renderGraphPasses,
+            statistics.culledRenderGraphPasses, statistics.pooledRenderTargets, statistics.aliasedRenderTargets);
+        ImGui::Text("Postprocess: %zu effects in %zu passes (%zu color LUTs)", statistics.postprocessEffects, statistics.postprocessPasses,
+            statistics.postprocessLUTs);
+        ImGui::Text("Renderer: %s", statistics.deferredShading ? "deferred" : "forward");
+        ImGui::Text("Render scale: %.0f%% (GPU frame time %.2f ms)", statistics.renderScale * 100.0f, statistics.gpuFrameTime);
+        ImGui::End();
+    }
+
+    // The systems only read & write the world and the renderer records its drawing on the render thread
+    bool supportsRenderThread() override { return true; }
+
     void onDraw(double deltaTime) override {
         // Here, we just run a bunch of systems to control the world logic
         movementSystem.update(&world, (float)deltaTime);
         cameraController.update(&world, (float)deltaTime);
         world.deleteMarkedEntities();
-        // And finally we use the renderer system to draw the scene
-        renderer.render(&world);
+        // And finally we use the renderer system to draw the scene (there is none if the config couldn't be read)
+        if(renderer) renderer->render(&world);
 
         // Get a reference to the keyboard object
         auto& keyboard = getApp()->getKeyboard();
@@ -65,7 +111,9 @@ class Playstate: public our::State {
 
     void onDestroy() override {
         // Don't forget to destroy the renderer
-        renderer.destroy();
+        if(renderer) renderer->destroy();
+        delete renderer;
+        renderer = nullptr;
         // On exit, we call exit for the camera controller system to make sure that the mouse is unlocked
         cameraController.exit();
         // Clear the world